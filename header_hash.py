@@ -0,0 +1,53 @@
+#!/usr/bin/env python3
+#
+# Generates include/header_hash.h, a perfect hash over the request header names in include/constants.h
+# run it again every time header_request_options_str changes
+#
+# hash = (first * A + last * B + middle * C) & (size - 1), on the lowercase characters
+# the first multipliers that give no collisions are used
+
+import itertools
+import re
+
+with open("include/constants.h") as f:
+	constants = f.read()
+
+table_src = constants.split("header_request_options_str[] = {")[1].split("};")[0]
+names     = [n.lower() for n in re.findall(r'TO_STRINGREF\("([^"]+)"\)', table_src)]
+
+def fold(c):
+	# same as the C code, works for letters, digits and '-'
+	return ord(c) | 0x20
+
+def slot(name, a, b, c, size):
+	return (fold(name[0]) * a + fold(name[-1]) * b + fold(name[len(name) // 2]) * c) & (size - 1)
+
+def search():
+	for size in (64, 128, 256):
+		for a, b, c in itertools.product(range(1, 32), range(0, 32), range(0, 32)):
+			slots = [slot(n, a, b, c, size) for n in names]
+			if len(set(slots)) == len(slots):
+				return size, a, b, c, slots
+	raise SystemExit("no perfect hash found, widen the search")
+
+size, a, b, c, slots = search()
+
+# the empty slots hold RQ_ENUM_LEN, the number of names
+table = [len(names)] * size
+for code, s in enumerate(slots):
+	table[s] = code
+
+with open("include/header_hash.h", "w") as out:
+	out.write("#pragma once\n")
+	out.write("// generated by header_hash.py from include/constants.h, do not edit\n\n")
+	out.write("#include \"HttpMessage.h\"\n\n#include <stdint.h>\n\n")
+	out.write(f"static_assert(RQ_ENUM_LEN == {len(names)}, \"the request options changed, run header_hash.py again\");\n\n")
+	out.write(f"constexpr uint32_t HEADER_HASH_SIZE   = {size};\n")
+	out.write(f"constexpr uint32_t HEADER_HASH_FIRST  = {a};\n")
+	out.write(f"constexpr uint32_t HEADER_HASH_LAST   = {b};\n")
+	out.write(f"constexpr uint32_t HEADER_HASH_MIDDLE = {c};\n\n")
+	out.write("// the request option code of every slot, RQ_ENUM_LEN if the slot is empty\n")
+	out.write("static const uint8_t header_hash_table[] = {\n")
+	for i in range(0, size, 16):
+		out.write("    " + ", ".join(f"{v:2}" for v in table[i:i + 16]) + ",\n")
+	out.write("};\n")
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <stddef.h>
+
+// the size of the first block of an arena, if it is not specified
+constexpr size_t ARENA_BLOCK_SIZE = 16 * 1024;
+
+// an arena bigger than this goes back to the default size when reset, so a single huge request does not keep the memory forever
+constexpr size_t ARENA_MAX_RETAINED = 1024 * 1024;
+
+typedef struct ArenaBlock ArenaBlock;
+
+struct ArenaBlock {
+	ArenaBlock *prev;     // the block filled before this one
+	size_t      capacity; // how many bytes are in data
+	size_t      used;     // how many bytes of data are already allocated
+	max_align_t data[];   // the memory given out, aligned for anything
+};
+
+/**
+ * A bump allocator, memory is given out a piece after the other and released all at once
+ *
+ * When the current block is full a bigger one is allocated, on reset the blocks are merged in a single one as big as all of them
+ * so after the first few requests an arena that is reset after each one never calls malloc again.
+ * A zero initialized arena is valid, the first block is allocated on the first allocation
+ */
+typedef struct {
+	ArenaBlock *current;    // the block allocations are taken from, linked to the previous ones
+	size_t      total;      // the sum of the capacity of all the blocks
+	size_t      block_size; // the capacity of the first block
+} Arena;
+
+/**
+ * Makes an empty arena, nothing is allocated until the first allocation
+ *
+ * @param[in] `block_size` the capacity of the first block, defaults to ARENA_BLOCK_SIZE if zero is specified
+ *
+ * @return a built Arena
+ */
+Arena make_Arena(const size_t block_size);
+
+/**
+ * Frees every block of the arena, every pointer given by it becomes invalid
+ *
+ * @param[in] `arena` the arena to destroy
+ */
+void destroy_Arena(Arena *arena);
+
+/**
+ * Allocate `size` bytes from the arena, aligned for any type
+ *
+ * @param[in] `arena` the arena to allocate from
+ * @param[in] `size` how many bytes to allocate
+ *
+ * @return the allocated memory, it is not initialized
+ */
+void *alloc_Arena(Arena *arena, const size_t size);
+
+/**
+ * Resize an allocation, like realloc. If it is the last one made and there is space it is extended in place,
+ * otherwise new memory is allocated and the data copied, the old memory is not reused until the next reset
+ *
+ * @param[in] `arena` the arena `ptr` was allocated from
+ * @param[in] `ptr` the allocation to resize, can be nullptr
+ * @param[in] `old_size` the size `ptr` was allocated with
+ * @param[in] `new_size` the size wanted
+ *
+ * @return the resized allocation
+ */
+void *realloc_Arena(Arena *arena, void *ptr, const size_t old_size, const size_t new_size);
+
+/**
+ * Release every allocation at once, keeping the memory for the next ones
+ *
+ * @param[in] `arena` the arena to reset
+ */
+void reset_Arena(Arena *arena);
@@ -0,0 +1,93 @@
+#pragma once
+
+#include "FileServer.h"
+#include "HttpMessage.h"
+#include "StringRef.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// how many independent parts the cache is split in, each with its own lock and lru list
+constexpr size_t ASSET_CACHE_SHARDS = 16;
+
+// the hash buckets of every shard
+constexpr size_t ASSET_SHARD_BUCKETS = 64;
+
+// the bytes all the assets can take together, the least recently used are evicted to stay under it
+constexpr size_t ASSET_CACHE_CAPACITY = 64 * 1024 * 1024;
+
+// bigger files are not kept in memory, they are sent from the file as they are
+constexpr size_t ASSET_MAX_SIZE = 1024 * 1024;
+
+/**
+ * A file prepared for sending, read and compressed once, with its header fields
+ * the cache and every response sending it hold a reference
+ */
+struct Asset {
+	StringOwn     body;           // the content, compressed if `encoding` says so
+	StringOwn     content_length; // the length of the body, as text
+	StringOwn     etag;           // the entity tag of this representation, quoted
+	HeaderBuilder header;         // the fields of every response sending it, formatted once, its buffer is not in an arena
+	StringRef     mime;           // the content type of the file
+	FileEntry    *file;           // the file the asset was made from, a different entry in the file cache means the asset is stale
+	Asset        *bucket_next;    // the next asset in the same hash bucket
+	Asset        *newer;          // the lru list of the shard
+	Asset        *older;          //
+	size_t        size;           // how many bytes of the cache the asset takes
+	uint64_t      hash;           // hash of the path, to find the shard and the bucket
+	atomic_uint   refs;           // one for the cache and one for every response using it, freed when it reaches 0
+	uint8_t       requested;      // the encoding asked to the cache, part of the key with the path
+	uint8_t       encoding;       // the encoding of the body, identity when compressing did not make it smaller
+};
+
+typedef struct {
+	pthread_mutex_t lock;                         // a hit changes the lru list, so even lookups take it
+	Asset          *buckets[ASSET_SHARD_BUCKETS]; // the assets by hash
+	Asset          *newest;                       // the head of the lru list
+	Asset          *oldest;                       // the tail of the lru list, the next to be evicted
+	size_t          size;                         // the bytes taken by the assets of the shard
+} AssetShard;
+
+/**
+ * Response bodies by path and content encoding, bounded in bytes, split in shards so the threads rarely wait for each other
+ */
+typedef struct {
+	AssetShard shards[ASSET_CACHE_SHARDS];
+	size_t     shard_capacity; // the bytes a single shard can take
+} AssetCache;
+
+/**
+ * Prepares an empty cache
+ *
+ * @param[in] `capacity` the bytes all the assets can take
+ * @param[out] `cache` the cache to initialize
+ */
+void initialize_AssetCache(const size_t capacity, AssetCache *cache);
+
+/**
+ * Frees every asset of the cache, the ones still acquired are freed when released
+ *
+ * @param[in] `cache` the cache to destroy
+ */
+void destroy_AssetCache(AssetCache *cache);
+
+/**
+ * Finds the asset of the file with the given encoding, making it if it is not cached or the file changed
+ *
+ * @param[in] `cache` the cache to look in
+ * @param[in] `file` the current entry of the file, from acquire_file
+ * @param[in] `encoding` the encoding the client accepts, one of ContentEncoding
+ * @param[in] `make` if the asset should be made when it is not cached, false to only look it up
+ *
+ * @return the asset, to give back with release_asset, nullptr if it is not cached and `make` is false, or the file can not be read
+ */
+Asset *acquire_asset(AssetCache *cache, FileEntry *file, const uint8_t encoding, const bool make);
+
+/**
+ * Gives back an asset, freeing it if it was the last user
+ *
+ * @param[in] `asset` the asset obtained by acquire_asset
+ */
+void release_asset(Asset *asset);
@@ -0,0 +1,91 @@
+#pragma once
+
+#include "Arena.h"
+#include "HttpMessage.h"
+#include "StringRef.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+// the body bytes a chunk carries at most, what a writer holds in memory at any time
+constexpr size_t BODY_CHUNK_SIZE = 16 * 1024;
+
+// room before the data for the size line of the chunk, 16 hex digits and CRLF
+constexpr size_t BODY_CHUNK_PREFIX = 18;
+
+/**
+ * Where the framed body goes, the connection of the response for the server
+ *
+ * @return false if the data could not be sent, the writer stops sending
+ */
+typedef bool (*BodySink)(void *sink, const char *data, const size_t len);
+
+/**
+ * Sends a body given in pieces, in chunks of at most BODY_CHUNK_SIZE bytes, gzipped on the way if asked
+ * the pieces are copied (or compressed) in a single buffer, that is sent when full, so the memory does not grow with the body
+ * the writer borrows the deflate stream of the thread, while a fiber waits with it the others on the thread get their own
+ */
+struct BodyWriter {
+	BodySink           sink;    // where the chunks are sent
+	void              *target;  // given to the sink
+	char              *buffer;  // the chunk being filled, with BODY_CHUNK_PREFIX bytes before the data and 2 after
+	struct z_stream_s *stream;  // the deflate stream of the body, until close_BodyWriter
+	size_t             len;     // the data in the chunk
+	size_t             written; // the body bytes given by the producer, before the compression
+	size_t             sent;    // the bytes given to the sink, framing included
+	bool               chunked; // if the chunks are framed, without framing the end of the body is the end of the connection
+	bool               gzip;    // if the body goes through the deflate stream
+	bool               failed;  // the sink or the compressor failed, the rest of the body is dropped
+};
+
+/**
+ * Prepares a writer, its buffer is allocated in the arena
+ *
+ * @param[in] `sink` where the chunks are sent
+ * @param[in] `target` given to the sink
+ * @param[in] `chunked` if the chunks are framed with their size, for http 1.1 and later
+ * @param[in] `gz_level` the zlib level to compress the body with, 0 to send it as it is
+ * @param[in] `arena` where to allocate the buffer
+ * @param[out] `writer` the writer to initialize
+ */
+void initialize_BodyWriter(BodySink sink, void *target, const bool chunked, const int gz_level, Arena *arena, BodyWriter *writer);
+
+/**
+ * Adds a piece of the body, a full chunk is sent right away
+ *
+ * @param[in] `writer` the writer of the response
+ * @param[in] `data` the piece to add
+ *
+ * @return false if the body can not be sent anymore, the producer should stop
+ */
+bool write_body(BodyWriter *writer, const StringRef *data);
+
+/**
+ * Sends what was written so far, even if the chunk is not full, so the client can use it
+ *
+ * @param[in] `writer` the writer of the response
+ *
+ * @return false if the body can not be sent anymore
+ */
+bool flush_body(BodyWriter *writer);
+
+/**
+ * Sends what is left and the last chunk that marks the end of the body
+ *
+ * @param[in] `writer` the writer of the response
+ *
+ * @return false if the body could not be sent whole
+ */
+bool finish_body(BodyWriter *writer);
+
+/**
+ * Gives back the deflate stream of the writer, after the last call on it whether the body was sent or not
+ *
+ * @param[in] `writer` the writer of the response
+ */
+void close_BodyWriter(BodyWriter *writer);
+
+/**
+ * Frees the deflate stream the calling thread keeps for the bodies it compresses
+ */
+void release_body_stream();
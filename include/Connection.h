@@ -0,0 +1,137 @@
+#pragma once
+
+#include "Fiber.h"
+#include "StringRef.h"
+#include "Topology.h"
+
+#include <openssl/types.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <tcpConn.h>
+
+// how long a worker, or a fiber, waits on a single non-blocking read / write before giving up on the client
+constexpr int CONNECTION_IO_TIMEOUT_MS = 5000;
+
+// the initial size of the receive buffer of a connection, it grows if a request does not fit
+constexpr size_t CONNECTION_BUFFER_SIZE = 4096;
+
+// the most data a tls record carries
+constexpr size_t CONNECTION_RECORD_SIZE = 16 * 1024;
+
+// how much of a file is read and encrypted at a time when the kernel can not send it, a whole record
+constexpr size_t CONNECTION_FILE_CHUNK = CONNECTION_RECORD_SIZE;
+
+typedef enum : uint8_t {
+	CONN_HANDSHAKE, // the tls handshake is still in progress
+	CONN_READY,     // the handshake is done, the client can send requests
+} ConnectionState;
+
+/**
+ * Everything needed to talk with a single client
+ * it is heap allocated so the reactor can put its pointer in the epoll data
+ */
+typedef struct Connection Connection;
+
+struct Connection {
+	SSL        *ssl;               // the ssl connection to communicate on, nullptr until a worker starts the handshake
+	char       *buffer;            // what has been received and not yet resolved, allocated on the first receive
+	size_t      buffer_len;        // how many bytes are in buffer
+	size_t      buffer_capacity;   // how many bytes buffer can hold
+	Connection *prev;              // intrusive links used by the reactor for the idle list and the returned stack
+	Connection *next;              //
+	Fiber      *fiber;             // the fiber waiting on the client in the middle of a request, the loop resumes it on the next event
+	uint64_t    accept_time_ns;    // monotonic time of the accept, to measure the handshake latency
+	uint64_t    handshake_work_ns; // time spent inside SSL_accept so far
+	uint64_t    idle_deadline_ns;  // when the reactor closes the connection if the client does not send anything
+	Socket      client_socket;     // the non-blocking socket of the client
+	uint32_t    rearm_events;      // what the connection is waiting for when given back to the reactor
+	uint32_t    requests_served;   // how many requests have been resolved on this connection
+	uint16_t    node;              // the numa node its buffers are on, where it is served, NODE_ANY until known
+	uint8_t     state;             // one of ConnectionState
+};
+
+/**
+ * Creates a connection for the given (already non-blocking) client socket
+ * the ssl connection is created later by the worker that does the handshake
+ *
+ * @param[in] `client_socket` the socket of the client
+ *
+ * @return the heap allocated connection
+ */
+Connection *make_Connection(const Socket client_socket);
+
+/**
+ * Shuts down and closes the client socket, destroys the ssl connection (if any) and frees the connection
+ *
+ * @param[in] `conn` the connection to destroy
+ */
+void destroy_Connection(Connection *conn);
+
+/**
+ * Receive at most `len` bytes from the connection
+ * the socket is non-blocking, if no data is available it waits for at most CONNECTION_IO_TIMEOUT_MS, a fiber waits in the loop of its thread
+ *
+ * @param[in] `conn` the connection to read from
+ * @param[out] `buffer` where to put the data received
+ * @param[in] `len` the size of buffer
+ *
+ * @return the amount of bytes read, 0 if the client closed the connection, -1 on error or timeout
+ */
+ssize_t connection_receive(Connection *conn, char *buffer, const size_t len);
+
+/**
+ * Receive more data at the end of the connection buffer, the buffer grows if it is full
+ *
+ * @param[in] `conn` the connection to read from
+ * @param[in] `max_capacity` the buffer will not grow bigger than this
+ *
+ * @return the amount of bytes read, 0 if the client closed the connection, -1 on error, timeout or if the buffer is at max_capacity
+ */
+ssize_t connection_fill(Connection *conn, const size_t max_capacity);
+
+/**
+ * Remove the first `len` bytes from the connection buffer, what comes after is moved to the start
+ *
+ * @param[in] `conn` the connection to consume the buffer of
+ * @param[in] `len` how many bytes to remove
+ */
+void connection_consume(Connection *conn, const size_t len);
+
+/**
+ * Send all of `len` bytes to the connection
+ * the socket is non-blocking, if it is full it waits for at most CONNECTION_IO_TIMEOUT_MS, a fiber waits in the loop of its thread
+ *
+ * @param[in] `conn` the connection to write to
+ * @param[in] `data` the data to send
+ * @param[in] `len` how many bytes to send
+ *
+ * @return true if everything was sent
+ */
+bool connection_send(Connection *conn, const char *data, const size_t len);
+
+/**
+ * Send the parts one after the other, as a single message, without joining them in a buffer first
+ * the small parts are gathered in whole records, a part bigger than a record is encrypted from where it is
+ * so at most one record is copied at the start of a big part and one at its end
+ *
+ * @param[in] `conn` the connection to write to
+ * @param[in] `parts` the data to send, in order
+ * @param[in] `count` how many parts there are
+ *
+ * @return true if everything was sent
+ */
+bool connection_send_parts(Connection *conn, const StringRef *parts, const size_t count);
+
+/**
+ * Send `len` bytes of the file, starting at `offset`, to the connection
+ * with kernel tls the file goes from the page cache to the socket with SSL_sendfile, without being copied in user space,
+ * otherwise it is read and sent CONNECTION_FILE_CHUNK bytes at a time
+ *
+ * @param[in] `conn` the connection to write to
+ * @param[in] `fd` the file to send, its offset is not used nor changed
+ * @param[in] `offset` where to start sending from
+ * @param[in] `len` how many bytes to send
+ *
+ * @return true if everything was sent, false on error, timeout or if the file is shorter than expected
+ */
+bool connection_send_file(Connection *conn, const int fd, size_t offset, const size_t len);
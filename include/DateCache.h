@@ -0,0 +1,46 @@
+#pragma once
+
+#include "StringRef.h"
+
+#include <stddef.h>
+#include <time.h>
+
+// the length of an http date, "Sun, 06 Nov 1994 08:49:37 GMT", every date has the same
+constexpr size_t HTTP_DATE_LEN = 29;
+
+// "Date: " + the date + "\r\n"
+constexpr size_t DATE_HEADER_LEN = 6 + HTTP_DATE_LEN + 2;
+
+// how far in the future the cached Expires date is, the same time as the max-age of the Cache-Control sent with files
+constexpr time_t DATE_EXPIRES_AFTER = 604800;
+
+// how many formatted seconds are kept, a reader may still be copying an old one while the next is written
+constexpr size_t DATE_CACHE_SLOTS = 4;
+
+/**
+ * Formats the time as an http date (RFC 9110, IMF-fixdate)
+ *
+ * @param[in] `time` the unix time to format
+ * @param[out] `out` where to put the date, HTTP_DATE_LEN bytes, not null terminated
+ */
+void format_http_date(const time_t time, char *out);
+
+/**
+ * Formats the current second, if it was not already, the event loop calls it every time it wakes up
+ * it can be called by any thread, only one of them formats a given second
+ */
+void refresh_DateCache();
+
+/**
+ * The whole Date header field of the current second, with its CRLF, ready to be copied in a response
+ *
+ * @return a reference valid for some seconds, to copy right away
+ */
+StringRef get_date_header();
+
+/**
+ * The date DATE_EXPIRES_AFTER seconds from now, for the Expires header
+ *
+ * @return a reference valid for some seconds, to copy right away
+ */
+StringRef get_expires_date();
@@ -0,0 +1,108 @@
+#pragma once
+
+#include "HttpMessage.h"
+#include "StringRef.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+// smaller bodies are not compressed, the header of the format and the extra header of the response take most of what is saved
+constexpr size_t COMPRESS_MIN_SIZE = 512;
+
+// bodies up to this size are compressed at the best level of the encoder
+constexpr size_t COMPRESS_BEST_MAX_SIZE = 64 * 1024;
+
+// bodies up to this size are compressed at the default level, the bigger ones at a faster one
+constexpr size_t COMPRESS_DEFAULT_MAX_SIZE = 1024 * 1024;
+
+// how hard to compress a body, every encoder has its own level for each
+typedef enum : uint8_t {
+	COMPRESS_NONE,
+	COMPRESS_FAST,
+	COMPRESS_DEFAULT,
+	COMPRESS_BEST,
+	COMPRESS_ENUM_LEN,
+} CompressionTier;
+
+/**
+ * Compresses a whole body in one call
+ *
+ * @param[in] `data` the body to compress
+ * @param[in] `level` the level of the encoder
+ * @param[out] `output` where to put the result, its str is reallocated and must be freed
+ *
+ * @return false if the encoder failed
+ */
+typedef bool (*Encoder)(const StringRef *data, const int level, StringOwn *output);
+
+typedef struct {
+	Encoder encode;                    // nullptr for identity
+	int     levels[COMPRESS_ENUM_LEN]; // the level of the encoder for every tier
+} EncoderInfo;
+
+// the encodings negotiate_encoding can choose, as a mask of (1 << ContentEncoding)
+constexpr uint32_t ENCODINGS_ALL = (1 << ENCODING_ENUM_LEN) - 1;
+
+/**
+ * Tells if the content type is made of text, the other formats are already compressed
+ *
+ * @param[in] `mime` the content type of the body
+ */
+bool is_compressible(const StringRef *mime);
+
+/**
+ * Chooses how much to compress a body, by its content type and size
+ *
+ * @param[in] `mime` the content type of the body
+ * @param[in] `len` the size of the body
+ *
+ * @return COMPRESS_NONE if the body is too small or its format is already compressed
+ */
+uint8_t compression_tier(const StringRef *mime, const size_t len);
+
+/**
+ * Chooses the encoding of the response from the Accept-Encoding of the request, q-values included
+ * between codings with the same q-value the one with the smallest output wins, br then zstd then gzip
+ * an empty or missing header means identity
+ *
+ * @param[in] `accept` the value of the Accept-Encoding header
+ * @param[in] `allowed` the encodings the response can have, a mask of (1 << ContentEncoding)
+ *
+ * @return one of ContentEncoding
+ */
+uint8_t negotiate_encoding(const StringRef *accept, const uint32_t allowed);
+
+/**
+ * The level the encoder uses for a compression tier
+ *
+ * @param[in] `encoding` one of ContentEncoding
+ * @param[in] `tier` one of CompressionTier
+ */
+int encoding_level(const uint8_t encoding, const uint8_t tier);
+
+/**
+ * Compresses a body with the given encoding
+ *
+ * @param[in] `encoding` one of ContentEncoding, identity is refused
+ * @param[in] `tier` how hard to compress it, from compression_tier
+ * @param[in] `data` the body to compress
+ * @param[out] `output` where to put the result, its str is reallocated and must be freed
+ *
+ * @return false if the body was not compressed
+ */
+bool encode_body(const uint8_t encoding, const uint8_t tier, const StringRef *data, StringOwn *output);
+
+/**
+ * Compresses to brotli in a single call
+ */
+bool compress_br(const StringRef *data, const int level, StringOwn *output);
+
+/**
+ * Compresses to zstd with the compression context of the thread, freed by release_encoders
+ */
+bool compress_zstd(const StringRef *data, const int level, StringOwn *output);
+
+/**
+ * Frees the compression state the calling thread kept between bodies
+ */
+void release_encoders();
@@ -0,0 +1,114 @@
+#pragma once
+
+#include "Arena.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+// the stack of a fiber, only the pages it touches are backed by memory
+constexpr size_t FIBER_STACK_SIZE = 256 * 1024;
+
+// how many finished fibers a thread keeps with their stack and arena, for the next ones
+constexpr size_t FIBER_POOL_SIZE = 256;
+
+/**
+ * The function a fiber runs, it can wait on a socket with fiber_wait
+ */
+typedef void (*FiberFunction)(void *data, void *arg);
+
+typedef struct Fiber Fiber;
+
+/**
+ * A function running on its own stack, on the thread of an event loop
+ *
+ * When it waits on a socket it switches back to the loop, that resumes it once the socket is ready or the wait times out
+ * a fiber never moves to another thread, what the thread keeps for it stays valid while it waits
+ */
+struct Fiber {
+	void         *sp;          // the stack pointer saved when the fiber switched out
+	char         *stack;       // the mapping of the stack, with the guard page at its start
+	FiberFunction run;         // what the fiber runs
+	void         *data;        // given to run
+	void         *arg;         // given to run
+	Fiber        *prev;        // intrusive links for the waiting list and the pool
+	Fiber        *next;        //
+	void         *wait_data;   // the epoll data of the socket waited on
+	void         *fake_stack;  // kept by the address sanitizer while the fiber waits
+	uint64_t      deadline_ns; // when the wait times out
+	int           wait_fd;     // the socket waited on
+	Arena         arena;       // the memory of what the fiber resolves, it can not share the one of the thread
+	bool          ready;       // the wait ended with the socket ready, false if it timed out
+	bool          done;        // run returned, the fiber can be reused
+};
+
+/**
+ * Makes the calling thread run fibers, the sockets they wait on are armed in the given epoll instance
+ * a socket not registered in it yet is added on its first wait, its events are given back to resume_fiber by the loop
+ *
+ * @param[in] `epoll_fd` the epoll instance of the loop of the thread
+ */
+void set_fiber_loop(const int epoll_fd);
+
+/**
+ * Runs the function in a fiber until it waits or returns, called by the loop
+ *
+ * @param[in] `run` the function to run
+ * @param[in] `data` given to run
+ * @param[in] `arg` given to run
+ *
+ * @return false if no stack could be mapped, if the thread has no loop, or if called from a fiber, run was not called
+ */
+bool run_fiber(FiberFunction run, void *data, void *arg);
+
+/**
+ * Continues a waiting fiber until it waits again or returns, called by the loop
+ *
+ * @param[in] `fiber` the fiber to continue
+ * @param[in] `ready` what fiber_wait returns to it
+ */
+void resume_fiber(Fiber *fiber, const bool ready);
+
+/**
+ * The fiber running on the thread
+ *
+ * @return nullptr on the loop, or on a thread that does not run fibers
+ */
+Fiber *current_fiber();
+
+/**
+ * Arms the socket in the epoll instance of the loop and switches back to it, until the socket is ready or the time is over
+ *
+ * @param[in] `fd` the socket to wait on
+ * @param[in] `events` EPOLLIN or EPOLLOUT
+ * @param[in] `data` the epoll data the loop gets back, so it knows which fiber to resume
+ * @param[in] `timeout_ms` how long to wait at most
+ *
+ * @return true if the socket is ready, false if the wait timed out, was cancelled, or the caller is not a fiber
+ */
+bool fiber_wait(const int fd, const uint32_t events, void *data, const int timeout_ms);
+
+/**
+ * When the first waiting fiber times out, so the loop knows how long it can sleep
+ *
+ * @return 0 if no fiber is waiting
+ */
+uint64_t next_fiber_deadline();
+
+/**
+ * Resumes every fiber whose wait is over, their fiber_wait returns false
+ *
+ * @param[in] `now_ns` the current monotonic time
+ *
+ * @return how many fibers timed out
+ */
+size_t expire_fibers(const uint64_t now_ns);
+
+/**
+ * Resumes every waiting fiber with a failed wait, and fails every wait after this, for when the loop stops
+ */
+void cancel_fibers();
+
+/**
+ * Unmaps the stacks of the finished fibers the thread kept, and frees their arenas
+ */
+void release_fibers();
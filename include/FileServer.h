@@ -0,0 +1,125 @@
+#pragma once
+
+#include "Arena.h"
+#include "DateCache.h"
+#include "HttpMessage.h"
+#include "StringRef.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <sys/stat.h>
+
+// how many files the cache keeps open, every one of them holds a file descriptor
+constexpr size_t FILE_CACHE_SLOTS = 256;
+
+// how many slots after the hashed one a file can be put in
+constexpr size_t FILE_CACHE_PROBES = 8;
+
+// how long the stat of a cached file is trusted before checking the file on disk again
+constexpr uint64_t FILE_CACHE_TTL_NS = 1000000000;
+
+// the file served when a directory is requested
+constexpr char FILE_INDEX_NAME[] = "index.html";
+
+/**
+ * An open file with its stat, shared by every request for the same path
+ */
+struct FileEntry {
+	StringOwn            path;                         // the sanitized path, relative to the base directory, the key of the entry
+	StringRef            mime;                         // the content type, from the extension of the file
+	struct stat          info;                         // the stat of the open file
+	atomic_uint_fast64_t checked_ns;                   // monotonic time of the last check of the file on disk
+	atomic_uint          refs;                         // one for the cache and one for every request using the file, closed when it reaches 0
+	int                  fd;                           // the open file
+	char                 last_modified[HTTP_DATE_LEN]; // the mtime as an http date, formatted when the file is opened
+	uint8_t              compression;                  // how hard to compress it for its type and size, one of CompressionTier
+};
+
+/**
+ * Open files by path, looked up under a read lock so the requests for the hot files do not wait for each other
+ * an entry is replaced when the file changes or the slots after its hash are full, removed when the file is gone
+ */
+typedef struct {
+	FileEntry       *slots[FILE_CACHE_SLOTS]; // the entries, nullptr for an empty slot
+	pthread_rwlock_t lock;                    // taken for writing only to replace an entry
+	int              root_fd;                 // the base directory, every path is opened relative to it
+} FileCache;
+
+/**
+ * Opens the base directory and prepares an empty cache
+ *
+ * @param[in] `base_dir` the directory to serve the files from
+ * @param[out] `cache` the cache to initialize
+ *
+ * @return false if the directory can not be opened
+ */
+bool initialize_FileCache(const StringRef *base_dir, FileCache *cache);
+
+/**
+ * Closes every cached file and the base directory, the entries still acquired are closed when released
+ *
+ * @param[in] `cache` the cache to destroy
+ */
+void destroy_FileCache(FileCache *cache);
+
+/**
+ * Turns a request path in a path relative to the base directory, the url encoding is decoded
+ * the empty and '.' segments are removed, a path with a '..' segment or a null byte is refused
+ *
+ * @param[in] `url` the path of the request, without the query
+ * @param[in] `arena` where to allocate the result
+ * @param[out] `path` the relative path, null terminated, "." for the base directory itself
+ *
+ * @return false if the path would escape the base directory
+ */
+bool sanitize_path(const StringRef *url, Arena *arena, StringOwn *path);
+
+/**
+ * Finds the file in the cache, opening it if it is not there or it changed on disk
+ * a directory is resolved to its FILE_INDEX_NAME
+ *
+ * @param[in] `cache` the cache to look in
+ * @param[in] `path` the sanitized path of the file
+ *
+ * @return the entry, to give back with release_file, nullptr if the file can not be served
+ */
+FileEntry *acquire_file(FileCache *cache, const StringOwn *path);
+
+/**
+ * Takes another reference to an entry already acquired
+ *
+ * @param[in] `entry` the entry to keep open
+ *
+ * @return the same entry
+ */
+FileEntry *retain_file(FileEntry *entry);
+
+/**
+ * Gives back an entry, closing the file if it was the last user
+ *
+ * @param[in] `entry` the entry obtained by acquire_file
+ */
+void release_file(FileEntry *entry);
+
+/**
+ * Serves the files under the base directory given to initialize_file_server, for GET and HEAD
+ * the files up to ASSET_MAX_SIZE are sent from the asset cache, compressed with the best encoding the client accepts
+ * the bigger ones are left in `file` of the response, still acquired, and not read
+ * a HEAD gets the same header fields a GET would, it makes the asset too
+ */
+void serve_file(const HTTP_Method *method, const InboundHttpMessage *in_message, OutboundHttpMessage *out_message);
+
+/**
+ * Prepares the cache used by serve_file
+ *
+ * @param[in] `base_dir` the directory to serve the files from
+ *
+ * @return false if the directory can not be opened
+ */
+bool initialize_file_server(const StringRef *base_dir);
+
+/**
+ * Destroys the cache used by serve_file
+ */
+void destroy_file_server();
@@ -1,9 +1,21 @@
 #pragma once
+#include "Arena.h"
 #include "MiniMap_StringRef_StringRef.h"
-#include "MiniMap_u_char_StringOwn.h"
 
 #include <stdint.h>
 
+// how many header fields of a request are looked at, the rest are ignored
+constexpr size_t HTTP_MAX_HEADER_FIELDS = 100;
+
+// the bytes first allocated for the header fields of a response, they grow in the arena if needed
+constexpr size_t HEADER_BUILDER_CAPACITY = 512;
+
+// the most pieces compose_message splits a message in
+constexpr size_t MESSAGE_PARTS = 5;
+
+// the status codes are all below this, the size of the table of the status lines
+constexpr uint16_t HTTP_STATUS_LIMIT = 600;
+
 // http method code
 typedef enum : uint8_t {
 	HTTP_INVALID_METHOD,
@@ -29,6 +41,15 @@ typedef enum : uint8_t {
 	HTTP_VER_ENUM_LEN,
 } HTTP_Version;
 
+// the content codings a response body can have
+typedef enum : uint8_t {
+	ENCODING_IDENTITY,
+	ENCODING_GZIP,
+	ENCODING_BROTLI,
+	ENCODING_ZSTD,
+	ENCODING_ENUM_LEN,
+} ContentEncoding;
+
 typedef enum : uint8_t {
 	// ReQuest options
 	RQ_A_IM,
@@ -130,15 +151,17 @@ typedef enum : uint8_t {
 
 /*
  * I use two representation of an http message for 2 reasons,
- * 1. the inbound include the entire raw message allocated, message used by every stringRef in the struct,
+ * 1. the inbound references the entire raw message, in the receive buffer, used by every stringRef in the struct,
  * the outbound message does not contain the raw message, the parameters (form or query), the requested url and the request method,
  * but makes use of a numeric status code, these differences make the outbound one much smaller
  *
  * 2. the inbound can make use of a lot of const strings, the outbound cannot
+ *
+ * What they allocate is in the arena of the thread resolving the request, nothing has to be freed, the arena is reset once the response is sent
  */
 
 typedef struct {
-	char                       *raw_message_a;               // the c string containing the entire header, the _a means it's heap allocated
+	StringRef                   raw_message;                 // the entire request, in the receive buffer of the connection that must outlive the message
 	size_t                      header_len;                  // how many bytes are there in the header
 	MiniMap_StringRef_StringRef parameters;                  // contain the data sent in the forms and query parameters
 	StringRef                   header_options[RQ_ENUM_LEN]; // an 'hash map' where to store the decoded header options
@@ -148,21 +171,67 @@ typedef struct {
 	uint8_t                     version;                     // the version of the http header (1.0, 1.1, 2.0, ...)
 } InboundHttpMessage;
 
+// an open file of the FileServer cache
+typedef struct FileEntry FileEntry;
+
+// a prepared response body of the AssetCache
+typedef struct Asset Asset;
+
+// sends a body given in pieces
+typedef struct BodyWriter BodyWriter;
+
+/**
+ * Writes the body of a response after its header, with write_body and flush_body, the server finishes it
+ * the memory of a response stays bounded however long the body is
+ *
+ * @param[in] `writer` where to write the body
+ * @param[in] `state` what the processor left in `producer_state`
+ *
+ * @return false to abort the response, the client sees a truncated body and the connection is closed
+ */
+typedef bool (*BodyProducer)(BodyWriter *writer, void *state);
+
+// where the field of a known option is in the header block
 typedef struct {
-	MiniMap_u_char_StringOwn header_options; // represent the header as the collection of the single options -> value
-	size_t                   header_len;     // how many bytes are there in the header
-	StringOwn                body;           // the content of the message, what the message is about
-	StringOwn                resource_name;  // the internal complete name for the resource present in the body
-	uint16_t                 status_code;    // 200, 404, 500, etc etc
-	uint8_t                  version;        // the version of the http header (1.0, 1.1, 2.0, ...)
+	uint32_t start; // the first byte of the field, its name
+	uint32_t len;   // the whole field, "Name: value\r\n", 0 if the option is not set
+} HeaderSlot;
+
+/**
+ * The header fields of a response, already formatted one after the other as they are sent
+ * the known options are found through their slot, the custom fields are only appended
+ */
+typedef struct {
+	char      *buffer;             // the fields, in the arena of the message
+	size_t     len;                // the bytes of the fields
+	size_t     capacity;           // the bytes the buffer can hold
+	HeaderSlot slots[RP_ENUM_LEN]; // the field of every known option
+} HeaderBuilder;
+
+typedef struct {
+	HeaderBuilder headers;        // the header fields, composed as they are added
+	StringOwn     body;           // the content of the message, what the message is about
+	StringOwn     resource_name;  // the internal complete name for the resource present in the body
+	FileEntry    *file;           // sent after the header in place of the body, nullptr if the body is in memory
+	Asset        *asset;          // the cached asset the body points in, released once the response is sent
+	BodyProducer  producer;       // writes the body after the header, sent chunked in place of `body`, nullptr if the body is in memory
+	void         *producer_state; // given to the producer, in the arena if it has to be allocated
+	uint16_t      status_code;    // 200, 404, 500, etc etc
+	Arena        *arena;          // where the header fields, the body and the composed message are allocated
+	uint8_t       version;        // the version of the http header (1.0, 1.1, 2.0, ...)
 } OutboundHttpMessage;
 
 typedef void (*MessageProcessor)(const HTTP_Method *method, const InboundHttpMessage *in_message, OutboundHttpMessage *out_message);
 
-InboundHttpMessage parse_InboundMessage(const char *str);
-
-void destroy_InboundHttpMessage(InboundHttpMessage *mex);
-void destroy_OutboundHttpMessage(OutboundHttpMessage *mex);
+/**
+ * Parse the given request in place, every StringRef of the message points in the buffer, nothing is copied
+ *
+ * @param buffer the request, as framed in the receive buffer, it does not need a null terminator
+ * @param len the length of the request, header and body
+ * @param arena where to allocate the parameters map
+ * @return the parsed message, valid until the buffer is modified or the arena is reset
+ */
+InboundHttpMessage parse_InboundMessage(const char *buffer, const size_t len, Arena *arena);
 
 /**
  * deconstruct the raw header in a map with key (option) -> value
@@ -181,13 +250,32 @@ void decompose_header(const StringRef *raw_header, InboundHttpMessage *msg);
 void decompose_message(InboundHttpMessage *msg);
 
 /**
- * Unite the header and the body in a single message and returns it
- * the compiled message does not have a null terminator and must be freed
+ * The whole status line of a response, with its \r\n, the known codes are taken from a table
+ *
+ * @param status_code the code of the response
+ * @param version the version of the request, the response is HTTP/1.1 unless it asked for an older one
+ * @param arena where to format the line of a code the table does not know
+ * @return the line, not null terminated
+ */
+StringRef get_status_line(const uint16_t status_code, const uint8_t version, Arena *arena);
+
+/**
+ * Lists the pieces of the message in the order they are sent, nothing is copied
+ * the status line, the date, the header fields, the blank line and the body, the empty ones are left out
  *
  * @param msg the message containing the header options and, eventually, the body
- * @return the 'compiled' message
+ * @param parts where to put the pieces, at least MESSAGE_PARTS of them
+ * @return how many parts were written
  */
-StringOwn compose_message(const OutboundHttpMessage *msg);
+size_t compose_message(const OutboundHttpMessage *msg, StringRef *parts);
+
+/**
+ * Tells if the client wants the connection to stay open after the response, from the http version and the Connection header
+ *
+ * @param msg the request received
+ * @return true if the connection should be persistent
+ */
+bool is_keep_alive(const InboundHttpMessage *msg);
 
 /**
  * Given a String representing the request method (GET, POST, PATCH, ...) returns the relative code
@@ -206,10 +294,11 @@ u_char get_method_code(const StringRef *request_method);
 u_char get_version_code(const StringRef *http_version);
 
 /**
- * Given a string representing an header options (Content-type, Content-length, ...)
+ * Given a string representing an header options (Content-type, Content-length, ...), case insensitive
+ * looked up in the perfect hash generated by header_hash.py
  *
  * @param version the StringRef containing the option
- * @return the code representing the relative option
+ * @return the code representing the relative option, RQ_ENUM_LEN if the option is not known
  */
 u_char get_parameter_code(const StringRef *parameter);
 
@@ -229,16 +318,43 @@ void parse_options(const StringRef *segment, void (*fun)(StringRef a, StringRef
 // void      parseFormData(const std::string &params, std::string &divisor, std::unordered_map<std::string, std::string> &parameters);
 
 /**
- * Given the header option code and the relative values copies i  in the residente nel
- * dell'utente inizializza
- * of bytes stored
+ * Writes the field of the option in the header of the message, replacing the one already there
+ * the value is cut at its first null byte
  *
  * @param option the header option code
  * @param value the string value to assign to the option
- * @param msg the httpMessage that contains the header options map
+ * @param msg the httpMessage that holds the header
  */
 void add_header_option(const HTTPHeaderResponseOption option, const StringRef *value, OutboundHttpMessage *msg);
 
+/**
+ * Appends a field with a name that is not one of HTTPHeaderResponseOption, it can not be replaced nor looked up
+ *
+ * @param name the name of the field, without the ':'
+ * @param value the value of the field
+ * @param msg the httpMessage that holds the header
+ */
+void add_custom_header(const StringRef *name, const StringRef *value, OutboundHttpMessage *msg);
+
+/**
+ * Appends fields formatted beforehand, with a single copy, their options can be replaced and looked up as if added one by one
+ * an option that was already set is replaced by the one in the fields
+ *
+ * @param fields the fields to append, their buffer is not kept
+ * @param msg the httpMessage that holds the header
+ */
+void add_header_fields(const HeaderBuilder *fields, OutboundHttpMessage *msg);
+
+/**
+ * The value of an option already in the header of the message
+ *
+ * @param option the header option code
+ * @param msg the httpMessage that holds the header
+ * @param value where to put the value, it points in the header
+ * @return false if the option is not set
+ */
+bool get_header_option(const HTTPHeaderResponseOption option, const OutboundHttpMessage *msg, StringRef *value);
+
 /**
  * Simple makes sure that a copy of the passed stringRef is inserted in the url of the http message
  *
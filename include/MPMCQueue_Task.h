@@ -0,0 +1,76 @@
+#pragma once
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdlib.h>
+
+//
+
+#include "Task.h"
+
+#define MPMCQueue MPMCQueue_Task
+
+// one slot of the queue, `sequence` tells if in the current lap the slot is ready to be written or to be read
+typedef struct {
+	atomic_size_t sequence; // equal to the position when free, position + 1 when it holds data
+	Task             data;     // the element
+} MPMCQueue_Task_Cell;
+
+/**
+ * A bounded, lock free, multi producer multi consumer queue (Dmitry Vyukov's design)
+ *
+ * Producers and consumers only contend on their own counter with a compare and swap,
+ * the two counters live on different cache lines so a producer never slows down a consumer
+ */
+typedef struct {
+	MPMCQueue_Task_Cell       *cells;       // the slots, always a power of two
+	size_t                    mask;        // how many slots - 1, to wrap the positions
+	alignas(64) atomic_size_t enqueue_pos; // the next position to write
+	alignas(64) atomic_size_t dequeue_pos; // the next position to read
+} MPMCQueue;
+
+/**
+ * Makes a MPMCQueue able to hold at least `capacity` elements
+ *
+ * @param[in] `capacity` how many elements can be stored at once, rounded up to a power of two, defaults to 1024 if zero is specified
+ * @param[out] `res` the queue to initialize, it must not be copied afterwards
+ */
+void MPMCQueue_Task_make(const size_t capacity, MPMCQueue *res);
+
+/**
+ * Frees all the resource allocated by queue, must not be used by any thread anymore
+ *
+ * @param[in] `queue` the MPMCQueue to destroy
+ */
+void MPMCQueue_Task_destroy(MPMCQueue *queue);
+
+/**
+ * Append a copy of the element at the end of the queue, can be called by any thread
+ *
+ * @param[in] `queue` the MPMCQueue where to append the data
+ * @param[in] `element` a pointer to the data to be appended
+ *
+ * @return false if the queue is full
+ */
+bool MPMCQueue_Task_push(MPMCQueue *queue, const Task *element);
+
+/**
+ * Remove the oldest element from the queue, can be called by any thread
+ *
+ * @param[in] `queue` the MPMCQueue to get the element from
+ * @param[out] `result` where to place the element
+ *
+ * @return false if the queue is empty
+ */
+bool MPMCQueue_Task_pop(MPMCQueue *queue, Task *result);
+
+/**
+ * How many elements are in the queue, only an estimate if other threads are using it
+ *
+ * @param[in] `queue` the MPMCQueue to count the elements of
+ *
+ * @return the amount of elements stored
+ */
+size_t MPMCQueue_Task_count(MPMCQueue *queue);
+
+#undef MPMCQueue
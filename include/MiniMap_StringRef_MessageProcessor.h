@@ -25,6 +25,18 @@ typedef struct {
  */
 MiniMap MiniMap_StringRef_MessageProcessor_make(const size_t initial_count, bool (*eq)(const StringRef *, const StringRef *));
 
+/**
+ * Makes a MiniMap with a preallocated array of initial_count length, allocated in the given arena
+ * the memory is released when the arena is reset, destroying the MiniMap is not needed
+ *
+ * @param[in] `initial_count` how many elements to preallocate, defaults to 10 if zero is specified
+ * @param[in] `eq` a function to compare the equality of two keys
+ * @param[in] `arena` the arena to allocate from
+ *
+ * @return a built MiniMap
+ */
+MiniMap MiniMap_StringRef_MessageProcessor_make_arena(const size_t initial_count, bool (*eq)(const StringRef *, const StringRef *), Arena *arena);
+
 /**
  * Frees up all the resources allocated by the miniMap
  *
@@ -1,5 +1,7 @@
 #pragma once
 
+#include "Arena.h"
+
 #include <stddef.h>
 #include <stdlib.h>
 
@@ -13,6 +15,7 @@ typedef struct {
 	StringRef     *data;     // data ptr
 	size_t capacity; // total allocated bytes
 	size_t count;    // how many elements are stored at the moment / the first index that can be used
+	Arena *arena;    // where data is allocated, nullptr for the heap
 } MiniVector;
 
 /**
@@ -24,6 +27,17 @@ typedef struct {
  */
 MiniVector MiniVector_StringRef_make(const size_t initial_count);
 
+/**
+ * Makes a MiniVector with a preallocated array of initial_count length, allocated in the given arena
+ * the memory is released when the arena is reset, destroying the MiniVector is not needed
+ *
+ * @param[in] `initial_count` how many elements to preallocate, defaults to 10 if zero is specified
+ * @param[in] `arena` the arena to allocate from
+ *
+ * @return a built MiniVector
+ */
+MiniVector MiniVector_StringRef_make_arena(const size_t initial_count, Arena *arena);
+
 /**
  * Frees all the resource allocated by vec
  *
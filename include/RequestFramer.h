@@ -0,0 +1,68 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef enum : uint8_t {
+	FRAME_HEADER,     // looking for the \r\n\r\n at the end of the header
+	FRAME_BODY,       // reading Content-Length bytes of body
+	FRAME_CHUNK_SIZE, // reading the hex size line of a chunk
+	FRAME_CHUNK_DATA, // reading the data of a chunk
+	FRAME_CHUNK_CRLF, // reading the \r\n after the data of a chunk
+	FRAME_TRAILER,    // reading the trailer after the last chunk, until an empty line
+	FRAME_DONE,       // the request is complete
+	FRAME_ERROR,      // the request is malformed or too big, the status to answer with is in `error_status`
+} FrameState;
+
+/**
+ * Incremental framing of an http request in a buffer that is filled a piece at a time
+ *
+ * Every byte is looked at once, `read` only moves forward, so it can be called again every time new data arrives.
+ * A chunked body is decoded in place, the data of the chunks is moved right after the header, so once done the whole request is
+ * contiguous in [0, write) and what comes after `read` belongs to the next (pipelined) request.
+ *
+ * The invariant write <= read always holds, in every state but the chunked ones they are equal
+ */
+typedef struct {
+	size_t   read;         // bytes of the buffer already consumed
+	size_t   write;        // the end of the decoded request
+	size_t   header_len;   // length of the header, without the \r\n\r\n
+	size_t   body_start;   // where the body starts, right after the \r\n\r\n
+	size_t   remaining;    // bytes still to come for the Content-Length body or the current chunk
+	size_t   max_header;   // the biggest header accepted
+	size_t   max_body;     // the biggest (decoded) body accepted
+	uint16_t error_status; // 400, 413, 431 or 501 when the state is FRAME_ERROR
+	uint8_t  matched;      // how many characters of "\r\n\r\n" have just been seen, or of the chunk size line
+	uint8_t  state;        // one of FrameState
+} RequestFramer;
+
+/**
+ * Prepare the framer for a new request
+ *
+ * @param[out] `framer` the framer to reset
+ * @param[in] `max_header` the biggest header accepted, bigger ones are answered with 431
+ * @param[in] `max_body` the biggest body accepted, bigger ones are answered with 413
+ */
+void reset_RequestFramer(RequestFramer *framer, const size_t max_header, const size_t max_body);
+
+/**
+ * Frame as much as possible of the data in the buffer
+ *
+ * @param[in] `framer` the framer to advance
+ * @param[in] `buffer` the buffer holding the request, the chunked body is decoded in it
+ * @param[in] `len` how many bytes are in the buffer
+ *
+ * @return the new state, FRAME_DONE or FRAME_ERROR are final, any other one means more data is needed
+ */
+uint8_t advance_RequestFramer(RequestFramer *framer, char *buffer, const size_t len);
+
+/**
+ * Move the data not yet consumed over the bytes freed by the chunked decoding, to make space in the buffer
+ *
+ * @param[in] `framer` the framer working on the buffer
+ * @param[in] `buffer` the buffer to compact
+ * @param[in] `len` how many bytes are in the buffer
+ *
+ * @return the new amount of bytes in the buffer
+ */
+size_t compact_RequestFramer(RequestFramer *framer, char *buffer, const size_t len);
@@ -1,10 +1,7 @@
 #pragma once
 
-#include "tcpConn.h"
-
-#include <openssl/types.h>
+#include "Connection.h"
 
 typedef struct {
-	SSL   *ssl;
-	Socket client_socket;
+	Connection *connection; // the connection ready to be resolved, owned by the thread that dequeues it
 } ResolverData;
@@ -0,0 +1,81 @@
+#pragma once
+
+#include "HttpMessage.h"
+#include "StringRef.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+// the most path parameters a single route can capture, the others are matched but not captured
+constexpr size_t ROUTER_MAX_PARAMS = 8;
+
+typedef enum : uint8_t {
+	ROUTE_STATIC,   // matches the text of `label`
+	ROUTE_PARAM,    // matches a single non empty segment, until the next '/', `label` is the name of the parameter
+	ROUTE_WILDCARD, // matches everything until the end of the path, `label` is the name of the parameter
+} RouteNodeType;
+
+typedef struct RouteNode RouteNode;
+
+/**
+ * A node of the compressed radix tree, the static children never share the first character of their label
+ */
+struct RouteNode {
+	StringOwn        label;       // the text matched by a static node, the parameter name for the others
+	RouteNode      **children;    // the static children
+	RouteNode       *param;       // the child matching a `:param` segment, if any
+	RouteNode       *wildcard;    // the child matching a `*wildcard`, if any
+	MessageProcessor processor;   // the function handling the route that ends here, nullptr if none does
+	size_t           child_count; // how many static children there are
+	uint8_t          type;        // one of RouteNodeType
+};
+
+/**
+ * Routes registered for a method, or for any method, looked up in O(length of the path) however many routes there are
+ *
+ * A route is a path like `/user/:id/files`, `:id` matches a single segment,
+ * a `*path` at the end of the route matches the rest of the path, both are captured by name.
+ * Static text is preferred to a parameter, and a parameter to a wildcard
+ */
+typedef struct {
+	RouteNode       *trees[HTTP_ENUM_LEN]; // one tree for every method, the one at HTTP_INVALID_METHOD holds the routes for any method
+	MessageProcessor fallback;             // called when no route matches, can be nullptr
+} Router;
+
+/**
+ * The result of a lookup, with the captured path parameters
+ */
+typedef struct {
+	StringRef names[ROUTER_MAX_PARAMS];  // the names of the parameters, without ':' or '*'
+	StringRef values[ROUTER_MAX_PARAMS]; // the value of each parameter, in the url
+	size_t    count;                     // how many parameters were captured
+} RouteMatch;
+
+/**
+ * Frees every node of the router, a zero initialized router is empty and valid
+ *
+ * @param[in] `router` the router to destroy
+ */
+void destroy_Router(Router *router);
+
+/**
+ * Registers `processor` for `route` on the given method
+ *
+ * @param[in] `router` the router to add the route to
+ * @param[in] `method` the method the route answers to, HTTP_INVALID_METHOD for any
+ * @param[in] `route` the path of the route, nullptr to set the fallback
+ * @param[in] `processor` the function handling the route, nullptr to remove it
+ */
+void add_route(Router *router, const uint8_t method, const StringRef *route, const MessageProcessor processor);
+
+/**
+ * Finds the processor for the given method and url, the routes of the method are preferred to the ones for any method
+ *
+ * @param[in] `router` the router to look in
+ * @param[in] `method` the method of the request
+ * @param[in] `url` the path of the request, without the query
+ * @param[out] `match` the parameters captured by the route
+ *
+ * @return the processor of the route, the fallback if no route matches
+ */
+MessageProcessor find_route(const Router *router, const uint8_t method, const StringRef *url, RouteMatch *match);
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <stdint.h>
+
+/**
+ * What a task does, on the worker that took it
+ *
+ * @param[in] `worker_data` the argument the thread pool was initialized with
+ * @param[in] `arg` the argument of the task
+ */
+typedef void (*TaskFunction)(void *worker_data, void *arg);
+
+typedef struct {
+	TaskFunction run;        // nullptr when no task was taken
+	void        *arg;        // owned by the task until it runs
+	uint64_t     enqueue_ns; // when the pool got the task, 0 if its wait is not measured
+} Task;
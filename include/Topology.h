@@ -0,0 +1,72 @@
+#pragma once
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <tcpConn.h>
+
+// the cpus the topology knows about, the ids above are treated as unknown
+constexpr size_t TOPOLOGY_MAX_CPUS = 1024;
+
+// the numa nodes looked for in sysfs
+constexpr uint16_t TOPOLOGY_MAX_NODES = 64;
+
+// no numa node in particular, for the connections whose node is not known and the threads that are not pinned
+constexpr uint16_t NODE_ANY = UINT16_MAX;
+
+typedef enum : uint8_t {
+	AFFINITY_NONE, // the threads run where the kernel puts them
+	AFFINITY_CORE, // every worker on a single cpu, the cpus of a node are taken before the next
+	AFFINITY_NODE, // every worker on all the cpus of a numa node, the nodes in turn
+	AFFINITY_ENUM_LEN,
+} AffinityMode;
+
+/**
+ * Reads the cpus the process can run on and the numa node of each from sysfs
+ * a machine without numa, or without sysfs, is a single node with every cpu
+ * called once, before the threads start
+ */
+void load_topology();
+
+/**
+ * How many numa nodes have cpus the process can run on
+ */
+size_t topology_node_count();
+
+/**
+ * The cpu that AFFINITY_CORE gives to a worker
+ *
+ * @param[in] `worker` the index of the worker
+ *
+ * @return -1 if the topology was not loaded
+ */
+int topology_cpu(const size_t worker);
+
+/**
+ * Sets where the thread of a worker runs, before it is created
+ *
+ * @param[in] `mode` one of AffinityMode
+ * @param[in] `worker` the index of the worker, the cpus or nodes are given in turn
+ * @param[out] `attr` the attributes of the thread, its affinity is left alone with AFFINITY_NONE
+ *
+ * @return the numa node the thread runs on, NODE_ANY with AFFINITY_NONE
+ */
+uint16_t set_worker_affinity(const uint8_t mode, const size_t worker, pthread_attr_t *attr);
+
+/**
+ * Pins the calling thread on the cpus of a numa node
+ *
+ * @param[in] `node` the node to run on
+ *
+ * @return false if the node has no cpu for the process or the kernel refused
+ */
+bool pin_to_node(const uint16_t node);
+
+/**
+ * The numa node of the cpu that received the last packets of the socket, the one the network card interrupts
+ *
+ * @param[in] `socket` a connected socket
+ *
+ * @return NODE_ANY if the kernel does not say
+ */
+uint16_t socket_node(const Socket socket);
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "Task.h"
+
+#include <stdatomic.h>
+#include <stddef.h>
+
+// how many tasks a worker can give itself, a power of two, the others go in its inbox
+constexpr size_t WORK_DEQUE_CAPACITY = 256;
+
+// a slot of a WorkDeque, the two halves are read apart by the thieves, a torn read is discarded by the failed claim
+typedef struct {
+	_Atomic(TaskFunction) run;
+	_Atomic(void *)       arg;
+} TaskSlot;
+
+/**
+ * A bounded Chase-Lev deque, the worker that owns it pushes and pops at the bottom, newest first
+ * the other workers steal from the top, oldest first, so they rarely touch the same slot
+ */
+typedef struct {
+	alignas(64) atomic_ptrdiff_t top;    // the next task to steal, only grows
+	alignas(64) atomic_ptrdiff_t bottom; // one past the newest task, only the owner writes it
+	TaskSlot *slots;                     // WORK_DEQUE_CAPACITY of them
+} WorkDeque;
+
+/**
+ * Allocates the slots of an empty WorkDeque, on the numa node of the calling thread
+ *
+ * @param[out] `res` the deque to initialize
+ */
+void make_WorkDeque(WorkDeque *res);
+
+/**
+ * Frees the slots of the deque, no thread may use it anymore
+ *
+ * @param[in] `deque` the deque to destroy
+ */
+void destroy_WorkDeque(WorkDeque *deque);
+
+/**
+ * Adds a task at the bottom, only the owner can call it
+ *
+ * @param[in] `deque` the deque of the calling thread
+ * @param[in] `task` the task, copied
+ *
+ * @return false if the deque is full
+ */
+bool push_WorkDeque(WorkDeque *deque, const Task *task);
+
+/**
+ * Takes the newest task, from the bottom, only the owner can call it
+ *
+ * @param[in] `deque` the deque of the calling thread
+ * @param[out] `task` where to put the task
+ *
+ * @return false if the deque is empty, or a thief took its last task
+ */
+bool pop_WorkDeque(WorkDeque *deque, Task *task);
+
+/**
+ * Takes the oldest task, from the top, any thread can call it
+ *
+ * @param[in] `deque` the deque of another thread
+ * @param[out] `task` where to put the task
+ *
+ * @return false if the deque is empty, or the owner or another thief took the task first
+ */
+bool steal_WorkDeque(WorkDeque *deque, Task *task);
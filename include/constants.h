@@ -24,6 +24,13 @@ static const StringRef versions_str[] = {
     TO_STRINGREF("HTTP/3"),
 };
 
+static const StringRef content_encodings_str[] = {
+    TO_STRINGREF("identity"),
+    TO_STRINGREF("gzip"),
+    TO_STRINGREF("br"),
+    TO_STRINGREF("zstd"),
+};
+
 // Beautifully compile-time evaluated lookup tables for header options
 static const StringRef header_request_options_str[] = {
     TO_STRINGREF("A-IM"),
@@ -121,49 +128,5 @@ static const StringRef header_response_options_str[] = {
     TO_STRINGREF("Status"),
 };
 
-// keeping this for consistency with the other strings
-// but this should not be used
-static const StringRef reason_phrases_str[] = {
-    TO_STRINGREF("Continue"),
-    TO_STRINGREF("Switching Protocols"),
-    TO_STRINGREF("OK"),
-    TO_STRINGREF("Created"),
-    TO_STRINGREF("Accepted"),
-    TO_STRINGREF("Non-Authoritative Information"),
-    TO_STRINGREF("No Content"),
-    TO_STRINGREF("Reset Content"),
-    TO_STRINGREF("Partial Content"),
-    TO_STRINGREF("Multiple Choices"),
-    TO_STRINGREF("Moved Permanently"),
-    TO_STRINGREF("Found"),
-    TO_STRINGREF("See Other"),
-    TO_STRINGREF("Not Modified"),
-    TO_STRINGREF("Use Proxy"),
-    TO_STRINGREF("Temporary Redirect"),
-    TO_STRINGREF("Bad Request"),
-    TO_STRINGREF("Unauthorized"),
-    TO_STRINGREF("Payment Required"),
-    TO_STRINGREF("Forbidden"),
-    TO_STRINGREF("Not Found"),
-    TO_STRINGREF("Method Not Allowed"),
-    TO_STRINGREF("Not Acceptable"),
-    TO_STRINGREF("Proxy Authentication Required"),
-    TO_STRINGREF("Request Time-out"),
-    TO_STRINGREF("Conflict"),
-    TO_STRINGREF("Gone"),
-    TO_STRINGREF("Length Required"),
-    TO_STRINGREF("Precondition Failed"),
-    TO_STRINGREF("Request Entity Too Large"),
-    TO_STRINGREF("Request-URI Too Large"),
-    TO_STRINGREF("Unsupported Media Type"),
-    TO_STRINGREF("Requested range not satisfiable"),
-    TO_STRINGREF("Expectation Failed"),
-    TO_STRINGREF("Internal Server Error"),
-    TO_STRINGREF("Not Implemented"),
-    TO_STRINGREF("Bad Gateway"),
-    TO_STRINGREF("Service Unavailable"),
-    TO_STRINGREF("Gateway Time-out"),
-    TO_STRINGREF("HTTP Version not supported")};
-
 constexpr unsigned char server_version_major = 4;
 constexpr unsigned char server_version_minor = 0;
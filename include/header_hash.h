@@ -0,0 +1,25 @@
+#pragma once
+// generated by header_hash.py from include/constants.h, do not edit
+
+#include "HttpMessage.h"
+
+#include <stdint.h>
+
+static_assert(RQ_ENUM_LEN == 41, "the request options changed, run header_hash.py again");
+
+constexpr uint32_t HEADER_HASH_SIZE   = 128;
+constexpr uint32_t HEADER_HASH_FIRST  = 4;
+constexpr uint32_t HEADER_HASH_LAST   = 18;
+constexpr uint32_t HEADER_HASH_MIDDLE = 19;
+
+// the request option code of every slot, RQ_ENUM_LEN if the slot is empty
+static const uint8_t header_hash_table[] = {
+    41, 41, 41, 41, 41,  2, 41, 41, 41, 23,  3,  8, 32, 41, 41, 41,
+     7, 41, 41, 41, 41, 41, 41, 15, 41, 41, 41, 41, 41, 28, 41, 35,
+    41, 10,  5, 41, 41, 41, 41, 22, 41, 41, 41,  1, 41, 41, 41, 37,
+    41, 41, 41, 12, 31, 21, 41, 29, 41, 41, 41, 17, 41, 41, 41, 41,
+    27,  4, 14, 41, 40, 41, 16, 41, 41, 11, 41, 33, 41, 41, 41, 41,
+    26, 20, 41, 18, 41, 41, 30, 41, 41, 41, 41, 41, 41, 41, 41, 41,
+    41, 41, 41,  6, 38, 36, 41, 41, 41, 34, 41, 41, 41, 41, 41, 41,
+    13, 25, 41, 24, 41, 39, 41, 41, 41,  0, 41, 41, 41,  9, 41, 19,
+};
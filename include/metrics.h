@@ -0,0 +1,61 @@
+#pragma once
+
+#include <stdatomic.h>
+#include <stdint.h>
+
+/**
+ * Counters updated by every thread of the server, all of them are relaxed atomics
+ * they are meant to be read for statistics, not for synchronization
+ */
+typedef struct {
+	atomic_uint_fast64_t handshakes_completed; // how many tls handshakes succeeded
+	atomic_uint_fast64_t handshakes_failed;    // how many tls handshakes failed or timed out
+	atomic_uint_fast64_t handshake_total_ns;   // sum of the time from accept to the end of the handshake
+	atomic_uint_fast64_t handshake_work_ns;    // sum of the time spent inside SSL_accept, the cpu cost of the handshakes
+	atomic_uint_fast64_t handshake_max_ns;     // the longest time from accept to the end of the handshake
+	atomic_uint_fast64_t idle_timeouts;        // how many connections were closed for waiting on the client for too long
+	atomic_uint_fast64_t pool_threads;         // how many threads the pool runs now
+	atomic_uint_fast64_t pool_threads_peak;    // the most threads the pool ran at once
+	atomic_uint_fast64_t pool_wait_ns;         // the average time a connection waited for a thread, in the last interval of the pool
+} Metrics;
+
+/**
+ * Set every counter to zero, before the threads that update them start
+ *
+ * @param[out] `metrics` the metrics to initialize
+ */
+void initialize_metrics(Metrics *metrics);
+
+/**
+ * Account a finished tls handshake
+ *
+ * @param[in] `metrics` the metrics to update
+ * @param[in] `total_ns` the time from the accept to the end of the handshake
+ * @param[in] `work_ns` the time spent inside SSL_accept
+ * @param[in] `success` if the handshake succeeded
+ */
+void record_handshake(Metrics *metrics, const uint64_t total_ns, const uint64_t work_ns, const bool success);
+
+/**
+ * Account the size of the thread pool after it was measured
+ *
+ * @param[in] `metrics` the metrics to update
+ * @param[in] `threads` the threads running now
+ * @param[in] `wait_ns` the average wait of the tasks
+ */
+void record_pool(Metrics *metrics, const uint64_t threads, const uint64_t wait_ns);
+
+/**
+ * Add the handshakes and the timeouts counted by a shard to the ones of the server, the pool counters are left alone
+ *
+ * @param[in] `metrics` the metrics of the server
+ * @param[in] `shard` the metrics of the shard, once its thread stopped
+ */
+void merge_metrics(Metrics *metrics, const Metrics *shard);
+
+/**
+ * Print the metrics on the log
+ *
+ * @param[in] `metrics` the metrics to print
+ */
+void log_metrics(const Metrics *metrics);
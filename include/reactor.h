@@ -0,0 +1,113 @@
+#pragma once
+
+#include "Connection.h"
+
+#include <pthread.h>
+#include <stdint.h>
+#include <tcpConn.h>
+
+// how many events are harvested by a single epoll_wait
+constexpr int REACTOR_MAX_EVENTS = 256;
+
+// how long epoll_wait blocks, so the reactor notices when it has to stop and when connections expire
+constexpr int REACTOR_WAIT_MS = 500;
+
+/**
+ * An edge triggered epoll instance that owns the listening socket and every client socket
+ *
+ * The listening socket is registered with a nullptr in the epoll data, the wake eventfd with a pointer to `wake_fd`,
+ * every client with the pointer to its Connection.
+ * Clients are registered as one shot, so only one thread at a time can own a connection.
+ *
+ * Only the reactor thread touches the epoll registrations and the idle list, workers give connections back through `reactor_return`
+ * so the reactor is the single owner of every connection waiting on the client, and can expire them safely.
+ * A local reactor serves its connections on its own thread, they are rearmed right away when returned
+ */
+typedef struct {
+	int             epoll_fd;        // the epoll instance
+	int             wake_fd;         // eventfd written by the workers when they return a connection
+	Socket          server_socket;   // the listening socket, non-blocking
+	uint64_t        idle_timeout_ns; // how long a connection can wait on the client before being closed
+	pthread_mutex_t returned_mutex;  // protects `returned`
+	Connection     *returned;        // stack of connections given back by the workers, linked through `next`
+	Connection     *idle_head;       // the connection waiting on the client since the longest time
+	Connection     *idle_tail;       // the connection waiting on the client since the shortest time
+	bool            local;           // only the reactor thread returns connections, false after initialize_reactor
+} Reactor;
+
+/**
+ * Creates the epoll instance and registers the given listening socket on it
+ *
+ * @param[in] `server_socket` the socket to accept clients from, it will be set to non-blocking
+ * @param[in] `idle_timeout_ns` how long a connection can wait on the client before being closed
+ * @param[out] `res` the reactor to initialize
+ *
+ * @return true if the reactor is usable
+ */
+bool initialize_reactor(const Socket server_socket, const uint64_t idle_timeout_ns, Reactor *res);
+
+/**
+ * Closes the epoll instance and destroys every connection still owned by the reactor, the listening socket is not closed
+ *
+ * @param[in] `reactor` the reactor to destroy
+ */
+void destroy_reactor(Reactor *reactor);
+
+/**
+ * Accept a single client from the listening socket, the client socket is already non-blocking
+ *
+ * @param[in] `reactor` the reactor to accept from
+ *
+ * @return the client socket, INVALID_SOCKET if no client is waiting to be accepted
+ */
+Socket reactor_accept(const Reactor *reactor);
+
+/**
+ * Register a new connection in the reactor, one shot, waiting for `events`
+ * must be called from the reactor thread
+ *
+ * @param[in] `reactor` the reactor to register in
+ * @param[in] `conn` the connection to register
+ * @param[in] `events` EPOLLIN or EPOLLOUT
+ *
+ * @return true if the connection was registered
+ */
+bool reactor_watch(Reactor *reactor, Connection *conn, const uint32_t events);
+
+/**
+ * Give a connection back to the reactor, to wait for `events` again
+ * can be called from any thread, after this call the connection must not be touched
+ * a local reactor rearms it on the spot, without waking itself
+ *
+ * @param[in] `reactor` the reactor to give the connection back to
+ * @param[in] `conn` the connection to return
+ * @param[in] `events` EPOLLIN or EPOLLOUT
+ */
+void reactor_return(Reactor *reactor, Connection *conn, const uint32_t events);
+
+/**
+ * Rearm every connection returned by the workers, called by the reactor thread when `wake_fd` is readable
+ *
+ * @param[in] `reactor` the reactor to collect the connections in
+ */
+void reactor_collect_returned(Reactor *reactor);
+
+/**
+ * Take the ownership of a connection that got an event, it is no longer subject to the idle timeout
+ * must be called from the reactor thread
+ *
+ * @param[in] `reactor` the reactor the connection is registered in
+ * @param[in] `conn` the connection to claim
+ */
+void reactor_claim(Reactor *reactor, Connection *conn);
+
+/**
+ * Destroy every connection that has been waiting on the client for longer than the idle timeout
+ * must be called from the reactor thread
+ *
+ * @param[in] `reactor` the reactor to expire the connections of
+ * @param[in] `now_ns` the current monotonic time
+ *
+ * @return how many connections were destroyed
+ */
+size_t reactor_expire(Reactor *reactor, const uint64_t now_ns);
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "StringRef.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+// how many bytes the scanning kernels look at, at a time
+constexpr size_t SCAN_BLOCK = 32;
+
+/**
+ * A single header field, name: value
+ * a line without ':' has the whole line as name and a nullptr value
+ */
+typedef struct {
+	StringRef name;  // the field name, trimmed
+	StringRef value; // the field value, trimmed
+} HeaderField;
+
+/**
+ * The name of the kernels chosen for this cpu at startup, "avx2", "sse2" or "scalar"
+ *
+ * @return a static string
+ */
+const char *scan_kernel_name();
+
+/**
+ * finds the first occurrence of chr in the first count bytes of str, SCAN_BLOCK bytes at a time
+ *
+ * @param[in] `str` the string to search into
+ * @param[in] `chr` the char to search for
+ * @param[in] `count` how many bytes of str to look at
+ *
+ * @return pointer to the character found or nullptr if no such character is found
+ */
+const char *scan_chr(const char *str, const char chr, const size_t count);
+
+/**
+ * finds needle in the first count bytes of haystack, SCAN_BLOCK candidate positions at a time
+ * only the positions where both the first and the last char of needle match are compared entirely
+ *
+ * @param[in] `haystack` the string to search into
+ * @param[in] `needle` the string to search for
+ * @param[in] `needle_len` the length of needle
+ * @param[in] `count` how many bytes of haystack to look at, needle must be entirely inside them
+ *
+ * @return a pointer to the first character of the occurence of needle in haystack, nullptr if not found
+ */
+const char *scan_str(const char *haystack, const char *needle, const size_t needle_len, const size_t count);
+
+/**
+ * Splits an header block in the request line and the header fields, finding every '\n' and ':' in a single pass
+ *
+ * @param[in] `header` the header block, without the final empty line
+ * @param[out] `request_line` the first line, without the \r\n
+ * @param[out] `fields` where to put the fields found
+ * @param[in] `max_fields` how many fields fit in `fields`, the rest are ignored
+ *
+ * @return how many fields were put in `fields`
+ */
+size_t tokenize_header(const StringRef *header, StringRef *request_line, HeaderField *fields, const size_t max_fields);
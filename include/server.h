@@ -1,41 +1,99 @@
 #pragma once
 
+#include "Connection.h"
 #include "StringRef.h"
+#include "metrics.h"
+#include "reactor.h"
+#include "sns.h"
 #include "threadpool.h"
 
 #include <sslConn.h>
 #include <tcpConn.h>
 
-// this shouldn't be here but it makes sense for preventing cyclic include
-typedef struct {
-	SSL_CTX   *ssl_context;
-	ThreadPool thread_pool;
-	pthread_t  request_acceptor;
-	time_t     start_time;
-	Socket     server_socket;
-} RuntimeInfo;
+// seconds an idle connection is kept open waiting for the next request
+constexpr unsigned DEFAULT_KEEP_ALIVE_TIMEOUT = 5;
+
+// requests served on a single connection before closing it
+constexpr unsigned DEFAULT_MAX_REQUESTS = 100;
+
+// the biggest request header accepted, bigger ones are answered with 431
+constexpr size_t DEFAULT_MAX_HEADER_SIZE = 16 * 1024;
+
+// the biggest request body accepted, bigger ones are answered with 413
+constexpr size_t DEFAULT_MAX_BODY_SIZE = 1024 * 1024;
+
+// the most threads the pool grows to for every cpu, the workers block on the disk and on the clients
+constexpr unsigned DEFAULT_THREADS_PER_CPU = 4;
 
 typedef struct {
 	StringRef      base_dir;
+	size_t         max_header_size;    // bytes, 0 for DEFAULT_MAX_HEADER_SIZE
+	size_t         max_body_size;      // bytes, 0 for DEFAULT_MAX_BODY_SIZE
+	unsigned       keep_alive_timeout; // seconds a connection can stay idle, 0 for DEFAULT_KEEP_ALIVE_TIMEOUT
+	unsigned       max_requests;       // requests per connection, 0 for DEFAULT_MAX_REQUESTS
+	unsigned       min_threads;        // the threads the pool keeps even when idle, 0 for one per cpu
+	unsigned       max_threads;        // the threads the pool can grow to, 0 for DEFAULT_THREADS_PER_CPU per cpu
+	uint8_t        affinity;           // one of AffinityMode, AFFINITY_NONE leaves the threads to the kernel
+	unsigned       shards;             // event loops with their own listener, each pinned on a cpu and serving its clients itself, 0 for a single loop and the pool
+	bool           steer_by_cpu;       // with shards, the kernel gives a client to the shard of the cpu that received it
 	unsigned short tcp_port;
 } SNSSettings;
 
+// this shouldn't be here but it makes sense for preventing cyclic include
+typedef struct RuntimeInfo {
+	SSL_CTX            *ssl_context;
+	ThreadPool          thread_pool;
+	Reactor             reactor;
+	Metrics             metrics;
+	SNSSettings         settings;
+	SNSServer           sns; // the routes, kept when the server restarts
+	pthread_t           request_acceptor;
+	bool                acceptor_pinned; // the event loop tried to move on the numa node that receives the packets
+	bool                shard;           // the event loop serves the connections itself, without a pool
+	bool                running;         // the thread of the shard started, it must be joined
+	struct RuntimeInfo *shards;          // the runtime of every shard, nullptr without shards
+	size_t              shard_count;
+	time_t              start_time;
+	Socket              server_socket;
+} RuntimeInfo;
+
 void SIGPIPE_handler(int os);
 
 /**
- * polls for activity on the server socket, ir receives a client start the resolveRequestSecure thread
+ * runs the reactor loop, accepts every client waiting on the server socket
+ * and gives the connections that are ready (handshake or request) to the thread pool, a shard serves them itself
  *
- * @param threadStop if true stops the infinite loop and exits
+ * @param rti the runtime info of the server, the loop exits when the thread pool is stopped
  */
 void accept_requests(RuntimeInfo *rti);
 
+/**
+ * advance the tls handshake of the given connection as much as possible without blocking
+ * and rearm it in the reactor for whatever the handshake needs next
+ *
+ * @param rti the runtime info holding the ssl context, the reactor and the metrics
+ * @param conn the connection to advance the handshake of
+ * @return true if the handshake is completed and the request is already available, the connection is still owned by the caller
+ */
+bool advance_handshake(RuntimeInfo *rti, Connection *conn);
+
+/**
+ * Called by the workers for every connection the reactor found ready, completes the handshake if needed and then resolves the request
+ * a persistent connection is given back to the reactor to wait for the next request
+ *
+ * @param rti the runtime info of the server
+ * @param conn the connection to serve
+ */
+void serve_connection(RuntimeInfo *rti, Connection *conn);
+
 /**
  * receive a client that wants to communicate and attempts to resolve it's request
  *
- * @param ssl_connection the ssl connection to communicate on
- * @param client_socket the socket of the client
+ * @param rti the runtime info of the server
+ * @param conn the connection, with the handshake completed, to communicate on
+ * @return true if the connection should be kept open for another request
  */
-void resolve_request(SSL *ssl_connection, const Socket client_socket);
+bool resolve_request(const RuntimeInfo *rti, Connection *conn);
 
 /**
  * Proxy function to be called by pthred that itself calls acceptRequestsSecure
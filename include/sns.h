@@ -1,13 +1,15 @@
 #pragma once
 
-#include "MiniMap_uint32_t_MessageProcessor.h"
+#include "Router.h"
 
 typedef struct {
-	MiniMap_uint32_t_MessageProcessor mapped_function;
+	Router router; // the routes registered, zero initialized is empty
 } SNSServer;
 
 /**
  * asks the `SNSserver` to call `fun` when any request on `route_name` is made
+ * the route can capture path parameters, `/user/:id` matches a single segment and a final `*path` the rest of the path,
+ * they are given to `fun` in the parameters of the inbound message
  *
  * @param[in] `rounte_name` the plain name of the route to intercept, 
  * 	nullptr for any route that is not already matched by another mapping
@@ -17,3 +19,21 @@ typedef struct {
  *
  */
 void register_rounte(const StringRef *route_name, const MessageProcessor *fun, SNSServer *server);
+
+/**
+ * same as register_rounte, but only for the requests with the given method
+ * a route registered for the method is preferred to the same route registered for any method
+ *
+ * @param[in] `method` the method to intercept
+ * @param[in] `rounte_name` the plain name of the route to intercept, it can not be nullptr
+ * @param[in] `fun` the function to be called to manage the http reqeust, nullptr to remove the mapping
+ * @oaram[in] `SNSServer` the server where to apply the mapping
+ */
+void register_method_route(const HTTP_Method method, const StringRef *route_name, const MessageProcessor *fun, SNSServer *server);
+
+/**
+ * removes every mapping of the server
+ *
+ * @param[in] `server` the server to clear
+ */
+void destroy_SNSServer(SNSServer *server);
@@ -1,55 +1,178 @@
 #pragma once
 
-#include "RingBuffer_ResolverData.h"
+#include "MPMCQueue_Task.h"
+#include "Task.h"
+#include "Topology.h"
+#include "WorkDeque.h"
 
 #include <pthread.h>
-#include <semaphore.h>
 #include <sslConn.h>
+#include <stdatomic.h>
 #include <stddef.h>
+#include <stdint.h>
+#include <sys/epoll.h>
 
-/**
- * A thread pool created exclusively for managing the resolveRequest function
- */
+// how many tasks can wait in the inbox of a worker, when every inbox is full the producer waits for the workers to catch up
+constexpr size_t THREADPOOL_INBOX_CAPACITY = 4096;
+
+// how many times a thread checks again for a task that has been counted but not yet published, before going to sleep
+constexpr unsigned THREADPOOL_SPIN_COUNT = 64;
+
+// how often the pool looks at the wait of the tasks and at the idle threads to change its size
+constexpr uint64_t THREADPOOL_RESIZE_INTERVAL_NS = 50000000;
+
+// above this average wait, from the enqueue to the dequeue, the pool grows by a quarter
+constexpr uint64_t THREADPOOL_GROW_WAIT_NS = 1000000;
+
+// the last thread retires after waiting this long for a task
+constexpr uint64_t THREADPOOL_IDLE_TIMEOUT_NS = 10000000000;
+
+// one task every this many from outside has its wait measured, the others do not read the clock
+constexpr size_t THREADPOOL_WAIT_SAMPLE = 8;
+
+// how many events of its epoll instance poll_threadpool gives back at once
+constexpr int THREADPOOL_POLL_EVENTS = 64;
+
+typedef enum : uint8_t {
+	WORKER_STOPPED,  // no thread, or one already joined
+	WORKER_STARTING, // the thread is making the queues, on its numa node, it is not published yet
+	WORKER_RUNNING,  // a thread runs the tasks of the worker
+	WORKER_RETIRING, // the thread was asked to leave, it must be joined before the worker is used again
+} WorkerState;
+
+typedef struct ThreadPool ThreadPool;
 
-// linked list + other thread related data
 typedef struct {
-	RingBuffer_ResolverData ring_buffer;  // the jobs arranged in a threadBuffer
-	sem_t                   sempahore;    // semaphore to decide how many can get in the critical section
-	pthread_mutex_t         mutex;        // mutex to enter the critical section
-	size_t                  thread_count; // num of threads allocated in *threads
-	pthread_t              *threads;      // array of the pthreads started, it will not change once the tpoll is created
-	bool                    stop;         // should the threads stop
-} ThreadPool;
+	WorkDeque            deque;      // the tasks the worker gave itself
+	MPMCQueue_Task       inbox;      // the tasks given to the worker by other threads, anyone can take from it
+	ThreadPool          *pool;       // the pool of the worker, for its thread
+	pthread_t            thread;     // valid unless WORKER_STOPPED
+	uint16_t             node;       // the numa node the thread is pinned on, NODE_ANY if it is not
+	_Atomic(WorkerState) state;      // one of WorkerState
+	atomic_uint_fast64_t wait_ns;    // the sum of the measured waits of the tasks it took, only the thread writes it
+	atomic_uint_fast64_t waited;     // how many tasks had their wait measured
+	atomic_uint_fast64_t idle_since; // when the thread went to sleep without a task, 0 while it has work
+	int                  poll_fd;    // the epoll instance the thread sleeps in instead of the futex, -1 if it has none
+	int                  wake_fd;    // eventfd in poll_fd, written to wake the thread there, kept until the worker is reused
+	atomic_bool          polling;    // the thread sleeps in poll_fd, the first to clear it writes wake_fd
+} Worker;
+
+/**
+ * A work stealing thread pool, every thread has its own worker, the tasks from outside are spread on their inboxes
+ * a thread runs its own tasks first and steals from the others when it has none
+ *
+ * the pool is elastic, between min_threads and max_threads, resize_threadpool grows it when the tasks wait too long
+ * and retires the last thread when it has been idle for a while. The running workers are always the first thread_count
+ */
+struct ThreadPool {
+	Worker       *workers;         // max_threads of them, each on its own cache lines
+	atomic_size_t thread_count;    // the running threads, the workers from 0 to thread_count get the tasks from outside
+	atomic_size_t started_threads; // the threads add_worker started, the ones after thread_count are still making their queues
+	atomic_size_t peak_threads;    // the most threads run at once, the workers up to it have their queues and may have tasks
+	atomic_size_t next_worker;     // where the next task from outside goes, round robin
+	atomic_int    pending;         // tasks enqueued minus tasks claimed by the threads, negative when threads are waiting
+	atomic_uint   wake_epoch;      // futex word, incremented before waking a thread so it can not miss a task
+	atomic_size_t polling_threads; // how many threads sleep in their epoll instance instead of the futex
+	size_t        min_threads;     // the pool never shrinks below this
+	size_t        max_threads;     // the pool never grows above this
+	uint8_t       affinity;        // one of AffinityMode, where the threads run
+	uint64_t      resize_ns;       // when resize_threadpool looked at the pool last
+	uint64_t      wait_ns;         // the sum of the measured waits of the workers at that time
+	uint64_t      waited;          // the tasks measured at that time
+	uint64_t      wait_avg_ns;     // the average wait measured in the last interval
+	void         *worker_data;     // the argument of the threads
+	atomic_bool   stop;            // should the threads stop
+};
 
 /**
  * Create a thread pool on the heap and returns it.
- * It also start tCount threads with the proxy_resReq function
+ * It also start min_threads threads with the proxy_resReq function
  *
- * @param[in] thread_count the number of concurrent threads to start
+ * @param[in] min_threads the number of concurrent threads to start, the pool does not go below it
+ * @param[in] max_threads the most threads the pool can grow to
+ * @param[in] affinity one of AffinityMode, load_topology must be called before pinning the threads
  * @param[out] res the thread pool to initialize
+ * @param[in] worker_data the argument given to every proxy_res_req thread
  * @return the modified thread pool
  */
-ThreadPool *initialize_threadpool(const size_t thread_count, ThreadPool *res);
+ThreadPool *initialize_threadpool(const size_t min_threads, const size_t max_threads, const uint8_t affinity, ThreadPool *res, void *worker_data);
 
 /**
  * Free all the resource allocated in the given thrad pool
+ * the tasks still waiting are given to discard
+ *
+ * @param tp the thread pool the destroy
+ * @param discard called with the worker data and the argument of every task that did not run, can be nullptr
+ */
+void destroy_threadpool(ThreadPool *tp, TaskFunction discard);
+
+/**
+ * Take a task for the calling thread, from its own worker or stolen from another, sleeping if there is none
+ * only the threads started by the pool can call it, the ones with an epoll instance call poll_threadpool instead
+ *
+ * @param tpool the thread pool where to take the task from
+ * @return the task, with a nullptr run if the pool is stopping or the thread has to retire, the thread must return then
+ */
+Task dequeue_threadpool(ThreadPool *tpool);
+
+/**
+ * Lets the calling thread sleep in its own epoll instance instead of the futex, then poll_threadpool also returns its events
+ * the pool adds an eventfd in it, to wake the thread when a task comes
+ * only the threads started by the pool can call it
+ *
+ * @param tpool the thread pool of the thread
+ * @param epoll_fd the epoll instance of the thread, closed by the thread after it leaves the pool
+ * @return false if the eventfd could not be made or added, the thread sleeps on the futex then
+ */
+bool set_threadpool_poll(ThreadPool *tpool, const int epoll_fd);
+
+/**
+ * Like dequeue_threadpool, but a thread with an epoll instance wakes up for its events too, and for at most timeout_ms
+ * then it can return without a task, after giving back its claim. Without an epoll instance it only returns with a task
+ * a thread waiting with a timeout is not idle, the pool does not retire it
+ * a retired thread takes no more tasks, but while it passes a timeout it keeps getting the events for its fibers
+ *
+ * @param tpool the thread pool where to take the task from
+ * @param timeout_ms how long to sleep at most, -1 to sleep until a task or an event comes
+ * @param task the task taken, with a nullptr run if there was none
+ * @param events where to put the events of the epoll instance, THREADPOOL_POLL_EVENTS of them, the wakes of the pool are not given back
+ * @return how many events, -1 if the pool is stopping or the thread retired and has no timeout, the thread must return then
+ */
+int poll_threadpool(ThreadPool *tpool, const int timeout_ms, Task *task, struct epoll_event *events);
+
+/**
+ * Add a task for any thread of the pool
+ * from a thread of the pool it goes in its own deque, from outside in the inbox of the next worker, round robin
+ * if every inbox is full waits for a thread to take a task
+ *
+ * @param tpool the thread pool where to put the task in
+ * @param task the task, copied
+ * @return false if the pool stopped before the task could be added
+ */
+bool enqueue_threadpool(ThreadPool *tpool, const Task *task);
+
+/**
+ * Like enqueue_threadpool, but from outside the task goes to a worker on the given numa node if the threads are pinned
  *
- * @parma tp the thread pool the destroy
+ * @param tpool the thread pool where to put the task in
+ * @param task the task, copied
+ * @param node the numa node where the data of the task is, NODE_ANY if it does not matter
+ * @return false if the pool stopped before the task could be added
  */
-void destroy_threadpool(ThreadPool *tp);
+bool enqueue_threadpool_on(ThreadPool *tpool, const Task *task, const uint16_t node);
 
 /**
- * Take a job form the given threadpool queue
+ * The numa node of the calling thread
  *
- * @parama tpool the thread pool where to take the job from
- * @return a pointer to a resolver_data structure
+ * @return NODE_ANY outside of the pool or if the thread is not pinned
  */
-ResolverData dequeue_threadpool(ThreadPool *thread_pool);
+uint16_t threadpool_current_node();
 
 /**
- * Add the given data to the queue as a job for ay waiting thread
+ * Changes the size of the pool if it needs to, at most once every THREADPOOL_RESIZE_INTERVAL_NS
+ * must always be called by the same thread, the server does it from the event loop
  *
- * @param tpool the thread pool where to put the job in
- * @param data the data that will be copied into the thread job
+ * @param tpool the thread pool to resize
+ * @return true if the pool was measured, then thread_count and wait_avg_ns are up to date
  */
-void enqueue_threadpool(ThreadPool *tpool, const ResolverData *data);
+bool resize_threadpool(ThreadPool *tpool);
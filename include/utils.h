@@ -1,7 +1,9 @@
 #pragma once
 
+#include "Arena.h"
 #include "StringRef.h"
 
+#include <stdint.h>
 #include <string.h>
 
 #define TEST_ALLOC(ptr)                                                                             \
@@ -12,11 +14,19 @@
 
 /**
  * simply get the time formetted following RFC822 regulation on GMT time
+ * the responses take theirs from the DateCache, formatted once a second
  *
- * @return a strig containing the date
+ * @return a strig containing the date, valid until the next call on the same thread
  */
 StringRef getUTC();
 
+/**
+ * get the current time of the monotonic clock, to measure durations
+ *
+ * @return the time in nanoseconds from an unspecified point in the past
+ */
+uint64_t get_monotonic_ns();
+
 /**
  * Decode url character (e.g. %20 => " ") to ascii character, shamelessly copied from stackoverflow
  * copied from https://stackoverflow.com/questions/2673207/c-c-url-decode-library/2766963,
@@ -26,7 +36,7 @@ StringRef getUTC();
  * Since the decoded url is always smaller than the encoded one this algo can be used in-place by providing the same string
  * for both src and dst
  *
- * @param[in] `dst` where to put the decoded strin
+ * @param[in,out] `dst` where to put the decoded strin, its len is the capacity, null terminator included, and becomes the decoded length
  * @param[in] `src` the string to decode
  */
 void url_decode(StringOwn *dst, const StringRef *src);
@@ -35,10 +45,18 @@ void url_decode(StringOwn *dst, const StringRef *src);
  * compress given data to gzip
  * used this (https://github.com/mapbox/gzip-hpp/blob/master/include/gzip/compress.hpp) as a reference
  *
+ * every thread keeps its deflate stream and resets it, it is freed by release_gz_stream
+ *
  * @param[in] `data` the string reference pointing to the data to compress
- * @param[in] `output` where to put the result
+ * @param[in] `level` the zlib compression level
+ * @param[in] `output` where to put the result, its str is reallocated and must be freed
  */
-bool compress_gz(const StringRef *data, StringOwn *output);
+bool compress_gz(const StringRef *data, const int level, StringOwn *output);
+
+/**
+ * Frees the deflate stream of the calling thread, if it made one
+ */
+void release_gz_stream();
 
 /**
  * Thaks to https://stackoverflow.com/questions/122616/how-do-i-trim-leading-trailing-whitespace-in-a-standard-way
@@ -54,6 +72,7 @@ void trimwhitespace(char *str);
 
 /**
  * finds needle in haystack for at most count - 1 characters of haystack
+ * uses the simd kernels of scan.h
  *
  * @param[in] `haystack` the string to search into
  * @param[in] `needle` the string to search for
@@ -65,6 +84,7 @@ const char *strnstr(const char *haystack, const char *needle, const size_t count
 
 /**
  * finds the first occurrence of chr in the byte string pointed to by str to a max of count - 1
+ * uses the simd kernels of scan.h
  *
  * @param[in] `str` the string to search into
  * @param[in] `chr` the char to search for
@@ -95,6 +115,16 @@ const char *strrnchr(const char *str, int chr, const size_t count);
  */
 size_t strnlen(const char *str, const size_t count);
 
+/**
+ * FNV-1a hash of the bytes, for the hash tables
+ *
+ * @param[in] `data` the bytes to hash
+ * @param[in] `len` how many bytes
+ *
+ * @return the 64 bit hash
+ */
+uint64_t hash_bytes(const char *data, const size_t len);
+
 /**
  * rework the stringRef to remove unwanted whitespaces in front or at the back of the content
  *
@@ -114,6 +144,17 @@ StringRef trim(StringRef *strRef);
  */
 bool strrefblnk(const StringRef *strRef);
 
+/**
+ * check if the comma separated list contains the given token, ignoring case and the whitespaces around the tokens
+ * e.g. "keep-alive, Upgrade" contains "upgrade"
+ *
+ * @param[in] `list` the comma separated list to search into
+ * @param[in] `token` the token to search for
+ *
+ * @return true if the token is one of the elements of the list
+ */
+bool has_token(const StringRef *list, const StringRef *token);
+
 /**
  * given a sringref mallocs a copy of the string and returns it
  *
@@ -133,6 +174,16 @@ char *copy_StringOwn(const StringOwn *str);
  */
 char *copy_StringRef(const StringRef *str);
 
+/**
+ * given a string copies it in the arena and returns it
+ *
+ * @param[in] `str` the string to copy
+ * @param[in] `arena` the arena to allocate the copy from
+ *
+ * @return the copy, valid until the arena is reset
+ */
+char *copy_StringRef_arena(const StringRef *str, Arena *arena);
+
 /**
  * Return the string representation of the given number
  *
@@ -141,5 +192,3 @@ char *copy_StringRef(const StringRef *str);
  * @return a heap allocated string that represents the given number
  */
 StringRef num_to_string(size_t number);
-
-StringRef get_reason_phrase(unsigned short statusCode);
@@ -0,0 +1,131 @@
+#include "Arena.h"
+
+#include "logger.h"
+#include "utils.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * Round the size up, so every allocation starts aligned for any type
+ */
+static size_t align_size(const size_t size) {
+	return (size + alignof(max_align_t) - 1) & ~(alignof(max_align_t) - 1);
+}
+
+/**
+ * Allocate a new block for the arena, with at least `capacity` bytes available
+ */
+static ArenaBlock *push_block(Arena *arena, const size_t capacity) {
+
+	ArenaBlock *block = malloc(sizeof(ArenaBlock) + capacity);
+	TEST_ALLOC(block)
+
+	block->prev     = arena->current;
+	block->capacity = capacity;
+	block->used     = 0;
+
+	arena->current = block;
+	arena->total += capacity;
+
+	return block;
+}
+
+Arena make_Arena(const size_t block_size) {
+
+	Arena res = {
+	    .current    = nullptr,
+	    .total      = 0,
+	    .block_size = align_size(block_size == 0 ? ARENA_BLOCK_SIZE : block_size),
+	};
+
+	return res;
+}
+
+void destroy_Arena(Arena *arena) {
+
+	auto block = arena->current;
+
+	while (block != nullptr) {
+		auto prev = block->prev;
+		free(block);
+		block = prev;
+	}
+
+	arena->current = nullptr;
+	arena->total   = 0;
+}
+
+void *alloc_Arena(Arena *arena, const size_t size) {
+
+	auto aligned = align_size(size);
+	auto block   = arena->current;
+
+	if (block == nullptr || block->capacity - block->used < aligned) {
+
+		// a zero initialized arena has no block size yet
+		if (arena->block_size == 0) {
+			arena->block_size = ARENA_BLOCK_SIZE;
+		}
+
+		// every block is as big as all the previous ones together, like a vector growing
+		auto capacity = arena->total == 0 ? arena->block_size : arena->total;
+		if (capacity < aligned) {
+			capacity = aligned;
+		}
+
+		block = push_block(arena, capacity);
+	}
+
+	void *res = (char *)(block->data) + block->used;
+	block->used += aligned;
+
+	return res;
+}
+
+void *realloc_Arena(Arena *arena, void *ptr, const size_t old_size, const size_t new_size) {
+
+	if (ptr == nullptr) {
+		return alloc_Arena(arena, new_size);
+	}
+
+	auto block       = arena->current;
+	auto old_aligned = align_size(old_size);
+	auto new_aligned = align_size(new_size);
+
+	// the last allocation of the current block can just move the end
+	if ((char *)(ptr) + old_aligned == (char *)(block->data) + block->used && block->capacity - block->used + old_aligned >= new_aligned) {
+		block->used = block->used - old_aligned + new_aligned;
+		return ptr;
+	}
+
+	void *res = alloc_Arena(arena, new_size);
+	memcpy(res, ptr, old_size < new_size ? old_size : new_size);
+
+	return res;
+}
+
+void reset_Arena(Arena *arena) {
+
+	if (arena->current == nullptr) {
+		return;
+	}
+
+	// a single block of the right size, simply start over
+	if (arena->current->prev == nullptr && arena->total <= ARENA_MAX_RETAINED) {
+		arena->current->used = 0;
+		return;
+	}
+
+	// merge every block in one that can hold everything that was needed, unless it is too big to keep around
+	auto total = arena->total;
+	destroy_Arena(arena);
+
+	if (total > ARENA_MAX_RETAINED) {
+		llog(LOG_DEBUG, "[ARENA] Releasing %zu bytes\n", total);
+		return;
+	}
+
+	push_block(arena, total);
+}
@@ -0,0 +1,329 @@
+#include "AssetCache.h"
+
+#include "Arena.h"
+#include "DateCache.h"
+#include "Encoding.h"
+#include "constants.h"
+#include "logger.h"
+#include "utils.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+void initialize_AssetCache(const size_t capacity, AssetCache *cache) {
+
+	cache->shard_capacity = capacity / ASSET_CACHE_SHARDS;
+
+	for (size_t i = 0; i < ASSET_CACHE_SHARDS; ++i) {
+		auto shard = &cache->shards[i];
+
+		pthread_mutex_init(&shard->lock, nullptr);
+		memset(shard->buckets, 0, sizeof(shard->buckets));
+		shard->newest = nullptr;
+		shard->oldest = nullptr;
+		shard->size   = 0;
+	}
+}
+
+void destroy_AssetCache(AssetCache *cache) {
+
+	for (size_t i = 0; i < ASSET_CACHE_SHARDS; ++i) {
+		auto shard = &cache->shards[i];
+
+		for (auto asset = shard->newest; asset != nullptr;) {
+			auto older = asset->older;
+			release_asset(asset);
+			asset = older;
+		}
+
+		pthread_mutex_destroy(&shard->lock);
+	}
+}
+
+void release_asset(Asset *asset) {
+
+	if (atomic_fetch_sub_explicit(&asset->refs, 1, memory_order_acq_rel) != 1) {
+		return;
+	}
+
+	release_file(asset->file);
+	free(asset->body.str);
+	free(asset->content_length.str);
+	free(asset->etag.str);
+	free(asset->header.buffer);
+	free(asset);
+}
+
+/**
+ * Reads the whole file and compresses it, if asked and if it makes it smaller
+ */
+static Asset *make_Asset(FileEntry *file, const uint8_t encoding, const uint64_t hash) {
+
+	auto size = (size_t)(file->info.st_size);
+
+	// one more byte so an empty file is not an allocation of 0
+	char *raw = malloc(size + 1);
+	TEST_ALLOC(raw)
+
+	size_t done = 0;
+
+	while (done < size) {
+		auto count = pread(file->fd, raw + done, size - done, (off_t)(done));
+
+		if (count < 0 && errno == EINTR) {
+			continue;
+		}
+
+		if (count <= 0) {
+			llog(LOG_ERROR, "[ASSETS] Could read only %zu bytes of %zu of '%.*s'\n", done, size, (int)file->path.len, file->path.str);
+			free(raw);
+			return nullptr;
+		}
+
+		done += (size_t)(count);
+	}
+
+	Asset *res = malloc(sizeof(Asset));
+	TEST_ALLOC(res)
+
+	res->body     = (StringOwn){raw, size};
+	res->encoding = ENCODING_IDENTITY;
+
+	if (encoding != ENCODING_IDENTITY) {
+		StringRef data       = {raw, size};
+		StringOwn compressed = {nullptr, 0};
+
+		// it is done once for every version of the file, with the level chosen when the file was opened
+		if (encode_body(encoding, file->compression, &data, &compressed) && compressed.len < size) {
+			free(raw);
+			res->body     = compressed;
+			res->encoding = encoding;
+		} else {
+			free(compressed.str);
+		}
+	}
+
+	// the same file gets a different tag for every version and every encoding
+	StringRef suffix = res->encoding == ENCODING_IDENTITY ? (StringRef){"", 0} : content_encodings_str[res->encoding];
+	uint64_t  mtime  = (uint64_t)(file->info.st_mtim.tv_sec) * 1000000000 + (uint64_t)(file->info.st_mtim.tv_nsec);
+
+	char etag[96];
+	auto etag_len = snprintf(etag, sizeof(etag), "\"%lx-%zx-%lx%s%.*s\"", (unsigned long)(file->info.st_ino), size, (unsigned long)(mtime), suffix.len > 0 ? "-" : "", (int)suffix.len, suffix.str);
+
+	StringRef tag    = {etag, (size_t)(etag_len)};
+	auto      length = num_to_string(res->body.len);
+
+	res->content_length = (StringOwn){copy_StringRef(&length), length.len};
+	res->etag           = (StringOwn){copy_StringRef(&tag), tag.len};
+
+	// the fields are formatted in a scratch message, then copied out of its arena
+	Arena               scratch = make_Arena(512);
+	OutboundHttpMessage fields  = {};
+	StringRef           dated   = {file->last_modified, HTTP_DATE_LEN};
+	fields.arena                = &scratch;
+
+	add_header_option(RP_CONTENT_TYPE, &file->mime, &fields);
+	add_header_option(RP_CONTENT_LENGTH, &length, &fields);
+	add_header_option(RP_ETAG, &tag, &fields);
+	add_header_option(RP_LAST_MODIFIED, &dated, &fields);
+
+	// the body depends on Accept-Encoding even when identity was chosen, caches must key on it
+	if (file->compression != COMPRESS_NONE) {
+		StringRef vary = TO_STRINGREF("Accept-Encoding");
+		add_header_option(RP_VARY, &vary, &fields);
+	}
+
+	if (res->encoding != ENCODING_IDENTITY) {
+		add_header_option(RP_CONTENT_ENCODING, &content_encodings_str[res->encoding], &fields);
+	}
+
+	res->header          = fields.headers;
+	res->header.buffer   = malloc(fields.headers.len + 1);
+	res->header.capacity = fields.headers.len;
+	TEST_ALLOC(res->header.buffer)
+	memcpy(res->header.buffer, fields.headers.buffer, fields.headers.len);
+	destroy_Arena(&scratch);
+	res->mime           = file->mime;
+	res->file           = retain_file(file);
+	res->bucket_next    = nullptr;
+	res->newer          = nullptr;
+	res->older          = nullptr;
+	res->size           = sizeof(Asset) + res->body.len + res->content_length.len + res->etag.len + res->header.len;
+	res->hash           = hash;
+	res->requested      = encoding;
+	atomic_init(&res->refs, 1);
+
+	return res;
+}
+
+static Asset **get_bucket(AssetShard *shard, const uint64_t hash) {
+	// the low bits choose the shard
+	return &shard->buckets[(hash / ASSET_CACHE_SHARDS) % ASSET_SHARD_BUCKETS];
+}
+
+/**
+ * The asset for the path and encoding, if the shard has it
+ *
+ * @param[out] `link` where the asset is linked in its bucket, to remove it
+ */
+static Asset *find_asset(AssetShard *shard, const uint64_t hash, const StringOwn *path, const uint8_t encoding, Asset ***link) {
+
+	*link = get_bucket(shard, hash);
+
+	for (; **link != nullptr; *link = &(**link)->bucket_next) {
+		auto asset = **link;
+
+		if (asset->hash == hash && asset->requested == encoding && equal_StringOwn(&asset->file->path, path)) {
+			return asset;
+		}
+	}
+
+	return nullptr;
+}
+
+static void unlink_lru(AssetShard *shard, Asset *asset) {
+
+	if (asset->newer == nullptr) {
+		shard->newest = asset->older;
+	} else {
+		asset->newer->older = asset->older;
+	}
+
+	if (asset->older == nullptr) {
+		shard->oldest = asset->newer;
+	} else {
+		asset->older->newer = asset->newer;
+	}
+
+	asset->newer = nullptr;
+	asset->older = nullptr;
+}
+
+static void push_lru(AssetShard *shard, Asset *asset) {
+
+	asset->older = shard->newest;
+	asset->newer = nullptr;
+
+	if (shard->newest == nullptr) {
+		shard->oldest = asset;
+	} else {
+		shard->newest->newer = asset;
+	}
+
+	shard->newest = asset;
+}
+
+/**
+ * Takes the asset out of the shard, the reference of the cache is given to the caller
+ */
+static void remove_asset(AssetShard *shard, Asset *asset) {
+
+	Asset **link;
+	find_asset(shard, asset->hash, &asset->file->path, asset->requested, &link);
+
+	*link = asset->bucket_next;
+	unlink_lru(shard, asset);
+	shard->size -= asset->size;
+}
+
+Asset *acquire_asset(AssetCache *cache, FileEntry *file, const uint8_t encoding, const bool make) {
+
+	auto    hash  = hash_bytes(file->path.str, file->path.len);
+	auto    shard = &cache->shards[hash % ASSET_CACHE_SHARDS];
+	Asset **link;
+
+	pthread_mutex_lock(&shard->lock);
+
+	auto asset = find_asset(shard, hash, &file->path, encoding, &link);
+
+	if (asset != nullptr && asset->file == file) {
+		// the hot path, a lookup and a move to the head of the list
+		unlink_lru(shard, asset);
+		push_lru(shard, asset);
+		atomic_fetch_add_explicit(&asset->refs, 1, memory_order_relaxed);
+
+		pthread_mutex_unlock(&shard->lock);
+		return asset;
+	}
+
+	// the file changed since the asset was made
+	Asset *stale = nullptr;
+	if (asset != nullptr) {
+		remove_asset(shard, asset);
+		stale = asset;
+	}
+
+	pthread_mutex_unlock(&shard->lock);
+
+	if (stale != nullptr) {
+		release_asset(stale);
+	}
+
+	if (!make) {
+		return nullptr;
+	}
+
+	// read and compressed outside of the lock, the shard is not blocked by the disk or by zlib
+	auto fresh = make_Asset(file, encoding, hash);
+
+	if (fresh == nullptr) {
+		return nullptr;
+	}
+
+	if (fresh->size > cache->shard_capacity) {
+		// used only by this response
+		return fresh;
+	}
+
+	Asset *evicted = nullptr;
+
+	pthread_mutex_lock(&shard->lock);
+
+	asset = find_asset(shard, hash, &file->path, encoding, &link);
+
+	if (asset != nullptr && asset->file == file) {
+		// another thread made it in the meantime
+		unlink_lru(shard, asset);
+		push_lru(shard, asset);
+		atomic_fetch_add_explicit(&asset->refs, 1, memory_order_relaxed);
+
+		pthread_mutex_unlock(&shard->lock);
+		release_asset(fresh);
+		return asset;
+	}
+
+	if (asset != nullptr) {
+		remove_asset(shard, asset);
+		asset->older = evicted;
+		evicted      = asset;
+	}
+
+	// evicted assets are chained with their lru links and released after the lock
+	while (shard->size + fresh->size > cache->shard_capacity && shard->oldest != nullptr) {
+		auto oldest = shard->oldest;
+		remove_asset(shard, oldest);
+		oldest->older = evicted;
+		evicted       = oldest;
+	}
+
+	// with the reference of the cache
+	atomic_fetch_add_explicit(&fresh->refs, 1, memory_order_relaxed);
+	auto bucket        = get_bucket(shard, hash);
+	fresh->bucket_next = *bucket;
+	*bucket            = fresh;
+	push_lru(shard, fresh);
+	shard->size += fresh->size;
+
+	pthread_mutex_unlock(&shard->lock);
+
+	while (evicted != nullptr) {
+		auto next = evicted->older;
+		release_asset(evicted);
+		evicted = next;
+	}
+
+	return fresh;
+}
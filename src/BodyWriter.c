@@ -0,0 +1,258 @@
+#include "BodyWriter.h"
+
+#include "logger.h"
+#include "utils.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#define ZLIB_CONST
+#include <zlib.h>
+
+/**
+ * The deflate stream of the thread for the streamed bodies, apart from the one of compress_gz
+ * a producer may compress a whole body while it streams another
+ */
+static thread_local z_stream body_stream;
+static thread_local bool     body_stream_ready = false;
+static thread_local int      body_stream_level;
+
+// a writer has the stream of the thread, the fiber that streams with it is waiting on its client
+static thread_local bool body_stream_lent = false;
+
+/**
+ * Starts a gzip stream, with windowbits of 15
+ */
+static bool init_stream(z_stream *stream, const int level) {
+
+	stream->zalloc = Z_NULL;
+	stream->zfree  = Z_NULL;
+	stream->opaque = Z_NULL;
+
+	if (deflateInit2(stream, level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+		llog(LOG_ERROR, "[BODY] Deflate init failed, the body is sent as it is\n");
+		return false;
+	}
+
+	return true;
+}
+
+/**
+ * Lends the stream of the thread to the writer, if another writer has it the writer gets a stream of its own
+ */
+static bool prepare_body_stream(BodyWriter *writer, const int level) {
+
+	if (body_stream_lent) {
+		writer->stream = malloc(sizeof(z_stream));
+		TEST_ALLOC(writer->stream)
+
+		if (!init_stream(writer->stream, level)) {
+			free(writer->stream);
+			writer->stream = nullptr;
+			return false;
+		}
+
+		return true;
+	}
+
+	if (body_stream_ready) {
+		deflateReset(&body_stream);
+
+		if (level != body_stream_level && deflateParams(&body_stream, level, Z_DEFAULT_STRATEGY) == Z_OK) {
+			body_stream_level = level;
+		}
+	} else if (init_stream(&body_stream, level)) {
+		body_stream_ready = true;
+		body_stream_level = level;
+	} else {
+		return false;
+	}
+
+	body_stream_lent = true;
+	writer->stream   = &body_stream;
+	return true;
+}
+
+void release_body_stream() {
+
+	if (body_stream_ready) {
+		deflateEnd(&body_stream);
+		body_stream_ready = false;
+		body_stream_lent  = false;
+	}
+}
+
+void initialize_BodyWriter(BodySink sink, void *target, const bool chunked, const int gz_level, Arena *arena, BodyWriter *writer) {
+
+	writer->sink    = sink;
+	writer->target  = target;
+	writer->buffer  = alloc_Arena(arena, BODY_CHUNK_PREFIX + BODY_CHUNK_SIZE + 2);
+	writer->len     = 0;
+	writer->written = 0;
+	writer->sent    = 0;
+	writer->chunked = chunked;
+	writer->stream  = nullptr;
+	writer->gzip    = gz_level > 0 && prepare_body_stream(writer, gz_level);
+	writer->failed  = false;
+}
+
+void close_BodyWriter(BodyWriter *writer) {
+
+	if (writer->stream == &body_stream) {
+		body_stream_lent = false;
+	} else if (writer->stream != nullptr) {
+		deflateEnd(writer->stream);
+		free(writer->stream);
+	}
+
+	writer->stream = nullptr;
+	writer->gzip   = false;
+}
+
+/**
+ * Sends the chunk in the buffer, with its size line before it and the CRLF after it written around the data
+ * so the whole chunk goes to the sink at once
+ */
+static bool send_chunk(BodyWriter *writer) {
+
+	// an empty chunk would be the last one
+	if (writer->len == 0) {
+		return true;
+	}
+
+	auto   start = writer->buffer + BODY_CHUNK_PREFIX;
+	size_t total = writer->len;
+
+	if (writer->chunked) {
+		char line[BODY_CHUNK_PREFIX + 1];
+		auto line_len = (size_t)(snprintf(line, sizeof(line), "%zx\r\n", writer->len));
+
+		start -= line_len;
+		memcpy(start, line, line_len);
+		memcpy(writer->buffer + BODY_CHUNK_PREFIX + writer->len, "\r\n", 2);
+
+		total += line_len + 2;
+	}
+
+	if (!writer->sink(writer->target, start, total)) {
+		writer->failed = true;
+		return false;
+	}
+
+	writer->sent += total;
+	writer->len = 0;
+	return true;
+}
+
+/**
+ * Compresses the data in the chunk, sending it every time it fills up
+ *
+ * @param[in] `flush` Z_NO_FLUSH, Z_SYNC_FLUSH to get out everything given so far, or Z_FINISH to end the stream
+ */
+static bool deflate_body(BodyWriter *writer, const StringRef *data, const int flush) {
+
+	auto stream = writer->stream;
+
+	stream->next_in  = (const Bytef *)(data->str);
+	stream->avail_in = (uInt)(data->len);
+
+	while (true) {
+		stream->next_out  = (Bytef *)(writer->buffer + BODY_CHUNK_PREFIX + writer->len);
+		stream->avail_out = (uInt)(BODY_CHUNK_SIZE - writer->len);
+
+		auto res    = deflate(stream, flush);
+		writer->len = BODY_CHUNK_SIZE - stream->avail_out;
+
+		if (res == Z_STREAM_ERROR) {
+			llog(LOG_ERROR, "[BODY] Deflate failed after %zu bytes\n", writer->written);
+			writer->failed = true;
+			return false;
+		}
+
+		auto full = stream->avail_out == 0;
+
+		if (full && !send_chunk(writer)) {
+			return false;
+		}
+
+		// with room left in the chunk deflate took all the input and wrote all it had to
+		if (flush == Z_FINISH ? res == Z_STREAM_END : !full) {
+			return true;
+		}
+	}
+}
+
+bool write_body(BodyWriter *writer, const StringRef *data) {
+
+	if (writer->failed) {
+		return false;
+	}
+
+	writer->written += data->len;
+
+	if (writer->gzip) {
+		return deflate_body(writer, data, Z_NO_FLUSH);
+	}
+
+	size_t done = 0;
+
+	while (done < data->len) {
+		auto count = data->len - done < BODY_CHUNK_SIZE - writer->len ? data->len - done : BODY_CHUNK_SIZE - writer->len;
+
+		memcpy(writer->buffer + BODY_CHUNK_PREFIX + writer->len, data->str + done, count);
+		writer->len += count;
+		done += count;
+
+		if (writer->len == BODY_CHUNK_SIZE && !send_chunk(writer)) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool flush_body(BodyWriter *writer) {
+
+	if (writer->failed) {
+		return false;
+	}
+
+	StringRef empty = {"", 0};
+
+	if (writer->gzip && !deflate_body(writer, &empty, Z_SYNC_FLUSH)) {
+		return false;
+	}
+
+	return send_chunk(writer);
+}
+
+bool finish_body(BodyWriter *writer) {
+
+	if (writer->failed) {
+		return false;
+	}
+
+	StringRef empty = {"", 0};
+
+	if (writer->gzip && !deflate_body(writer, &empty, Z_FINISH)) {
+		return false;
+	}
+
+	if (!send_chunk(writer)) {
+		return false;
+	}
+
+	if (!writer->chunked) {
+		return true;
+	}
+
+	// the last chunk, without trailers
+	if (!writer->sink(writer->target, "0\r\n\r\n", 5)) {
+		writer->failed = true;
+		return false;
+	}
+
+	writer->sent += 5;
+	return true;
+}
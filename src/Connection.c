@@ -0,0 +1,270 @@
+#include "Connection.h"
+
+#include "logger.h"
+#include "utils.h"
+
+#include <errno.h>
+#include <openssl/err.h>
+#include <openssl/ssl.h>
+#include <poll.h>
+#include <sslConn.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <tcpConn.h>
+#include <unistd.h>
+
+Connection *make_Connection(const Socket client_socket) {
+
+	Connection *res = malloc(sizeof(Connection));
+	TEST_ALLOC(res)
+
+	res->ssl               = nullptr;
+	res->buffer            = nullptr;
+	res->buffer_len        = 0;
+	res->buffer_capacity   = 0;
+	res->prev              = nullptr;
+	res->next              = nullptr;
+	res->fiber             = nullptr;
+	res->accept_time_ns    = get_monotonic_ns();
+	res->handshake_work_ns = 0;
+	res->idle_deadline_ns  = 0;
+	res->client_socket     = client_socket;
+	res->rearm_events      = 0;
+	res->requests_served   = 0;
+	res->node              = NODE_ANY;
+	res->state             = CONN_HANDSHAKE;
+
+	return res;
+}
+
+void destroy_Connection(Connection *conn) {
+
+	TCP_shutdown_socket(conn->client_socket);
+	TCP_close_socket(conn->client_socket);
+
+	if (conn->ssl != nullptr) {
+		SSL_destroy_connection(conn->ssl);
+	}
+
+	free(conn->buffer);
+	free(conn);
+}
+
+/**
+ * Wait for the socket to be usable in the direction the ssl connection asked for
+ * in a fiber the thread goes back to its loop meanwhile, to serve the other connections
+ *
+ * @param[in] `conn` the connection to wait on
+ * @param[in] `ssl_error` the error returned by SSL_get_error
+ *
+ * @return true if the operation can be retried
+ */
+static bool wait_connection(Connection *conn, const int ssl_error) {
+
+	if (current_fiber() != nullptr && (ssl_error == SSL_ERROR_WANT_READ || ssl_error == SSL_ERROR_WANT_WRITE)) {
+		conn->fiber = current_fiber();
+
+		auto ready = fiber_wait(conn->client_socket, ssl_error == SSL_ERROR_WANT_READ ? EPOLLIN : EPOLLOUT, conn, CONNECTION_IO_TIMEOUT_MS);
+
+		conn->fiber = nullptr;
+		return ready;
+	}
+
+	struct pollfd pfd = {
+	    .fd      = conn->client_socket,
+	    .events  = 0,
+	    .revents = 0,
+	};
+
+	switch (ssl_error) {
+	case SSL_ERROR_WANT_READ:
+		pfd.events = POLLIN;
+		break;
+	case SSL_ERROR_WANT_WRITE:
+		pfd.events = POLLOUT;
+		break;
+	default:
+		return false;
+	}
+
+	auto ready = poll(&pfd, 1, CONNECTION_IO_TIMEOUT_MS);
+
+	if (ready <= 0) {
+		llog(LOG_WARNING, "[CONNECTION] Socket %d timed out\n", conn->client_socket);
+		return false;
+	}
+
+	return (pfd.revents & (POLLERR | POLLNVAL)) == 0;
+}
+
+ssize_t connection_receive(Connection *conn, char *buffer, const size_t len) {
+
+	while (true) {
+		size_t read = 0;
+
+		ERR_clear_error();
+		if (SSL_read_ex(conn->ssl, buffer, len, &read) == 1) {
+			return (ssize_t)(read);
+		}
+
+		auto err = SSL_get_error(conn->ssl, 0);
+
+		if (err == SSL_ERROR_ZERO_RETURN) {
+			// the client closed the connection
+			return 0;
+		}
+
+		if (!wait_connection(conn, err)) {
+			return -1;
+		}
+	}
+}
+
+ssize_t connection_fill(Connection *conn, const size_t max_capacity) {
+
+	if (conn->buffer_len == conn->buffer_capacity) {
+
+		if (conn->buffer_capacity >= max_capacity) {
+			return -1;
+		}
+
+		auto capacity = conn->buffer_capacity == 0 ? CONNECTION_BUFFER_SIZE : conn->buffer_capacity * 2;
+		if (capacity > max_capacity) {
+			capacity = max_capacity;
+		}
+
+		conn->buffer = realloc(conn->buffer, capacity);
+		TEST_ALLOC(conn->buffer)
+		conn->buffer_capacity = capacity;
+	}
+
+	auto read = connection_receive(conn, conn->buffer + conn->buffer_len, conn->buffer_capacity - conn->buffer_len);
+
+	if (read > 0) {
+		conn->buffer_len += (size_t)(read);
+	}
+
+	return read;
+}
+
+void connection_consume(Connection *conn, const size_t len) {
+
+	memmove(conn->buffer, conn->buffer + len, conn->buffer_len - len);
+	conn->buffer_len -= len;
+}
+
+bool connection_send(Connection *conn, const char *data, const size_t len) {
+
+	size_t sent = 0;
+
+	while (sent < len) {
+		size_t written = 0;
+
+		ERR_clear_error();
+		if (SSL_write_ex(conn->ssl, data + sent, len - sent, &written) == 1) {
+			sent += written;
+			continue;
+		}
+
+		if (!wait_connection(conn, SSL_get_error(conn->ssl, 0))) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool connection_send_parts(Connection *conn, const StringRef *parts, const size_t count) {
+
+	char   record[CONNECTION_RECORD_SIZE];
+	size_t used = 0;
+
+	for (size_t i = 0; i < count; ++i) {
+		auto part = parts[i];
+		auto room = CONNECTION_RECORD_SIZE - used;
+
+		if (part.len < room) {
+			memcpy(record + used, part.str, part.len);
+			used += part.len;
+			continue;
+		}
+
+		// the record is topped up with the start of the part, so the header does not go in a record of its own
+		if (used > 0) {
+			memcpy(record + used, part.str, room);
+
+			if (!connection_send(conn, record, CONNECTION_RECORD_SIZE)) {
+				return false;
+			}
+
+			part.str += room;
+			part.len -= room;
+			used = 0;
+		}
+
+		// the whole records are encrypted straight from the part
+		auto whole = part.len - part.len % CONNECTION_RECORD_SIZE;
+
+		if (whole > 0 && !connection_send(conn, part.str, whole)) {
+			return false;
+		}
+
+		// the rest might be joined with the next part
+		memcpy(record, part.str + whole, part.len - whole);
+		used = part.len - whole;
+	}
+
+	return used == 0 || connection_send(conn, record, used);
+}
+
+bool connection_send_file(Connection *conn, const int fd, size_t offset, const size_t len) {
+
+	const auto end = offset + len;
+
+	// the records are encrypted by the kernel, only when the context has SSL_OP_ENABLE_KTLS and the kernel has the tls module
+	if (BIO_get_ktls_send(SSL_get_wbio(conn->ssl))) {
+
+		while (offset < end) {
+
+			ERR_clear_error();
+			auto sent = SSL_sendfile(conn->ssl, fd, (off_t)(offset), end - offset, 0);
+
+			if (sent > 0) {
+				offset += (size_t)(sent);
+				continue;
+			}
+
+			if (!wait_connection(conn, SSL_get_error(conn->ssl, (int)(sent)))) {
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	char chunk[CONNECTION_FILE_CHUNK];
+
+	while (offset < end) {
+
+		auto count = end - offset < CONNECTION_FILE_CHUNK ? end - offset : CONNECTION_FILE_CHUNK;
+		auto read  = pread(fd, chunk, count, (off_t)(offset));
+
+		if (read < 0 && errno == EINTR) {
+			continue;
+		}
+
+		// the file shrunk, the length already sent is wrong and the connection can not be used anymore
+		if (read <= 0) {
+			return false;
+		}
+
+		if (!connection_send(conn, chunk, (size_t)(read))) {
+			return false;
+		}
+
+		offset += (size_t)(read);
+	}
+
+	return true;
+}
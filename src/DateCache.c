@@ -0,0 +1,121 @@
+#include "DateCache.h"
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <string.h>
+
+typedef struct {
+	char header[DATE_HEADER_LEN]; // "Date: ...\r\n"
+	char expires[HTTP_DATE_LEN];  // the date DATE_EXPIRES_AFTER seconds later
+} DateSlot;
+
+static DateSlot date_slots[DATE_CACHE_SLOTS];
+
+// the slot of the current second, readers only look at this one
+static atomic_size_t date_current = 0;
+
+// the second formatted last, 0 before the first refresh
+static atomic_int_fast64_t date_second = 0;
+
+static const char week_days[7][3] = {
+    {'S', 'u', 'n'},
+    {'M', 'o', 'n'},
+    {'T', 'u', 'e'},
+    {'W', 'e', 'd'},
+    {'T', 'h', 'u'},
+    {'F', 'r', 'i'},
+    {'S', 'a', 't'},
+};
+
+static const char months[12][3] = {
+    {'J', 'a', 'n'},
+    {'F', 'e', 'b'},
+    {'M', 'a', 'r'},
+    {'A', 'p', 'r'},
+    {'M', 'a', 'y'},
+    {'J', 'u', 'n'},
+    {'J', 'u', 'l'},
+    {'A', 'u', 'g'},
+    {'S', 'e', 'p'},
+    {'O', 'c', 't'},
+    {'N', 'o', 'v'},
+    {'D', 'e', 'c'},
+};
+
+static void put_digits(char *out, int value, const size_t count) {
+
+	for (size_t i = count; i > 0; --i) {
+		out[i - 1] = (char)('0' + value % 10);
+		value /= 10;
+	}
+}
+
+void format_http_date(const time_t time, char *out) {
+
+	struct tm utc;
+	gmtime_r(&time, &utc);
+
+	//           1         2
+	// 01234567890123456789012345678
+	// Sun, 06 Nov 1994 08:49:37 GMT
+	memcpy(out, week_days[utc.tm_wday], 3);
+	memcpy(out + 3, ", ", 2);
+	put_digits(out + 5, utc.tm_mday, 2);
+	out[7] = ' ';
+	memcpy(out + 8, months[utc.tm_mon], 3);
+	out[11] = ' ';
+	put_digits(out + 12, utc.tm_year + 1900, 4);
+	out[16] = ' ';
+	put_digits(out + 17, utc.tm_hour, 2);
+	out[19] = ':';
+	put_digits(out + 20, utc.tm_min, 2);
+	out[22] = ':';
+	put_digits(out + 23, utc.tm_sec, 2);
+	memcpy(out + 25, " GMT", 4);
+}
+
+void refresh_DateCache() {
+
+	struct timespec now;
+	clock_gettime(CLOCK_REALTIME_COARSE, &now);
+
+	int_fast64_t second = now.tv_sec;
+	int_fast64_t last   = atomic_load_explicit(&date_second, memory_order_relaxed);
+
+	// the same second, or another thread is formatting it
+	if (second == last || !atomic_compare_exchange_strong_explicit(&date_second, &last, second, memory_order_relaxed, memory_order_relaxed)) {
+		return;
+	}
+
+	auto next = (atomic_load_explicit(&date_current, memory_order_relaxed) + 1) % DATE_CACHE_SLOTS;
+	auto slot = &date_slots[next];
+
+	memcpy(slot->header, "Date: ", 6);
+	format_http_date(now.tv_sec, slot->header + 6);
+	memcpy(slot->header + 6 + HTTP_DATE_LEN, "\r\n", 2);
+
+	format_http_date(now.tv_sec + DATE_EXPIRES_AFTER, slot->expires);
+
+	// the slot is written before it is published
+	atomic_store_explicit(&date_current, next, memory_order_release);
+}
+
+/**
+ * The slot of the current second, formatted now if no one did yet
+ */
+static const DateSlot *current_slot() {
+
+	if (atomic_load_explicit(&date_second, memory_order_relaxed) == 0) {
+		refresh_DateCache();
+	}
+
+	return &date_slots[atomic_load_explicit(&date_current, memory_order_acquire)];
+}
+
+StringRef get_date_header() {
+	return (StringRef){current_slot()->header, DATE_HEADER_LEN};
+}
+
+StringRef get_expires_date() {
+	return (StringRef){current_slot()->expires, HTTP_DATE_LEN};
+}
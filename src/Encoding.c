@@ -0,0 +1,288 @@
+#include "Encoding.h"
+
+#include "constants.h"
+#include "logger.h"
+#include "utils.h"
+
+#include <brotli/encode.h>
+#include <ctype.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <zstd.h>
+
+// indexed by ContentEncoding
+static const EncoderInfo encoders[] = {
+    {nullptr, {0, 0, 0, 0}},
+    {compress_gz, {0, 3, 6, 9}},
+    // the assets are compressed once and sent many times, so the slow top quality of brotli pays for itself
+    {compress_br, {0, 5, 9, BROTLI_MAX_QUALITY}},
+    {compress_zstd, {0, 3, 9, 19}},
+};
+
+static_assert(sizeof(encoders) / sizeof(EncoderInfo) == ENCODING_ENUM_LEN, "every content encoding needs an encoder");
+
+// between equal q-values the first one wins, the one that compresses more
+static const uint8_t encoding_preference[] = {ENCODING_BROTLI, ENCODING_ZSTD, ENCODING_GZIP};
+
+/**
+ * The zstd context of the thread, reused for every body
+ */
+static thread_local ZSTD_CCtx *zstd_context = nullptr;
+
+bool is_compressible(const StringRef *mime) {
+
+	// text and the formats made of text, the others are already compressed (images, audio, video, archives, woff)
+	StringRef text_types[] = {
+	    TO_STRINGREF("text/"),
+	    TO_STRINGREF("application/json"),
+	    TO_STRINGREF("application/javascript"),
+	    TO_STRINGREF("application/xml"),
+	    TO_STRINGREF("application/wasm"),
+	    TO_STRINGREF("image/svg+xml"),
+	    TO_STRINGREF("image/vnd.microsoft.icon"),
+	    TO_STRINGREF("font/ttf"),
+	    TO_STRINGREF("font/otf"),
+	};
+
+	bool text = false;
+	for (size_t i = 0; i < sizeof(text_types) / sizeof(StringRef) && !text; ++i) {
+		text = mime->len >= text_types[i].len && strncasecmp(mime->str, text_types[i].str, text_types[i].len) == 0;
+	}
+
+	return text;
+}
+
+uint8_t compression_tier(const StringRef *mime, const size_t len) {
+
+	if (len < COMPRESS_MIN_SIZE || !is_compressible(mime)) {
+		return COMPRESS_NONE;
+	}
+
+	// the time grows with the size, the gain of the higher levels does not
+	if (len <= COMPRESS_BEST_MAX_SIZE) {
+		return COMPRESS_BEST;
+	}
+
+	if (len <= COMPRESS_DEFAULT_MAX_SIZE) {
+		return COMPRESS_DEFAULT;
+	}
+
+	return COMPRESS_FAST;
+}
+
+/**
+ * The q-value of a weight as thousandths, 1000 when it is not a valid one
+ *
+ * @param[in] `value` what follows the "q="
+ */
+static int parse_weight(const StringRef *value) {
+
+	if (value->len == 0 || (value->str[0] != '0' && value->str[0] != '1')) {
+		return 1000;
+	}
+
+	int    res   = (value->str[0] - '0') * 1000;
+	int    scale = 100;
+	size_t i     = 2;
+
+	// at most 3 decimals, as the grammar says
+	if (value->len > 1 && value->str[1] == '.') {
+		for (; i < value->len && i < 5 && isdigit((unsigned char)(value->str[i])); ++i) {
+			res += (value->str[i] - '0') * scale;
+			scale /= 10;
+		}
+	}
+
+	return res > 1000 ? 1000 : res;
+}
+
+/**
+ * The q-value of a coding as thousandths, from the first q parameter among the ones after it, 1000 when there is none
+ *
+ * @param[in] `params` the parameters separated by ';', after the first ';'
+ */
+static int parse_qvalue(const StringRef *params) {
+
+	StringRef rest = *params;
+
+	while (rest.len > 0) {
+		auto semicolon = strnchr(rest.str, ';', rest.len);
+
+		StringRef param = {rest.str, semicolon == nullptr ? rest.len : (size_t)(semicolon - rest.str)};
+
+		rest.str += param.len;
+		rest.len -= param.len;
+		if (semicolon != nullptr) {
+			++rest.str;
+			--rest.len;
+		}
+
+		param = trim(&param);
+
+		if (param.len >= 2 && tolower((unsigned char)(param.str[0])) == 'q' && param.str[1] == '=') {
+			StringRef value = {param.str + 2, param.len - 2};
+			return parse_weight(&value);
+		}
+	}
+
+	return 1000;
+}
+
+uint8_t negotiate_encoding(const StringRef *accept, const uint32_t allowed) {
+
+	// -1 for the codings not listed
+	int qvalues[ENCODING_ENUM_LEN];
+	int any = -1;
+
+	for (size_t i = 0; i < ENCODING_ENUM_LEN; ++i) {
+		qvalues[i] = -1;
+	}
+
+	StringRef rest = *accept;
+
+	while (rest.len > 0) {
+		auto comma = strnchr(rest.str, ',', rest.len);
+
+		StringRef element = {rest.str, comma == nullptr ? rest.len : (size_t)(comma - rest.str)};
+
+		rest.str += element.len;
+		rest.len -= element.len;
+		if (comma != nullptr) {
+			++rest.str;
+			--rest.len;
+		}
+
+		auto      semicolon = strnchr(element.str, ';', element.len);
+		StringRef coding    = {element.str, semicolon == nullptr ? element.len : (size_t)(semicolon - element.str)};
+		int       q         = 1000;
+
+		if (semicolon != nullptr) {
+			StringRef params = {semicolon + 1, element.len - coding.len - 1};
+			q                = parse_qvalue(&params);
+		}
+
+		coding = trim(&coding);
+
+		if (coding.len == 1 && coding.str[0] == '*') {
+			any = q;
+			continue;
+		}
+
+		for (size_t i = 0; i < ENCODING_ENUM_LEN; ++i) {
+			if (coding.len == content_encodings_str[i].len && strncasecmp(coding.str, content_encodings_str[i].str, coding.len) == 0) {
+				qvalues[i] = q;
+				break;
+			}
+		}
+	}
+
+	uint8_t best   = ENCODING_IDENTITY;
+	int     best_q = 0;
+
+	for (size_t i = 0; i < sizeof(encoding_preference); ++i) {
+		auto encoding = encoding_preference[i];
+		int  q        = qvalues[encoding] >= 0 ? qvalues[encoding] : any;
+
+		if (q > best_q && (allowed & (1u << encoding)) != 0) {
+			best   = encoding;
+			best_q = q;
+		}
+	}
+
+	// identity is acceptable even when not listed, but it wins only if asked for with a higher q-value
+	if (qvalues[ENCODING_IDENTITY] > best_q) {
+		return ENCODING_IDENTITY;
+	}
+
+	return best;
+}
+
+int encoding_level(const uint8_t encoding, const uint8_t tier) {
+
+	if (encoding >= ENCODING_ENUM_LEN || tier >= COMPRESS_ENUM_LEN) {
+		return 0;
+	}
+
+	return encoders[encoding].levels[tier];
+}
+
+bool encode_body(const uint8_t encoding, const uint8_t tier, const StringRef *data, StringOwn *output) {
+
+	if (encoding >= ENCODING_ENUM_LEN || tier == COMPRESS_NONE || tier >= COMPRESS_ENUM_LEN || encoders[encoding].encode == nullptr) {
+		return false;
+	}
+
+	return encoders[encoding].encode(data, encoders[encoding].levels[tier], output);
+}
+
+bool compress_br(const StringRef *data, const int level, StringOwn *output) {
+
+	auto bound = BrotliEncoderMaxCompressedSize(data->len);
+
+	// 0 means the input is too big to know
+	if (bound == 0) {
+		return false;
+	}
+
+	output->str = realloc(output->str, bound);
+	TEST_ALLOC(output->str)
+
+	size_t len = bound;
+
+	if (!BrotliEncoderCompress(level, BROTLI_DEFAULT_WINDOW, BROTLI_MODE_GENERIC, data->len, (const uint8_t *)(data->str), &len, (uint8_t *)(output->str))) {
+		llog(LOG_ERROR, "[COMPRESS] Brotli failed on %zu bytes\n", data->len);
+		output->len = 0;
+		return false;
+	}
+
+	output->len = len;
+
+	if (output->len > 0 && output->len < bound) {
+		output->str = realloc(output->str, output->len);
+		TEST_ALLOC(output->str)
+	}
+
+	return true;
+}
+
+bool compress_zstd(const StringRef *data, const int level, StringOwn *output) {
+
+	if (zstd_context == nullptr) {
+		zstd_context = ZSTD_createCCtx();
+		TEST_ALLOC(zstd_context)
+	}
+
+	auto bound = ZSTD_compressBound(data->len);
+
+	output->str = realloc(output->str, bound);
+	TEST_ALLOC(output->str)
+
+	auto len = ZSTD_compressCCtx(zstd_context, output->str, bound, data->str, data->len, level);
+
+	if (ZSTD_isError(len)) {
+		llog(LOG_ERROR, "[COMPRESS] Zstd failed on %zu bytes: %s\n", data->len, ZSTD_getErrorName(len));
+		output->len = 0;
+		return false;
+	}
+
+	output->len = len;
+
+	if (output->len > 0 && output->len < bound) {
+		output->str = realloc(output->str, output->len);
+		TEST_ALLOC(output->str)
+	}
+
+	return true;
+}
+
+void release_encoders() {
+
+	release_gz_stream();
+
+	if (zstd_context != nullptr) {
+		ZSTD_freeCCtx(zstd_context);
+		zstd_context = nullptr;
+	}
+}
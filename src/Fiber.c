@@ -0,0 +1,430 @@
+#include "Fiber.h"
+
+#include "logger.h"
+#include "utils.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#if defined(__SANITIZE_ADDRESS__)
+#	include <sanitizer/common_interface_defs.h>
+#endif
+
+/**
+ * Saves the callee saved registers on the current stack, stores the stack pointer in `save` and continues from `next`
+ * the other registers are saved by the caller, as for any call
+ */
+extern void fiber_switch(void **save, void *next) __asm__("sns_fiber_switch");
+
+#if defined(__x86_64__)
+
+// rbp rbx r12-r15, and the control words of sse and x87, the return address is pushed by the call
+__asm__(".pushsection .text\n"
+        ".globl sns_fiber_switch\n"
+        ".hidden sns_fiber_switch\n"
+        ".type sns_fiber_switch, @function\n"
+        "sns_fiber_switch:\n"
+        "	pushq %rbp\n"
+        "	pushq %rbx\n"
+        "	pushq %r12\n"
+        "	pushq %r13\n"
+        "	pushq %r14\n"
+        "	pushq %r15\n"
+        "	subq $8, %rsp\n"
+        "	stmxcsr (%rsp)\n"
+        "	fnstcw 4(%rsp)\n"
+        "	movq %rsp, (%rdi)\n"
+        "	movq %rsi, %rsp\n"
+        "	ldmxcsr (%rsp)\n"
+        "	fldcw 4(%rsp)\n"
+        "	addq $8, %rsp\n"
+        "	popq %r15\n"
+        "	popq %r14\n"
+        "	popq %r13\n"
+        "	popq %r12\n"
+        "	popq %rbx\n"
+        "	popq %rbp\n"
+        "	ret\n"
+        ".size sns_fiber_switch, .-sns_fiber_switch\n"
+        ".popsection\n");
+
+// the control words, the saved registers and the return address
+constexpr size_t FIBER_FRAME_SIZE = 8 + 6 * 8 + 8;
+
+/**
+ * Lays out the frame fiber_switch pops when it first switches to the fiber, so it returns in `entry`
+ *
+ * @return the stack pointer to switch to
+ */
+static void *initial_frame(char *top, void (*entry)()) {
+
+	// the slot above the return address is where entry finds the return address of its own call, it never returns
+	auto frame = (uint64_t *)(top - 8 - FIBER_FRAME_SIZE);
+	memset(frame, 0, FIBER_FRAME_SIZE + 8);
+
+	// the default control words: every floating point exception masked, round to nearest
+	frame[0] = 0x037F00001F80;
+	frame[7] = (uint64_t)(entry);
+
+	return frame;
+}
+
+#elif defined(__aarch64__)
+
+// x19-x28, the frame pointer, the link register and d8-d15, the stack stays aligned to 16 bytes
+__asm__(".pushsection .text\n"
+        ".globl sns_fiber_switch\n"
+        ".hidden sns_fiber_switch\n"
+        ".type sns_fiber_switch, %function\n"
+        "sns_fiber_switch:\n"
+        "	sub sp, sp, #176\n"
+        "	stp x19, x20, [sp, #0]\n"
+        "	stp x21, x22, [sp, #16]\n"
+        "	stp x23, x24, [sp, #32]\n"
+        "	stp x25, x26, [sp, #48]\n"
+        "	stp x27, x28, [sp, #64]\n"
+        "	stp x29, x30, [sp, #80]\n"
+        "	stp d8, d9, [sp, #96]\n"
+        "	stp d10, d11, [sp, #112]\n"
+        "	stp d12, d13, [sp, #128]\n"
+        "	stp d14, d15, [sp, #144]\n"
+        "	mov x9, sp\n"
+        "	str x9, [x0]\n"
+        "	mov sp, x1\n"
+        "	ldp x19, x20, [sp, #0]\n"
+        "	ldp x21, x22, [sp, #16]\n"
+        "	ldp x23, x24, [sp, #32]\n"
+        "	ldp x25, x26, [sp, #48]\n"
+        "	ldp x27, x28, [sp, #64]\n"
+        "	ldp x29, x30, [sp, #80]\n"
+        "	ldp d8, d9, [sp, #96]\n"
+        "	ldp d10, d11, [sp, #112]\n"
+        "	ldp d12, d13, [sp, #128]\n"
+        "	ldp d14, d15, [sp, #144]\n"
+        "	add sp, sp, #176\n"
+        "	ret\n"
+        ".size sns_fiber_switch, .-sns_fiber_switch\n"
+        ".popsection\n");
+
+constexpr size_t FIBER_FRAME_SIZE = 176;
+
+/**
+ * Lays out the frame fiber_switch loads when it first switches to the fiber, so it returns in `entry`
+ *
+ * @return the stack pointer to switch to
+ */
+static void *initial_frame(char *top, void (*entry)()) {
+
+	auto frame = (uint64_t *)(top - FIBER_FRAME_SIZE);
+	memset(frame, 0, FIBER_FRAME_SIZE);
+
+	// the link register, with a null frame pointer the stack traces end at the fiber
+	frame[11] = (uint64_t)(entry);
+
+	return frame;
+}
+
+#else
+#	error "The fibers switch context only on x86_64 and aarch64"
+#endif
+
+static thread_local Fiber *running = nullptr; // the fiber the thread is running, nullptr while it runs the loop
+static thread_local void  *loop_sp;           // where the loop switched to the fiber from
+static thread_local int    loop_fd = -1;      // the epoll instance of the loop
+static thread_local bool   cancelled = false; // the loop is stopping, every wait fails right away
+
+static thread_local Fiber *wait_head = nullptr; // the waiting fiber that times out first, they all wait as long
+static thread_local Fiber *wait_tail = nullptr;
+
+static thread_local Fiber *pool       = nullptr; // the finished fibers kept for reuse, linked through next
+static thread_local size_t pool_count = 0;
+
+static thread_local const void *loop_stack_bottom = nullptr; // the stack of the loop, for the address sanitizer
+static thread_local size_t      loop_stack_size   = 0;
+
+/**
+ * Tells the address sanitizer that the stack is about to change, without it the other stack looks like an overflow
+ *
+ * @param[out] `fake_stack` where to keep the fake stack of the one left, nullptr if it is left for good
+ */
+static void leave_stack([[maybe_unused]] void **fake_stack, [[maybe_unused]] const void *bottom, [[maybe_unused]] const size_t size) {
+#if defined(__SANITIZE_ADDRESS__)
+	__sanitizer_start_switch_fiber(fake_stack, bottom, size);
+#endif
+}
+
+/**
+ * Tells the address sanitizer that the stack changed
+ *
+ * @param[in] `fake_stack` what leave_stack kept when this stack was left, nullptr the first time
+ * @param[out] `bottom` `size` where to put the stack that was left
+ */
+static void arrive_stack([[maybe_unused]] void *fake_stack, [[maybe_unused]] const void **bottom, [[maybe_unused]] size_t *size) {
+#if defined(__SANITIZE_ADDRESS__)
+	__sanitizer_finish_switch_fiber(fake_stack, bottom, size);
+#endif
+}
+
+/**
+ * Where every fiber starts, on its own stack, once run returns the fiber goes back to the loop for the last time
+ */
+[[noreturn]]
+static void fiber_entry() {
+
+	auto self = running;
+	arrive_stack(nullptr, &loop_stack_bottom, &loop_stack_size);
+
+	self->run(self->data, self->arg);
+
+	self->done = true;
+	leave_stack(nullptr, loop_stack_bottom, loop_stack_size);
+	fiber_switch(&self->sp, loop_sp);
+
+	// the loop never switches to a finished fiber
+	abort();
+}
+
+/**
+ * Takes a finished fiber from the pool, or maps a new stack with a guard page below it
+ * a stack overflow hits the guard page and faults, instead of writing over another mapping
+ *
+ * @return nullptr if the stack could not be mapped
+ */
+static Fiber *take_fiber() {
+
+	if (pool != nullptr) {
+		auto fiber = pool;
+		pool       = fiber->next;
+		--pool_count;
+		return fiber;
+	}
+
+	auto  page  = (size_t)(sysconf(_SC_PAGESIZE));
+	char *stack = mmap(nullptr, page + FIBER_STACK_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK | MAP_NORESERVE, -1, 0);
+
+	if (stack == MAP_FAILED) {
+		llog(LOG_ERROR, "[FIBER] Could not map a stack -> %s\n", strerror(errno));
+		return nullptr;
+	}
+
+	if (mprotect(stack, page, PROT_NONE) != 0) {
+		llog(LOG_ERROR, "[FIBER] Could not protect the guard page -> %s\n", strerror(errno));
+		munmap(stack, page + FIBER_STACK_SIZE);
+		return nullptr;
+	}
+
+	Fiber *fiber = malloc(sizeof(Fiber));
+	TEST_ALLOC(fiber)
+
+	fiber->stack = stack;
+	fiber->arena = make_Arena(0);
+
+	return fiber;
+}
+
+/**
+ * Unmaps the stack of the fiber and frees it
+ */
+static void destroy_fiber(Fiber *fiber) {
+
+	munmap(fiber->stack, (size_t)(sysconf(_SC_PAGESIZE)) + FIBER_STACK_SIZE);
+	destroy_Arena(&fiber->arena);
+	free(fiber);
+}
+
+/**
+ * Switches from the loop to the fiber until it waits or returns, a finished fiber goes back in the pool
+ */
+static void enter_fiber(Fiber *fiber) {
+
+	void *fake_stack = nullptr;
+
+	running = fiber;
+	leave_stack(&fake_stack, fiber->stack + (size_t)(sysconf(_SC_PAGESIZE)), FIBER_STACK_SIZE);
+	fiber_switch(&loop_sp, fiber->sp);
+	arrive_stack(fake_stack, nullptr, nullptr);
+	running = nullptr;
+
+	if (!fiber->done) {
+		return;
+	}
+
+	if (pool_count == FIBER_POOL_SIZE) {
+		destroy_fiber(fiber);
+		return;
+	}
+
+	// the blocks stay, the next fiber that uses the arena won't call malloc
+	reset_Arena(&fiber->arena);
+
+	fiber->next = pool;
+	pool        = fiber;
+	++pool_count;
+}
+
+/**
+ * Takes the fiber out of the waiting list
+ */
+static void unlink_waiting(Fiber *fiber) {
+
+	if (fiber->prev == nullptr) {
+		wait_head = fiber->next;
+	} else {
+		fiber->prev->next = fiber->next;
+	}
+
+	if (fiber->next == nullptr) {
+		wait_tail = fiber->prev;
+	} else {
+		fiber->next->prev = fiber->prev;
+	}
+
+	fiber->prev = nullptr;
+	fiber->next = nullptr;
+}
+
+void set_fiber_loop(const int epoll_fd) {
+	loop_fd   = epoll_fd;
+	cancelled = false;
+}
+
+bool run_fiber(FiberFunction run, void *data, void *arg) {
+
+	if (running != nullptr || loop_fd < 0) {
+		return false;
+	}
+
+	auto fiber = take_fiber();
+
+	if (fiber == nullptr) {
+		return false;
+	}
+
+	fiber->run   = run;
+	fiber->data  = data;
+	fiber->arg   = arg;
+	fiber->prev  = nullptr;
+	fiber->next  = nullptr;
+	fiber->ready = false;
+	fiber->done  = false;
+	fiber->sp    = initial_frame(fiber->stack + (size_t)(sysconf(_SC_PAGESIZE)) + FIBER_STACK_SIZE, fiber_entry);
+
+	enter_fiber(fiber);
+	return true;
+}
+
+void resume_fiber(Fiber *fiber, const bool ready) {
+
+	unlink_waiting(fiber);
+
+	fiber->ready = ready;
+	enter_fiber(fiber);
+}
+
+Fiber *current_fiber() {
+	return running;
+}
+
+bool fiber_wait(const int fd, const uint32_t events, void *data, const int timeout_ms) {
+
+	auto self = running;
+
+	if (self == nullptr || cancelled) {
+		return false;
+	}
+
+	// one shot like the reactor, the loop gets a single event and the socket is left disarmed
+	struct epoll_event ev = {
+	    .events = events | EPOLLET | EPOLLONESHOT | EPOLLRDHUP,
+	    .data   = {.ptr = data},
+	};
+
+	// the socket of a connection that another loop owns between its requests, it stays registered here until it is closed
+	auto res = epoll_ctl(loop_fd, EPOLL_CTL_MOD, fd, &ev);
+	if (res == -1 && errno == ENOENT) {
+		res = epoll_ctl(loop_fd, EPOLL_CTL_ADD, fd, &ev);
+	}
+
+	if (res == -1) {
+		llog(LOG_ERROR, "[FIBER] Could not wait on socket %d -> %s\n", fd, strerror(errno));
+		return false;
+	}
+
+	self->wait_fd     = fd;
+	self->wait_data   = data;
+	self->deadline_ns = get_monotonic_ns() + (uint64_t)(timeout_ms) * 1000000;
+	self->next        = nullptr;
+	self->prev        = wait_tail;
+
+	if (wait_tail == nullptr) {
+		wait_head = self;
+	} else {
+		wait_tail->next = self;
+	}
+
+	wait_tail = self;
+
+	leave_stack(&self->fake_stack, loop_stack_bottom, loop_stack_size);
+	fiber_switch(&self->sp, loop_sp);
+	arrive_stack(self->fake_stack, &loop_stack_bottom, &loop_stack_size);
+
+	return self->ready;
+}
+
+/**
+ * Disarms the socket of the fiber and resumes it with a failed wait
+ */
+static void fail_wait(Fiber *fiber) {
+
+	// an event that arrives now would resume a fiber that is not waiting anymore
+	struct epoll_event ev = {
+	    .events = 0,
+	    .data   = {.ptr = fiber->wait_data},
+	};
+
+	epoll_ctl(loop_fd, EPOLL_CTL_MOD, fiber->wait_fd, &ev);
+
+	resume_fiber(fiber, false);
+}
+
+uint64_t next_fiber_deadline() {
+	return wait_head == nullptr ? 0 : wait_head->deadline_ns;
+}
+
+size_t expire_fibers(const uint64_t now_ns) {
+
+	size_t expired = 0;
+
+	while (wait_head != nullptr && wait_head->deadline_ns <= now_ns) {
+		llog(LOG_WARNING, "[FIBER] Socket %d timed out\n", wait_head->wait_fd);
+
+		fail_wait(wait_head);
+		++expired;
+	}
+
+	return expired;
+}
+
+void cancel_fibers() {
+
+	cancelled = true;
+
+	while (wait_head != nullptr) {
+		fail_wait(wait_head);
+	}
+}
+
+void release_fibers() {
+
+	while (pool != nullptr) {
+		auto next = pool->next;
+		destroy_fiber(pool);
+		pool = next;
+	}
+
+	pool_count = 0;
+}
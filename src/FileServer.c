@@ -0,0 +1,451 @@
+#include "FileServer.h"
+
+#include "AssetCache.h"
+#include "DateCache.h"
+#include "Encoding.h"
+#include "constants.h"
+#include "logger.h"
+#include "pages.h"
+#include "utils.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+
+typedef struct {
+	StringRef extension; // without the '.'
+	StringRef mime;      // the value of the Content-Type
+} MimeType;
+
+static const MimeType mime_types[] = {
+    {TO_STRINGREF("html"), TO_STRINGREF("text/html; charset=utf-8")},
+    {TO_STRINGREF("htm"), TO_STRINGREF("text/html; charset=utf-8")},
+    {TO_STRINGREF("css"), TO_STRINGREF("text/css; charset=utf-8")},
+    {TO_STRINGREF("js"), TO_STRINGREF("text/javascript; charset=utf-8")},
+    {TO_STRINGREF("mjs"), TO_STRINGREF("text/javascript; charset=utf-8")},
+    {TO_STRINGREF("json"), TO_STRINGREF("application/json")},
+    {TO_STRINGREF("txt"), TO_STRINGREF("text/plain; charset=utf-8")},
+    {TO_STRINGREF("md"), TO_STRINGREF("text/markdown; charset=utf-8")},
+    {TO_STRINGREF("csv"), TO_STRINGREF("text/csv; charset=utf-8")},
+    {TO_STRINGREF("xml"), TO_STRINGREF("application/xml")},
+    {TO_STRINGREF("svg"), TO_STRINGREF("image/svg+xml")},
+    {TO_STRINGREF("png"), TO_STRINGREF("image/png")},
+    {TO_STRINGREF("jpg"), TO_STRINGREF("image/jpeg")},
+    {TO_STRINGREF("jpeg"), TO_STRINGREF("image/jpeg")},
+    {TO_STRINGREF("gif"), TO_STRINGREF("image/gif")},
+    {TO_STRINGREF("webp"), TO_STRINGREF("image/webp")},
+    {TO_STRINGREF("avif"), TO_STRINGREF("image/avif")},
+    {TO_STRINGREF("ico"), TO_STRINGREF("image/vnd.microsoft.icon")},
+    {TO_STRINGREF("woff"), TO_STRINGREF("font/woff")},
+    {TO_STRINGREF("woff2"), TO_STRINGREF("font/woff2")},
+    {TO_STRINGREF("ttf"), TO_STRINGREF("font/ttf")},
+    {TO_STRINGREF("otf"), TO_STRINGREF("font/otf")},
+    {TO_STRINGREF("pdf"), TO_STRINGREF("application/pdf")},
+    {TO_STRINGREF("wasm"), TO_STRINGREF("application/wasm")},
+    {TO_STRINGREF("zip"), TO_STRINGREF("application/zip")},
+    {TO_STRINGREF("gz"), TO_STRINGREF("application/gzip")},
+    {TO_STRINGREF("mp3"), TO_STRINGREF("audio/mpeg")},
+    {TO_STRINGREF("ogg"), TO_STRINGREF("audio/ogg")},
+    {TO_STRINGREF("wav"), TO_STRINGREF("audio/wav")},
+    {TO_STRINGREF("mp4"), TO_STRINGREF("video/mp4")},
+    {TO_STRINGREF("webm"), TO_STRINGREF("video/webm")},
+};
+
+static const MimeType default_mime = {TO_STRINGREF(""), TO_STRINGREF("application/octet-stream")};
+
+// the caches used by serve_file
+static FileCache  file_cache = {.root_fd = -1};
+static AssetCache asset_cache;
+
+/**
+ * The content type of the file from its extension, only looked up when the file is opened
+ */
+static const MimeType *get_mime_type(const StringRef *name) {
+
+	auto dot = strrnchr(name->str, '.', name->len);
+
+	// no extension, or the dot is in a directory
+	if (dot == nullptr || strnchr(dot, '/', name->len - (size_t)(dot - name->str)) != nullptr) {
+		return &default_mime;
+	}
+
+	StringRef extension = {dot + 1, name->len - (size_t)(dot - name->str) - 1};
+
+	for (size_t i = 0; i < sizeof(mime_types) / sizeof(MimeType); ++i) {
+		if (mime_types[i].extension.len == extension.len && strncasecmp(mime_types[i].extension.str, extension.str, extension.len) == 0) {
+			return &mime_types[i];
+		}
+	}
+
+	return &default_mime;
+}
+
+bool initialize_FileCache(const StringRef *base_dir, FileCache *cache) {
+
+	// the base dir is not null terminated
+	StringOwn dir = {malloc(base_dir->len + 1), base_dir->len};
+	TEST_ALLOC(dir.str)
+	memcpy(dir.str, base_dir->str, base_dir->len);
+	dir.str[dir.len] = '\0';
+
+	memset(cache->slots, 0, sizeof(cache->slots));
+	cache->root_fd = open(dir.str, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+
+	if (cache->root_fd < 0) {
+		llog(LOG_ERROR, "[FILES] Could not open '%s': %s\n", dir.str, strerror(errno));
+		free(dir.str);
+		return false;
+	}
+
+	free(dir.str);
+	pthread_rwlock_init(&cache->lock, nullptr);
+
+	return true;
+}
+
+void destroy_FileCache(FileCache *cache) {
+
+	if (cache->root_fd < 0) {
+		return;
+	}
+
+	for (size_t i = 0; i < FILE_CACHE_SLOTS; ++i) {
+		if (cache->slots[i] != nullptr) {
+			release_file(cache->slots[i]);
+			cache->slots[i] = nullptr;
+		}
+	}
+
+	pthread_rwlock_destroy(&cache->lock);
+	close(cache->root_fd);
+	cache->root_fd = -1;
+}
+
+bool sanitize_path(const StringRef *url, Arena *arena, StringOwn *path) {
+
+	// decoding never makes the path longer, the 2 are for the "." of the base directory and the null terminator
+	StringOwn decoded = {alloc_Arena(arena, url->len + 2), url->len + 2};
+	url_decode(&decoded, url);
+
+	// written in place, the sanitized path is never longer than the decoded one
+	char  *out = decoded.str;
+	size_t len = 0;
+
+	for (size_t i = 0; i < decoded.len;) {
+
+		auto      slash   = strnchr(decoded.str + i, '/', decoded.len - i);
+		StringRef segment = {decoded.str + i, slash == nullptr ? decoded.len - i : (size_t)(slash - decoded.str) - i};
+		i += segment.len + 1;
+
+		if (segment.len == 0 || (segment.len == 1 && segment.str[0] == '.')) {
+			continue;
+		}
+
+		// a %00 would cut the path given to open, a '..' would leave the base directory
+		if ((segment.len == 2 && segment.str[0] == '.' && segment.str[1] == '.') || memchr(segment.str, '\0', segment.len) != nullptr) {
+			return false;
+		}
+
+		if (len > 0) {
+			out[len++] = '/';
+		}
+
+		memmove(out + len, segment.str, segment.len);
+		len += segment.len;
+	}
+
+	if (len == 0) {
+		out[len++] = '.';
+	}
+
+	out[len] = '\0';
+	*path    = (StringOwn){out, len};
+
+	return true;
+}
+
+/**
+ * The slot where the search for the entry starts
+ */
+static size_t hash_path(const StringOwn *path) {
+	return (size_t)(hash_bytes(path->str, path->len)) & (FILE_CACHE_SLOTS - 1);
+}
+
+/**
+ * The entry of the path, an entry can be anywhere in the FILE_CACHE_PROBES slots after its hash
+ * the slots are never compacted so all of them are checked
+ */
+static FileEntry *find_entry(const FileCache *cache, const StringOwn *path, size_t *slot) {
+
+	auto start = hash_path(path);
+
+	for (size_t i = 0; i < FILE_CACHE_PROBES; ++i) {
+		auto index = (start + i) & (FILE_CACHE_SLOTS - 1);
+		auto entry = cache->slots[index];
+
+		if (entry != nullptr && equal_StringOwn(&entry->path, path)) {
+			*slot = index;
+			return entry;
+		}
+	}
+
+	return nullptr;
+}
+
+/**
+ * Where to put a new entry for the path, an empty slot or the one checked the longest time ago
+ */
+static size_t choose_slot(const FileCache *cache, const StringOwn *path) {
+
+	auto   start  = hash_path(path);
+	size_t oldest = start;
+
+	for (size_t i = 0; i < FILE_CACHE_PROBES; ++i) {
+		auto index = (start + i) & (FILE_CACHE_SLOTS - 1);
+
+		if (cache->slots[index] == nullptr) {
+			return index;
+		}
+
+		if (atomic_load_explicit(&cache->slots[index]->checked_ns, memory_order_relaxed) < atomic_load_explicit(&cache->slots[oldest]->checked_ns, memory_order_relaxed)) {
+			oldest = index;
+		}
+	}
+
+	return oldest;
+}
+
+/**
+ * Tells if the cached stat can still be trusted, once every FILE_CACHE_TTL_NS the open file is checked again
+ * a file replaced by a rename has no links left, a file modified in place has a different size or mtime
+ */
+static bool is_fresh(FileEntry *entry, const uint64_t now) {
+
+	if (now - atomic_load_explicit(&entry->checked_ns, memory_order_relaxed) < FILE_CACHE_TTL_NS) {
+		return true;
+	}
+
+	struct stat info;
+
+	if (fstat(entry->fd, &info) != 0 || info.st_nlink == 0 || info.st_size != entry->info.st_size || info.st_mtim.tv_sec != entry->info.st_mtim.tv_sec || info.st_mtim.tv_nsec != entry->info.st_mtim.tv_nsec) {
+		return false;
+	}
+
+	atomic_store_explicit(&entry->checked_ns, now, memory_order_relaxed);
+	return true;
+}
+
+/**
+ * Opens the file and makes an entry for it, with the reference of the cache
+ */
+static FileEntry *open_entry(const FileCache *cache, const StringOwn *path, const uint64_t now) {
+
+	auto fd = openat(cache->root_fd, path->str, O_RDONLY | O_CLOEXEC);
+
+	if (fd < 0) {
+		return nullptr;
+	}
+
+	struct stat info;
+	StringRef   name = {path->str, path->len};
+
+	if (fstat(fd, &info) == 0 && S_ISDIR(info.st_mode)) {
+		auto index = openat(fd, FILE_INDEX_NAME, O_RDONLY | O_CLOEXEC);
+		close(fd);
+
+		if (index < 0) {
+			return nullptr;
+		}
+
+		fd   = index;
+		name = (StringRef)TO_STRINGREF(FILE_INDEX_NAME);
+
+		if (fstat(fd, &info) != 0) {
+			info.st_mode = 0;
+		}
+	}
+
+	// only regular files are served, not devices, pipes and the like
+	if (!S_ISREG(info.st_mode)) {
+		close(fd);
+		return nullptr;
+	}
+
+	FileEntry *res = malloc(sizeof(FileEntry));
+	TEST_ALLOC(res)
+
+	res->path = (StringOwn){copy_StringOwn(path), path->len};
+	res->mime        = get_mime_type(&name)->mime;
+	res->compression = compression_tier(&res->mime, (size_t)(info.st_size));
+	res->info        = info;
+	res->fd          = fd;
+	format_http_date(info.st_mtim.tv_sec, res->last_modified);
+	atomic_init(&res->checked_ns, now);
+	atomic_init(&res->refs, 1);
+
+	return res;
+}
+
+FileEntry *acquire_file(FileCache *cache, const StringOwn *path) {
+
+	auto   now = get_monotonic_ns();
+	size_t slot;
+
+	// the hot path, the file is cached and did not change
+	pthread_rwlock_rdlock(&cache->lock);
+
+	auto entry = find_entry(cache, path, &slot);
+
+	if (entry != nullptr && is_fresh(entry, now)) {
+		// the lock keeps the entry alive until the reference is taken
+		atomic_fetch_add_explicit(&entry->refs, 1, memory_order_relaxed);
+		pthread_rwlock_unlock(&cache->lock);
+		return entry;
+	}
+
+	pthread_rwlock_unlock(&cache->lock);
+
+	// opened outside of the lock, the other requests do not wait for the disk
+	auto fresh = open_entry(cache, path, now);
+
+	pthread_rwlock_wrlock(&cache->lock);
+
+	auto stale = find_entry(cache, path, &slot);
+
+	if (stale == nullptr) {
+		if (fresh == nullptr) {
+			pthread_rwlock_unlock(&cache->lock);
+			return nullptr;
+		}
+
+		slot  = choose_slot(cache, path);
+		stale = cache->slots[slot];
+	}
+
+	// the file is gone or changed, even if another thread already replaced the entry this one is as good
+	cache->slots[slot] = fresh;
+
+	if (fresh != nullptr) {
+		atomic_fetch_add_explicit(&fresh->refs, 1, memory_order_relaxed);
+	}
+
+	pthread_rwlock_unlock(&cache->lock);
+
+	// the requests still using the old file keep it open until they are done
+	if (stale != nullptr) {
+		release_file(stale);
+	}
+
+	return fresh;
+}
+
+FileEntry *retain_file(FileEntry *entry) {
+	atomic_fetch_add_explicit(&entry->refs, 1, memory_order_relaxed);
+	return entry;
+}
+
+void release_file(FileEntry *entry) {
+
+	if (atomic_fetch_sub_explicit(&entry->refs, 1, memory_order_acq_rel) != 1) {
+		return;
+	}
+
+	close(entry->fd);
+	free(entry->path.str);
+	free(entry);
+}
+
+bool initialize_file_server(const StringRef *base_dir) {
+
+	if (!initialize_FileCache(base_dir, &file_cache)) {
+		return false;
+	}
+
+	initialize_AssetCache(ASSET_CACHE_CAPACITY, &asset_cache);
+	return true;
+}
+
+void destroy_file_server() {
+
+	if (file_cache.root_fd < 0) {
+		return;
+	}
+
+	// the assets hold their files, they go first
+	destroy_AssetCache(&asset_cache);
+	destroy_FileCache(&file_cache);
+}
+
+/**
+ * Lets clients and proxies keep the file for DATE_EXPIRES_AFTER seconds, the Expires date is for HTTP/1.0 caches
+ */
+static void add_cache_fields(OutboundHttpMessage *msg) {
+	static_assert(DATE_EXPIRES_AFTER == 604800, "the max-age must match the Expires date");
+
+	StringRef max_age = TO_STRINGREF("max-age=604800");
+	StringRef expires = get_expires_date();
+	add_header_option(RP_CACHE_CONTROL, &max_age, msg);
+	add_header_option(RP_EXPIRES, &expires, msg);
+}
+
+void serve_file(const HTTP_Method *method, const InboundHttpMessage *in_message, OutboundHttpMessage *out_message) {
+
+	if (*method != HTTP_GET && *method != HTTP_HEAD) {
+		StringRef allow          = TO_STRINGREF("GET, HEAD");
+		out_message->status_code = 405;
+		add_header_option(RP_ALLOW, &allow, out_message);
+		return;
+	}
+
+	StringOwn  path;
+	FileEntry *entry = nullptr;
+
+	if (file_cache.root_fd >= 0 && sanitize_path(&in_message->url, out_message->arena, &path)) {
+		entry = acquire_file(&file_cache, &path);
+	}
+
+	if (entry == nullptr) {
+		StringRef html           = TO_STRINGREF("text/html; charset=utf-8");
+		out_message->status_code = 404;
+		out_message->body        = (StringOwn){copy_StringRef_arena(&Not_Found_Page, out_message->arena), Not_Found_Page.len};
+		add_header_option(RP_CONTENT_TYPE, &html, out_message);
+		return;
+	}
+
+	auto size = (size_t)(entry->info.st_size);
+
+	auto    accepted = in_message->header_options[RQ_ACCEPT_ENCODING];
+	uint8_t encoding = entry->compression != COMPRESS_NONE ? negotiate_encoding(&accepted, ENCODINGS_ALL) : ENCODING_IDENTITY;
+
+	// a HEAD makes the asset too, its header must have the length, the encoding and the Vary a GET gets
+	Asset *asset = nullptr;
+	if (size <= ASSET_MAX_SIZE) {
+		asset = acquire_asset(&asset_cache, entry, encoding, true);
+	}
+
+	if (asset == nullptr) {
+		// sent from the file as it is, after the header, by the server that also releases it
+		auto      content_length = num_to_string(size);
+		StringRef last_modified  = {entry->last_modified, HTTP_DATE_LEN};
+		add_header_option(RP_CONTENT_TYPE, &entry->mime, out_message);
+		add_header_option(RP_CONTENT_LENGTH, &content_length, out_message);
+		add_header_option(RP_LAST_MODIFIED, &last_modified, out_message);
+		add_cache_fields(out_message);
+		out_message->file = entry;
+		return;
+	}
+
+	// the asset holds the file
+	release_file(entry);
+
+	// Content-Type, Content-Length, ETag, Last-Modified, Vary and Content-Encoding, formatted when the asset was made
+	add_header_fields(&asset->header, out_message);
+	add_cache_fields(out_message);
+
+	// the body is not copied, the asset stays alive until the response is sent
+	out_message->body  = asset->body;
+	out_message->asset = asset;
+}
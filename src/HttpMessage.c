@@ -1,48 +1,99 @@
 #include "HttpMessage.h"
 
+#include "DateCache.h"
 #include "MiniMap_StringRef_StringRef.h"
 #include "StringRef.h"
 #include "constants.h"
+#include "header_hash.h"
+#include "scan.h"
 #include "utils.h"
 
 #include <errno.h>
 #include <logger.h>
 #include <stdio.h>
+#include <strings.h>
+
+// both versions of the status line of a code, the digits and the phrase are joined at compile time
+#define STATUS_LINE(code, phrase)                          \
+	[code] = {                                             \
+	    TO_STRINGREF("HTTP/1.0 " #code " " phrase "\r\n"), \
+	    TO_STRINGREF("HTTP/1.1 " #code " " phrase "\r\n"), \
+	}
+
+// indexed by status code, then 0 for HTTP/1.0 and 1 for HTTP/1.1, the codes not listed are empty
+static const StringRef status_lines[HTTP_STATUS_LIMIT][2] = {
+    STATUS_LINE(100, "Continue"),
+    STATUS_LINE(101, "Switching Protocols"),
+    STATUS_LINE(200, "OK"),
+    STATUS_LINE(201, "Created"),
+    STATUS_LINE(202, "Accepted"),
+    STATUS_LINE(203, "Non-Authoritative Information"),
+    STATUS_LINE(204, "No Content"),
+    STATUS_LINE(205, "Reset Content"),
+    STATUS_LINE(206, "Partial Content"),
+    STATUS_LINE(300, "Multiple Choices"),
+    STATUS_LINE(301, "Moved Permanently"),
+    STATUS_LINE(302, "Found"),
+    STATUS_LINE(303, "See Other"),
+    STATUS_LINE(304, "Not Modified"),
+    STATUS_LINE(305, "Use Proxy"),
+    STATUS_LINE(307, "Temporary Redirect"),
+    STATUS_LINE(400, "Bad Request"),
+    STATUS_LINE(401, "Unauthorized"),
+    STATUS_LINE(402, "Payment Required"),
+    STATUS_LINE(403, "Forbidden"),
+    STATUS_LINE(404, "Not Found"),
+    STATUS_LINE(405, "Method Not Allowed"),
+    STATUS_LINE(406, "Not Acceptable"),
+    STATUS_LINE(407, "Proxy Authentication Required"),
+    STATUS_LINE(408, "Request Time-out"),
+    STATUS_LINE(409, "Conflict"),
+    STATUS_LINE(410, "Gone"),
+    STATUS_LINE(411, "Length Required"),
+    STATUS_LINE(412, "Precondition Failed"),
+    STATUS_LINE(413, "Request Entity Too Large"),
+    STATUS_LINE(414, "Request-URI Too Large"),
+    STATUS_LINE(415, "Unsupported Media Type"),
+    STATUS_LINE(416, "Requested range not satisfiable"),
+    STATUS_LINE(417, "Expectation Failed"),
+    STATUS_LINE(431, "Request Header Fields Too Large"),
+    STATUS_LINE(500, "Internal Server Error"),
+    STATUS_LINE(501, "Not Implemented"),
+    STATUS_LINE(502, "Bad Gateway"),
+    STATUS_LINE(503, "Service Unavailable"),
+    STATUS_LINE(504, "Gateway Time-out"),
+    STATUS_LINE(505, "HTTP Version not supported"),
+};
+
+#undef STATUS_LINE
 
 void log_malformed_parameter(const StringRef *str_ref) {
 	llog(LOG_WARNING, "Malformed parameter -> '%*s' \n", (int)str_ref->len, str_ref->str);
 }
 
-InboundHttpMessage parse_InboundMessage(const char *str) {
+InboundHttpMessage parse_InboundMessage(const char *buffer, const size_t len, Arena *arena) {
 
 	InboundHttpMessage res = {};
 
-	// use strlen so i'm sure it's not counting the null terminator
-	auto msg_len = strlen(str);
-
-	// save the message in a local pointer so i don't rely on std::string allocation plus a null terminator
-	char *temp = malloc(msg_len + 1);
-	TEST_ALLOC(temp)
-	memcpy(temp, str, msg_len);
-	temp[msg_len] = 0;
-
-	res.raw_message_a = temp;
-	res.parameters    = MiniMap_StringRef_StringRef_make(10, equal_StringRef);
+	// every StringRef of the message points in the buffer, nothing is copied and the body can contain anything, even a '\0'
+	res.raw_message = (StringRef){buffer, len};
+	res.parameters  = MiniMap_StringRef_StringRef_make_arena(10, equal_StringRef, arena);
 
 	// body and header are divided by two newlines
-	auto msg_separator = strstr(res.raw_message_a, "\r\n\r\n");
-
-	unsigned long header_len = (unsigned long)(msg_separator - res.raw_message_a);
+	auto msg_separator = strnstr(buffer, "\r\n\r\n", len);
 
 	StringRef header;
 
-	// strstr return 0 if nothing is found or the given pointer if it is an empty string
-	if (msg_separator == 0 || msg_separator == res.raw_message_a) {
+	// strnstr return nullptr if nothing is found
+	if (msg_separator == nullptr || msg_separator == buffer) {
 		header   = (StringRef){nullptr, 0};
 		res.body = (StringRef){nullptr, 0};
 	} else {
-		header   = (StringRef){res.raw_message_a, header_len};
-		res.body = (StringRef){res.raw_message_a + header_len, msg_len - header_len};
+		res.header_len = (size_t)(msg_separator - buffer);
+
+		// the body starts after the \r\n\r\n
+		header   = (StringRef){buffer, res.header_len};
+		res.body = (StringRef){buffer + res.header_len + 4, len - res.header_len - 4};
 	}
 
 	// now i have the two stringRefs to the body and the header
@@ -55,29 +106,15 @@ InboundHttpMessage parse_InboundMessage(const char *str) {
 	return res;
 }
 
-void destroy_InboundHttpMessage(InboundHttpMessage *mex) {
-
-	if (mex->raw_message_a != nullptr) {
-		free(mex->raw_message_a);
-	}
-
-	MiniMap_StringRef_StringRef_destroy(&mex->parameters);
-}
-
-void destroy_OutboundHttpMessage(OutboundHttpMessage *mex) {
+void add_to_options(StringRef key, StringRef val, InboundHttpMessage *ctx) {
+	auto code = get_parameter_code(&key);
 
-	// for (const auto &[key, val] : mex->m_headerOptions) {
-	for (size_t i = 0; i < mex->header_options.values.count; ++i) {
-		free(mex->header_options.values.data[i].str);
+	// headers we don't know about are ignored
+	if (code >= RQ_ENUM_LEN) {
+		return;
 	}
 
-	MiniMap_u_char_StringOwn_destroy(&mex->header_options);
-	free(mex->body.str);
-	free(mex->resource_name.str);
-}
-
-void add_to_options(StringRef key, StringRef val, InboundHttpMessage *ctx) {
-	ctx->header_options[get_parameter_code(&key)] = val;
+	ctx->header_options[code] = val;
 }
 
 void add_to_params(StringRef key, StringRef val, InboundHttpMessage *ctx) {
@@ -86,39 +123,61 @@ void add_to_params(StringRef key, StringRef val, InboundHttpMessage *ctx) {
 
 void decompose_header(const StringRef *raw_header, InboundHttpMessage *msg) {
 
+	StringRef   request_line;
+	HeaderField fields[HTTP_MAX_HEADER_FIELDS];
+
+	// a single pass finds the end of every line and the ':' of every field
+	auto field_count = tokenize_header(raw_header, &request_line, fields, HTTP_MAX_HEADER_FIELDS);
+
 	// the first line should be "METHOD URL HTTP/Version"
 
 	//  0 |1|    2
-	// GET / HTTP/1.1\r\n
-	ptrdiff_t first_space_len  = strnstr(raw_header->str, " ", raw_header->len) - raw_header->str;                                               // gets me until the space after the method verb
-	ptrdiff_t second_space_len = strnstr(raw_header->str + first_space_len + 1, " ", raw_header->len) - (raw_header->str + first_space_len + 1); // until the space after the URL
-	ptrdiff_t endline_len      = strnstr(raw_header->str, "\r\n", raw_header->len) - (raw_header->str + first_space_len + second_space_len + 2); // until the first newline
+	// GET / HTTP/1.1
+	auto line_end     = request_line.str + request_line.len;
+	auto first_space  = strnchr(request_line.str, ' ', request_line.len);                                                      // after the method verb
+	auto second_space = first_space == nullptr ? nullptr : strnchr(first_space + 1, ' ', (size_t)(line_end - first_space - 1)); // after the URL
+
+	if (second_space == nullptr) {
+		log_malformed_parameter(&request_line);
+		return;
+	}
 
 	// temporary stringRefs
-	StringRef method_ref  = {raw_header->str, (size_t)first_space_len};
-	StringRef version_ref = {raw_header->str + second_space_len + first_space_len + 2, (size_t)endline_len};
+	StringRef method_ref  = {request_line.str, (size_t)(first_space - request_line.str)};
+	StringRef version_ref = {second_space + 1, (size_t)(line_end - second_space - 1)};
 
 	// actually storing the values in the object
 	msg->method  = get_method_code(&method_ref);
-	msg->url     = (StringRef){raw_header->str + first_space_len + 1, (size_t)second_space_len}; // line[1];
+	msg->url     = (StringRef){first_space + 1, (size_t)(second_space - first_space - 1)};
 	msg->version = get_version_code(&version_ref);
 
 	// Now checks if there are query parameters
 
 	// the position of the query parameter marker (if present)
-	auto qmark_index = strnchr(msg->url.str, '?', msg->url.len) - msg->url.str;
+	auto qmark = strnchr(msg->url.str, '?', msg->url.len);
+
+	if (qmark != nullptr) {
+		auto qmark_index = (size_t)(qmark - msg->url.str);
 
-	// if strnchr returns nullptr the result is negative, else is positive
-	if (qmark_index > 0) {
 		// confine the parameters in a single stringREf excluding the '?'
-		StringRef query_parameters = {msg->url.str + qmark_index + 1, msg->url.len - (size_t)(qmark_index)-1};
+		StringRef query_parameters = {qmark + 1, msg->url.len - qmark_index - 1};
 		parse_options(&query_parameters, add_to_params, "&", '=', msg);
 
 		// limit thw url to before the '?'
-		msg->url.len -= (size_t)(qmark_index);
+		msg->url.len = qmark_index;
+	}
+
+	if (field_count == HTTP_MAX_HEADER_FIELDS) {
+		llog(LOG_WARNING, "More than %zu header fields, the rest are ignored\n", HTTP_MAX_HEADER_FIELDS);
 	}
 
-	parse_options(raw_header, add_to_options, "\r\n", ':', msg);
+	for (size_t i = 0; i < field_count; ++i) {
+		if (fields[i].value.str == nullptr) {
+			log_malformed_parameter(&fields[i].name);
+		} else if (!strrefblnk(&fields[i].name)) {
+			add_to_options(fields[i].name, fields[i].value, msg);
+		}
+	}
 }
 
 void decompose_message(InboundHttpMessage *msg) {
@@ -131,6 +190,9 @@ void decompose_message(InboundHttpMessage *msg) {
 		return;
 	}
 
+	// the value points in the receive buffer, it is not terminated
+	StringRef multipart = TO_STRINGREF("multipart/form-data");
+
 	// type one, url encoded
 	if (strncmp("application/x-www-form-urlencoded", content_type.str, content_type.len) == 0) {
 		// the fields are separated from each others with a "&" and key -> value are separated with "="
@@ -142,7 +204,7 @@ void decompose_message(InboundHttpMessage *msg) {
 		parse_options(&msg->body, add_to_params, "\r\n", '=', msg);
 
 		// part three multipart form-data
-	} else if (strnstr("multipart/form-data;", content_type.str, content_type.len) != nullptr) {
+	} else if (scan_str(content_type.str, multipart.str, multipart.len, content_type.len) != nullptr) {
 		// find the divisor
 		//               0              |      1
 		// multipart/form-data; boundary=----asdwadawd
@@ -151,12 +213,16 @@ void decompose_message(InboundHttpMessage *msg) {
 		// sometimes the boundary is encolsed in quotes, take care of this case
 		if (eq == nullptr) {
 			llog(LOG_WARNING, "Malformed multipart form data, no '='\n");
+			return;
 		}
 
+		// the boundary starts after the '='
+		++eq;
+
 		size_t    temp    = (size_t)(content_type.str + content_type.len - eq);
 		StringRef divisor = {eq, temp};
 
-		if (*eq == '"') {
+		if (divisor.len > 0 && *eq == '"') {
 			++divisor.str;
 			--divisor.len;
 		}
@@ -165,71 +231,69 @@ void decompose_message(InboundHttpMessage *msg) {
 	}
 }
 
-StringOwn compose_message(const OutboundHttpMessage *msg) {
-
-	// I preconstruct the status line so i don't have to do multiple allocations and string concatenations
-	// The value to modify are at
-	//                             11
-	//                   012345678901
-	char status_line[] = "HTTP/1.0 XXX ";
-	auto phrase        = get_reason_phrase(msg->status_code);
+StringRef get_status_line(const uint16_t status_code, const uint8_t version, Arena *arena) {
 
-	// A symbolic name for how long the status line is
-	const size_t STATUS_LINE_LEN = sizeof(status_line) - 1;
+	// a response to anything older is 1.0, there is no newer text status line
+	size_t column = version == HTTP_VER_10 || version == HTTP_VER_09 || version == HTTP_VER_UNKN ? 0 : 1;
 
-	// the 2 is for the \r\n separator of the body
-	// the other +2 if for the status line \r\n
-	auto msg_len = STATUS_LINE_LEN + phrase.len + 2 + msg->header_len + 2 + msg->body.len;
+	if (status_code < HTTP_STATUS_LIMIT && status_lines[status_code][column].len > 0) {
+		return status_lines[status_code][column];
+	}
 
-	// the entire message length
-	char *res = malloc(msg_len);
-	TEST_ALLOC(res)
-	memset(res, '\0', msg_len);
+	// a code that does not fit in 3 digits is a bug of the processor
+	if (status_code < 100 || status_code > 999) {
+		return status_lines[500][column];
+	}
 
-	memcpy(res, status_line, STATUS_LINE_LEN);
-	memcpy(res + STATUS_LINE_LEN, phrase.str, phrase.len);
-	memcpy(res + STATUS_LINE_LEN + phrase.len, "\r\n", 2);
+	// a code the table does not know, formatted as it is
+	auto   name = versions_str[column == 0 ? HTTP_VER_10 : HTTP_VER_11];
+	char  *line = alloc_Arena(arena, 32);
+	size_t len  = (size_t)(snprintf(line, 32, "%.*s %u Unknown\r\n", (int)name.len, name.str, status_code));
 
-	// set the status code digit by digit
-	res[11] = '0' + (char)((msg->status_code) % 10);
-	res[10] = '0' + (char)((msg->status_code / 10) % 10);
-	res[9]  = '0' + (char)((msg->status_code / 100) % 10);
+	return (StringRef){line, len};
+}
 
-	char *writer = res + STATUS_LINE_LEN + phrase.len + 2;
+size_t compose_message(const OutboundHttpMessage *msg, StringRef *parts) {
 
-	// add all headers
-	for (size_t i = 0; i < msg->header_options.values.count; ++i) {
+	// the whole line with its \r\n, from the table
+	parts[0] = get_status_line(msg->status_code, msg->version, msg->arena);
 
-		auto key = msg->header_options.keys.data[i];
-		auto val = msg->header_options.values.data[i];
+	// formatted once a second for every response, with its \r\n
+	parts[1] = get_date_header();
 
-		// the format is
-		// name: value\r\n
-		memcpy(writer, header_response_options_str[key].str, header_response_options_str[key].len);
-		writer += header_response_options_str[key].len;
+	size_t count = 2;
 
-		memcpy(writer, ": ", 2);
-		writer += 2;
+	// the fields are already formatted
+	if (msg->headers.len > 0) {
+		parts[count++] = (StringRef){msg->headers.buffer, msg->headers.len};
+	}
 
-		memcpy(writer, val.str, val.len);
-		writer += val.len;
+	// headr body separator
+	parts[count++] = (StringRef)TO_STRINGREF("\r\n");
 
-		memcpy(writer, "\r\n", 2);
-		writer += 2;
+	if (msg->body.len > 0) {
+		parts[count++] = (StringRef){msg->body.str, msg->body.len};
 	}
 
-	// headr body separator
-	memcpy(writer, "\r\n", 2);
-	writer += 2;
+	return count;
+}
+
+bool is_keep_alive(const InboundHttpMessage *msg) {
 
-	memcpy(writer, msg->body.str, msg->body.len);
-	writer += msg->body.len;
+	auto connection = msg->header_options[RQ_CONNECTION];
 
-	StringOwn r = {
-	    .str = res,
-	    .len = msg_len,
-	};
-	return r;
+	StringRef close      = TO_STRINGREF("close");
+	StringRef keep_alive = TO_STRINGREF("keep-alive");
+
+	// HTTP/1.1 is persistent by default, HTTP/1.0 only if asked explicitly
+	switch (msg->version) {
+	case HTTP_VER_11:
+		return !has_token(&connection, &close);
+	case HTTP_VER_10:
+		return has_token(&connection, &keep_alive);
+	default:
+		return false;
+	}
 }
 
 u_char get_method_code(const StringRef *request_method) {
@@ -266,24 +330,32 @@ u_char get_version_code(const StringRef *http_version) {
 
 u_char get_parameter_code(const StringRef *parameter) {
 
-	for (u_char i = 0; i < RQ_ENUM_LEN; ++i) {
-		if (equal_StringRef(parameter, &header_request_options_str[i]) == 0) {
-			return i;
-		}
+	if (parameter->len == 0) {
+		return RQ_ENUM_LEN;
+	}
+
+	// lowercase, for letters, digits and '-', the only characters in the known names
+	auto first  = (uint32_t)((unsigned char)(parameter->str[0]) | 0x20);
+	auto last   = (uint32_t)((unsigned char)(parameter->str[parameter->len - 1]) | 0x20);
+	auto middle = (uint32_t)((unsigned char)(parameter->str[parameter->len / 2]) | 0x20);
+
+	auto code = header_hash_table[(first * HEADER_HASH_FIRST + last * HEADER_HASH_LAST + middle * HEADER_HASH_MIDDLE) & (HEADER_HASH_SIZE - 1)];
+
+	// the hash only tells where the name would be, an unknown header can land on a used slot
+	if (code == RQ_ENUM_LEN || parameter->len != header_request_options_str[code].len || strncasecmp(parameter->str, header_request_options_str[code].str, parameter->len) != 0) {
+		return RQ_ENUM_LEN;
 	}
 
-	return (u_char)(-1);
+	return code;
 }
 
 void parse_options(const StringRef *segment, void (*fun)(StringRef a, StringRef b, InboundHttpMessage *ctx), const char *chunk_sep, const char item_sep, InboundHttpMessage *ctx) {
 
 	const size_t add_len = strlen(chunk_sep); // the lenght to move after the string is found
 
-	auto        start_options        = strnstr(segment->str, chunk_sep, segment->len) + add_len; // the plus 1 is needed to start after the \r\n
-	size_t      len_to_start_options = (size_t)(start_options - segment->str);
-	StringRef   chunk                = {start_options, len_to_start_options};
-	const char *limit                = segment->str + segment->len;
-	auto        limit_len            = segment->len - len_to_start_options;
+	StringRef   chunk     = {segment->str, 0};
+	const char *limit     = segment->str + segment->len;
+	auto        limit_len = segment->len;
 
 	while (chunk.str < limit) {
 
@@ -309,7 +381,7 @@ void parse_options(const StringRef *segment, void (*fun)(StringRef a, StringRef
 			val = trim(&val);
 
 			// check if we actually have a key, the value can be empty
-			if (strrefblnk(&key)) {
+			if (!strrefblnk(&key)) {
 				// finally put it in the map
 				fun(key, val, ctx);
 			}
@@ -365,46 +437,135 @@ void http::parseFormData(const std::string &params, std::string &divisor, std::u
 }
 */
 
+/**
+ * Makes room for `len` more bytes of fields, the buffer is grown in the arena, in place when it was the last allocation
+ */
+static void reserve_headers(HeaderBuilder *headers, const size_t len, Arena *arena) {
+
+	if (headers->len + len <= headers->capacity) {
+		return;
+	}
+
+	auto capacity = headers->capacity == 0 ? HEADER_BUILDER_CAPACITY : headers->capacity;
+	while (capacity < headers->len + len) {
+		capacity *= 2;
+	}
+
+	if (headers->buffer == nullptr) {
+		headers->buffer = alloc_Arena(arena, capacity);
+	} else {
+		headers->buffer = realloc_Arena(arena, headers->buffer, headers->capacity, capacity);
+	}
+
+	headers->capacity = capacity;
+}
+
+/**
+ * Writes "name: value\r\n" at the end of the fields
+ *
+ * @return where the field starts
+ */
+static size_t append_field(HeaderBuilder *headers, const StringRef *name, const StringRef *value, Arena *arena) {
+
+	reserve_headers(headers, name->len + 2 + value->len + 2, arena);
+
+	auto start  = headers->len;
+	auto writer = headers->buffer + start;
+
+	memcpy(writer, name->str, name->len);
+	writer += name->len;
+
+	memcpy(writer, ": ", 2);
+	writer += 2;
+
+	memcpy(writer, value->str, value->len);
+	writer += value->len;
+
+	memcpy(writer, "\r\n", 2);
+
+	headers->len += name->len + 2 + value->len + 2;
+	return start;
+}
+
+/**
+ * Takes the field of the slot out, the ones after it move back, it rarely happens
+ */
+static void remove_field(HeaderBuilder *headers, HeaderSlot *slot) {
+
+	memmove(headers->buffer + slot->start, headers->buffer + slot->start + slot->len, headers->len - slot->start - slot->len);
+	headers->len -= slot->len;
+
+	for (size_t i = 0; i < RP_ENUM_LEN; ++i) {
+		if (headers->slots[i].len > 0 && headers->slots[i].start > slot->start) {
+			headers->slots[i].start -= slot->len;
+		}
+	}
+
+	slot->len = 0;
+}
+
 void add_header_option(const HTTPHeaderResponseOption option, const StringRef *value, OutboundHttpMessage *msg) {
 
-	auto opt = header_response_options_str[option];
+	auto headers = &msg->headers;
+	auto slot    = &headers->slots[option];
+
+	if (slot->len > 0) {
+		remove_field(headers, slot);
+	}
+
+	StringRef cut = {value->str, strnlen(value->str, value->len)};
+	auto      len = headers->len;
+
+	slot->start = (uint32_t)(append_field(headers, &header_response_options_str[option], &cut, msg->arena));
+	slot->len   = (uint32_t)(headers->len - len);
+}
+
+void add_custom_header(const StringRef *name, const StringRef *value, OutboundHttpMessage *msg) {
 
-	size_t len      = value->len;
-	size_t calc_len = strnlen(value->str, value->len);
-	if (calc_len < len) {
-		len = calc_len;
+	if (name->len == 0) {
+		return;
 	}
 
-	StringRef t = {value->str, len};
+	append_field(&msg->headers, name, value, msg->arena);
+}
+
+void add_header_fields(const HeaderBuilder *fields, OutboundHttpMessage *msg) {
 
-	StringOwn cpy = {
-	    copy_StringRef(&t),
-	    len,
-	};
+	auto headers = &msg->headers;
 
-	// if something is already present at the requested position
-	StringOwn old = {};
-	auto      res = MiniMap_u_char_StringOwn_get(&msg->header_options, &option, &old);
+	for (size_t i = 0; i < RP_ENUM_LEN; ++i) {
+		if (fields->slots[i].len > 0 && headers->slots[i].len > 0) {
+			remove_field(headers, &headers->slots[i]);
+		}
+	}
 
-	// this spilt if is here because there might be an insertion of a stringref with nullptr but size > 0
+	reserve_headers(headers, fields->len, msg->arena);
 
-	// something was present, need to unreserve the space it reserved
-	if (res) {
-		msg->header_len -= (opt.len + 2 + old.len + 2);
+	auto start = (uint32_t)(headers->len);
+	memcpy(headers->buffer + start, fields->buffer, fields->len);
+	headers->len += fields->len;
 
-		// free it if it was something
-		if (old.str != nullptr) {
-			// free it
-			free(old.str);
+	for (size_t i = 0; i < RP_ENUM_LEN; ++i) {
+		if (fields->slots[i].len > 0) {
+			headers->slots[i] = (HeaderSlot){start + fields->slots[i].start, fields->slots[i].len};
 		}
 	}
-	MiniMap_u_char_StringOwn_set(&msg->header_options, &option, &cpy);
+}
+
+bool get_header_option(const HTTPHeaderResponseOption option, const OutboundHttpMessage *msg, StringRef *value) {
+
+	auto slot = msg->headers.slots[option];
+
+	if (slot.len == 0) {
+		return false;
+	}
 
-	// account the bytes that will be added later
-	//                 name     ': ' value '\r\n'
-	msg->header_len += (opt.len + 2 + cpy.len + 2);
+	//                   name ': '                             '\r\n'
+	auto skip = header_response_options_str[option].len + 2;
+	*value    = (StringRef){msg->headers.buffer + slot.start + skip, slot.len - skip - 2};
+	return true;
 }
 
 void set_filename(const StringRef *val, OutboundHttpMessage *msg) {
-	msg->resource_name = (StringOwn){copy_StringRef(val), val->len};
+	msg->resource_name = (StringOwn){copy_StringRef_arena(val, msg->arena), val->len};
 }
@@ -15,6 +15,17 @@ MiniMap MiniMap_StringRef_StringRef_make(const size_t initial_count, bool (*eq)(
 	return res;
 }
 
+MiniMap MiniMap_StringRef_StringRef_make_arena(const size_t initial_count, bool (*eq)(const StringRef *, const StringRef *), Arena *arena) {
+
+	MiniMap res;
+
+	res.keys   = MiniVector_StringRef_make_arena(initial_count, arena);
+	res.values = MiniVector_StringRef_make_arena(initial_count, arena);
+	res.eq_fun = eq;
+
+	return res;
+}
+
 void MiniMap_StringRef_StringRef_destroy(MiniMap *map) {
 
 	MiniVector_StringRef_destroy(&map->keys);
@@ -17,15 +17,32 @@ MiniVector MiniVector_StringRef_make(const size_t initial_count) {
 	    .data     = malloc(capacity * sizeof(StringRef)),
 	    .capacity = capacity * sizeof(StringRef),
 	    .count    = 0,
+	    .arena    = nullptr,
 	};
 
 	// copy elision
 	return res;
 }
 
+MiniVector MiniVector_StringRef_make_arena(const size_t initial_count, Arena *arena) {
+	auto capacity = initial_count == 0 ? 10 : initial_count;
+
+	MiniVector res = {
+	    .data     = alloc_Arena(arena, capacity * sizeof(StringRef)),
+	    .capacity = capacity * sizeof(StringRef),
+	    .count    = 0,
+	    .arena    = arena,
+	};
+
+	return res;
+}
+
 void MiniVector_StringRef_destroy(MiniVector *vec) {
 
-	free(vec->data);
+	// the arena releases its memory by itself
+	if (vec->arena == nullptr) {
+		free(vec->data);
+	}
 
 	// zero everythin
 	vec->data     = nullptr;
@@ -35,7 +52,11 @@ void MiniVector_StringRef_destroy(MiniVector *vec) {
 
 void MiniVector_StringRef_grow(MiniVector *vec) {
 
-	vec->data = realloc(vec->data, vec->capacity * GROW_RATE);
+	if (vec->arena == nullptr) {
+		vec->data = realloc(vec->data, vec->capacity * GROW_RATE);
+	} else {
+		vec->data = realloc_Arena(vec->arena, vec->data, vec->capacity, vec->capacity * GROW_RATE);
+	}
 	vec->capacity *= GROW_RATE;
 	// for why 2 and not 1.6 or 1.5
 	// See video -> https://www.youtube.com/watch?v=GZPqDvG615k
@@ -0,0 +1,285 @@
+#include "RequestFramer.h"
+
+#include "StringRef.h"
+#include "utils.h"
+
+#include <ctype.h>
+#include <string.h>
+#include <strings.h>
+
+void reset_RequestFramer(RequestFramer *framer, const size_t max_header, const size_t max_body) {
+	*framer = (RequestFramer){
+	    .max_header = max_header,
+	    .max_body   = max_body,
+	    .state      = FRAME_HEADER,
+	};
+}
+
+static uint8_t frame_error(RequestFramer *framer, const uint16_t status) {
+	framer->error_status = status;
+	framer->state        = FRAME_ERROR;
+	return FRAME_ERROR;
+}
+
+/**
+ * Look in the complete header for Content-Length and Transfer-Encoding and decide how the body is framed
+ * this is the only other pass on the header, and it only looks at the start of each line
+ */
+static uint8_t frame_body(RequestFramer *framer, const char *buffer) {
+
+	const StringRef content_length_name    = TO_STRINGREF("content-length:");
+	const StringRef transfer_encoding_name = TO_STRINGREF("transfer-encoding:");
+	const StringRef chunked                = TO_STRINGREF("chunked");
+
+	bool   has_length   = false;
+	bool   is_chunked   = false;
+	bool   has_encoding = false;
+	size_t length       = 0;
+
+	const char *line  = buffer;
+	const char *limit = buffer + framer->header_len;
+
+	while (line < limit) {
+		const char *end = memchr(line, '\n', (size_t)(limit - line));
+		if (end == nullptr) {
+			end = limit;
+		}
+
+		// without the \r at the end of the line
+		size_t line_len = (size_t)(end - line);
+		if (line_len > 0 && line[line_len - 1] == '\r') {
+			--line_len;
+		}
+
+		if (line_len > content_length_name.len && strncasecmp(line, content_length_name.str, content_length_name.len) == 0) {
+
+			StringRef value = {line + content_length_name.len, line_len - content_length_name.len};
+			value           = trim(&value);
+
+			if (value.len == 0 || has_length) {
+				return frame_error(framer, 400);
+			}
+
+			for (size_t i = 0; i < value.len; ++i) {
+				if (!isdigit((unsigned char)value.str[i])) {
+					return frame_error(framer, 400);
+				}
+
+				// checked at every digit, so the length can not overflow
+				length = length * 10 + (size_t)(value.str[i] - '0');
+				if (length > framer->max_body) {
+					return frame_error(framer, 413);
+				}
+			}
+
+			has_length = true;
+
+		} else if (line_len > transfer_encoding_name.len && strncasecmp(line, transfer_encoding_name.str, transfer_encoding_name.len) == 0) {
+
+			StringRef value = {line + transfer_encoding_name.len, line_len - transfer_encoding_name.len};
+			has_encoding    = true;
+			is_chunked      = has_token(&value, &chunked);
+		}
+
+		line = end + 1;
+	}
+
+	// a request with both is a request smuggling attempt, refuse it
+	if (has_encoding && has_length) {
+		return frame_error(framer, 400);
+	}
+
+	if (has_encoding) {
+		if (!is_chunked) {
+			// no other transfer coding is supported
+			return frame_error(framer, 501);
+		}
+
+		framer->matched   = 0;
+		framer->remaining = 0;
+		framer->state     = FRAME_CHUNK_SIZE;
+		return FRAME_CHUNK_SIZE;
+	}
+
+	framer->remaining = length;
+	framer->state     = length == 0 ? FRAME_DONE : FRAME_BODY;
+	return framer->state;
+}
+
+static int hex_value(const char c) {
+	if (c >= '0' && c <= '9') {
+		return c - '0';
+	}
+	if (c >= 'a' && c <= 'f') {
+		return c - 'a' + 10;
+	}
+	if (c >= 'A' && c <= 'F') {
+		return c - 'A' + 10;
+	}
+	return -1;
+}
+
+// in the chunk size line `matched` holds these flags
+constexpr uint8_t CHUNK_HAS_DIGITS   = 1;
+constexpr uint8_t CHUNK_IN_EXTENSION = 2;
+
+uint8_t advance_RequestFramer(RequestFramer *framer, char *buffer, const size_t len) {
+
+	static const char terminator[] = "\r\n\r\n";
+
+	while (framer->read < len) {
+
+		switch (framer->state) {
+
+		case FRAME_HEADER:
+		case FRAME_TRAILER: {
+			char c = buffer[framer->read++];
+
+			if (c == terminator[framer->matched]) {
+				++framer->matched;
+			} else {
+				framer->matched = c == '\r' ? 1 : 0;
+			}
+
+			if (framer->matched < 4) {
+				if (framer->state == FRAME_HEADER) {
+					framer->write = framer->read;
+
+					if (framer->read > framer->max_header) {
+						return frame_error(framer, 431);
+					}
+				}
+				break;
+			}
+
+			if (framer->state == FRAME_TRAILER) {
+				// the trailer fields are not kept, the request ends with the body
+				framer->state = FRAME_DONE;
+				return FRAME_DONE;
+			}
+
+			framer->header_len = framer->read - 4;
+			framer->body_start = framer->read;
+			framer->write      = framer->read;
+
+			if (frame_body(framer, buffer) == FRAME_ERROR || framer->state == FRAME_DONE) {
+				return framer->state;
+			}
+			break;
+		}
+
+		case FRAME_BODY: {
+			size_t take = len - framer->read;
+			if (take > framer->remaining) {
+				take = framer->remaining;
+			}
+
+			framer->read += take;
+			framer->write = framer->read;
+			framer->remaining -= take;
+
+			if (framer->remaining == 0) {
+				framer->state = FRAME_DONE;
+				return FRAME_DONE;
+			}
+			break;
+		}
+
+		case FRAME_CHUNK_SIZE: {
+			char c = buffer[framer->read++];
+
+			if (c == '\n') {
+				if ((framer->matched & CHUNK_HAS_DIGITS) == 0) {
+					return frame_error(framer, 400);
+				}
+
+				if (framer->remaining == 0) {
+					// last chunk, the \r\n of this line counts for the empty line that closes the trailer
+					framer->matched = 2;
+					framer->state   = FRAME_TRAILER;
+				} else {
+					framer->matched = 0;
+					framer->state   = FRAME_CHUNK_DATA;
+				}
+				break;
+			}
+
+			if ((framer->matched & CHUNK_IN_EXTENSION) != 0 || c == '\r') {
+				break;
+			}
+
+			if (c == ';' || c == ' ' || c == '\t') {
+				framer->matched |= CHUNK_IN_EXTENSION;
+				break;
+			}
+
+			auto digit = hex_value(c);
+			if (digit < 0) {
+				return frame_error(framer, 400);
+			}
+
+			framer->remaining = framer->remaining * 16 + (size_t)(digit);
+			framer->matched |= CHUNK_HAS_DIGITS;
+
+			// checked at every digit, so the size can not overflow
+			if (framer->write - framer->body_start + framer->remaining > framer->max_body) {
+				return frame_error(framer, 413);
+			}
+			break;
+		}
+
+		case FRAME_CHUNK_DATA: {
+			size_t take = len - framer->read;
+			if (take > framer->remaining) {
+				take = framer->remaining;
+			}
+
+			// move the data right after what has already been decoded
+			memmove(buffer + framer->write, buffer + framer->read, take);
+			framer->read += take;
+			framer->write += take;
+			framer->remaining -= take;
+
+			if (framer->remaining == 0) {
+				framer->state = FRAME_CHUNK_CRLF;
+			}
+			break;
+		}
+
+		case FRAME_CHUNK_CRLF: {
+			char c = buffer[framer->read++];
+
+			if (c == '\r') {
+				break;
+			}
+
+			if (c != '\n') {
+				return frame_error(framer, 400);
+			}
+
+			framer->matched = 0;
+			framer->state   = FRAME_CHUNK_SIZE;
+			break;
+		}
+
+		default:
+			return framer->state;
+		}
+	}
+
+	return framer->state;
+}
+
+size_t compact_RequestFramer(RequestFramer *framer, char *buffer, const size_t len) {
+
+	if (framer->write == framer->read) {
+		return len;
+	}
+
+	memmove(buffer + framer->write, buffer + framer->read, len - framer->read);
+
+	auto freed   = framer->read - framer->write;
+	framer->read = framer->write;
+
+	return len - freed;
+}
@@ -0,0 +1,287 @@
+#include "Router.h"
+
+#include "logger.h"
+#include "utils.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+static RouteNode *make_RouteNode(const uint8_t type, const StringRef *label) {
+
+	RouteNode *res = calloc(1, sizeof(RouteNode));
+	TEST_ALLOC(res)
+
+	res->type  = type;
+	res->label = (StringOwn){copy_StringRef(label), label->len};
+
+	return res;
+}
+
+static void destroy_RouteNode(RouteNode *node) {
+
+	if (node == nullptr) {
+		return;
+	}
+
+	for (size_t i = 0; i < node->child_count; ++i) {
+		destroy_RouteNode(node->children[i]);
+	}
+
+	destroy_RouteNode(node->param);
+	destroy_RouteNode(node->wildcard);
+
+	free(node->children);
+	free(node->label.str);
+	free(node);
+}
+
+void destroy_Router(Router *router) {
+
+	for (size_t i = 0; i < HTTP_ENUM_LEN; ++i) {
+		destroy_RouteNode(router->trees[i]);
+		router->trees[i] = nullptr;
+	}
+
+	router->fallback = nullptr;
+}
+
+/**
+ * The static child whose label starts with `c`, there is at most one
+ */
+static RouteNode *find_child(const RouteNode *node, const char c, size_t *index) {
+
+	for (size_t i = 0; i < node->child_count; ++i) {
+		if (node->children[i]->label.str[0] == c) {
+			*index = i;
+			return node->children[i];
+		}
+	}
+
+	return nullptr;
+}
+
+/**
+ * Walk down the static children following `text`, splitting the labels that match only in part
+ *
+ * @return the node where `text` ends
+ */
+static RouteNode *insert_static(RouteNode *node, StringRef text) {
+
+	while (text.len > 0) {
+
+		size_t index;
+		auto   child = find_child(node, text.str[0], &index);
+
+		if (child == nullptr) {
+			child = make_RouteNode(ROUTE_STATIC, &text);
+
+			node->children = realloc(node->children, (node->child_count + 1) * sizeof(RouteNode *));
+			TEST_ALLOC(node->children)
+			node->children[node->child_count++] = child;
+
+			return child;
+		}
+
+		size_t common = 0;
+		while (common < child->label.len && common < text.len && child->label.str[common] == text.str[common]) {
+			++common;
+		}
+
+		if (common < child->label.len) {
+			// the route diverges in the middle of the label, the common part becomes a node of its own
+			StringRef head = {child->label.str, common};
+			auto      mid  = make_RouteNode(ROUTE_STATIC, &head);
+
+			mid->children = malloc(sizeof(RouteNode *));
+			TEST_ALLOC(mid->children)
+			mid->children[0] = child;
+			mid->child_count = 1;
+
+			child->label.len -= common;
+			memmove(child->label.str, child->label.str + common, child->label.len);
+
+			node->children[index] = mid;
+			child                 = mid;
+		}
+
+		text.str += common;
+		text.len -= common;
+		node = child;
+	}
+
+	return node;
+}
+
+/**
+ * The `:param` or `*wildcard` child of the node, created if needed
+ */
+static RouteNode *insert_dynamic(RouteNode *node, const uint8_t type, const StringRef *name) {
+
+	auto slot = type == ROUTE_PARAM ? &node->param : &node->wildcard;
+
+	if (*slot == nullptr) {
+		*slot = make_RouteNode(type, name);
+	} else if (!equal_StringRef(&(StringRef){(*slot)->label.str, (*slot)->label.len}, name)) {
+		// the value is matched by position, the first name given stays
+		llog(LOG_WARNING, "[ROUTER] Parameter '%.*s' is already named '%.*s'\n", (int)name->len, name->str, (int)(*slot)->label.len, (*slot)->label.str);
+	}
+
+	return *slot;
+}
+
+void add_route(Router *router, const uint8_t method, const StringRef *route, const MessageProcessor processor) {
+
+	if (route == nullptr) {
+		router->fallback = processor;
+		return;
+	}
+
+	if (method >= HTTP_ENUM_LEN) {
+		llog(LOG_WARNING, "[ROUTER] Invalid method %u for route '%.*s'\n", method, (int)route->len, route->str);
+		return;
+	}
+
+	if (router->trees[method] == nullptr) {
+		StringRef empty       = {"", 0};
+		router->trees[method] = make_RouteNode(ROUTE_STATIC, &empty);
+	}
+
+	auto      node = router->trees[method];
+	StringRef rest = *route;
+
+	while (rest.len > 0) {
+
+		if (rest.str[0] == ':' || rest.str[0] == '*') {
+			uint8_t type = rest.str[0] == ':' ? ROUTE_PARAM : ROUTE_WILDCARD;
+
+			// a parameter ends at the next segment, a wildcard takes the rest of the route
+			auto      slash = type == ROUTE_PARAM ? strnchr(rest.str, '/', rest.len) : nullptr;
+			size_t    len   = slash == nullptr ? rest.len : (size_t)(slash - rest.str);
+			StringRef name  = {rest.str + 1, len - 1};
+
+			node = insert_dynamic(node, type, &name);
+			rest.str += len;
+			rest.len -= len;
+
+			if (type == ROUTE_WILDCARD) {
+				break;
+			}
+			continue;
+		}
+
+		// the static text goes until the next parameter
+		size_t len = 0;
+		while (len < rest.len && rest.str[len] != ':' && rest.str[len] != '*') {
+			++len;
+		}
+
+		node = insert_static(node, (StringRef){rest.str, len});
+		rest.str += len;
+		rest.len -= len;
+	}
+
+	node->processor = processor;
+}
+
+static void push_param(RouteMatch *match, const RouteNode *node, const StringRef *value) {
+
+	if (match->count < ROUTER_MAX_PARAMS) {
+		match->names[match->count]  = (StringRef){node->label.str, node->label.len};
+		match->values[match->count] = *value;
+	}
+
+	++match->count;
+}
+
+/**
+ * Match the rest of the path from the given node, static children first, then the parameter, then the wildcard
+ * when a branch does not lead to a route the next one is tried, the captured parameters are dropped with it
+ */
+static MessageProcessor lookup_node(const RouteNode *node, const StringRef *path, RouteMatch *match) {
+
+	if (path->len == 0 && node->processor != nullptr) {
+		return node->processor;
+	}
+
+	size_t index;
+	auto   child = path->len == 0 ? nullptr : find_child(node, path->str[0], &index);
+
+	if (child != nullptr && child->label.len <= path->len && memcmp(child->label.str, path->str, child->label.len) == 0) {
+
+		StringRef rest = {path->str + child->label.len, path->len - child->label.len};
+		auto      res  = lookup_node(child, &rest, match);
+
+		if (res != nullptr) {
+			return res;
+		}
+	}
+
+	if (node->param != nullptr && path->len > 0) {
+
+		auto      slash   = strnchr(path->str, '/', path->len);
+		StringRef segment = {path->str, slash == nullptr ? path->len : (size_t)(slash - path->str)};
+
+		if (segment.len > 0) {
+			auto count = match->count;
+			push_param(match, node->param, &segment);
+
+			StringRef rest = {path->str + segment.len, path->len - segment.len};
+			auto      res  = lookup_node(node->param, &rest, match);
+
+			if (res != nullptr) {
+				return res;
+			}
+
+			match->count = count;
+		}
+	}
+
+	if (node->wildcard != nullptr && node->wildcard->processor != nullptr) {
+		push_param(match, node->wildcard, path);
+		return node->wildcard->processor;
+	}
+
+	return nullptr;
+}
+
+/**
+ * Look the url up in a single tree
+ */
+static MessageProcessor lookup_tree(const RouteNode *root, const StringRef *url, RouteMatch *match) {
+
+	match->count = 0;
+
+	if (root == nullptr) {
+		return nullptr;
+	}
+
+	auto res = lookup_node(root, url, match);
+
+	// the parameters over the limit were matched but not captured
+	if (match->count > ROUTER_MAX_PARAMS) {
+		match->count = ROUTER_MAX_PARAMS;
+	}
+
+	return res;
+}
+
+MessageProcessor find_route(const Router *router, const uint8_t method, const StringRef *url, RouteMatch *match) {
+
+	MessageProcessor res = nullptr;
+
+	if (method != HTTP_INVALID_METHOD && method < HTTP_ENUM_LEN) {
+		res = lookup_tree(router->trees[method], url, match);
+	}
+
+	if (res == nullptr) {
+		res = lookup_tree(router->trees[HTTP_INVALID_METHOD], url, match);
+	}
+
+	if (res == nullptr) {
+		match->count = 0;
+		res          = router->fallback;
+	}
+
+	return res;
+}
@@ -7,7 +7,7 @@ bool equal_StringOwn(const StringOwn *lhs, const StringOwn *rhs) {
 		return false;
 	}
 
-	return strncmp(lhs->str, rhs->str, lhs->len);
+	return strncmp(lhs->str, rhs->str, lhs->len) == 0;
 }
 
 bool equal_StringRef(const StringRef *lhs, const StringRef *rhs) {
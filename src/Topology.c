@@ -0,0 +1,177 @@
+#define _GNU_SOURCE // cpu_set_t, pthread affinity
+
+#include "Topology.h"
+
+#include "logger.h"
+
+#include <errno.h>
+#include <sched.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+
+static uint16_t cpu_nodes[TOPOLOGY_MAX_CPUS]; // the node of every cpu id, 0 when sysfs does not say
+static uint16_t cpus[TOPOLOGY_MAX_CPUS];      // the cpus the process can run on, by node then by id
+static size_t   cpu_count = 0;
+static uint16_t nodes[TOPOLOGY_MAX_NODES]; // the nodes with at least one of the cpus, in order
+static size_t   node_count = 0;
+
+/**
+ * Reads a cpu list like "0-3,8-11" and gives its cpus to the node
+ *
+ * @return false if the node does not exist
+ */
+static bool read_node_cpus(const uint16_t node) {
+
+	char path[64];
+	snprintf(path, sizeof(path), "/sys/devices/system/node/node%u/cpulist", node);
+
+	auto file = fopen(path, "r");
+	if (file == nullptr) {
+		return false;
+	}
+
+	unsigned first;
+	while (fscanf(file, "%u", &first) == 1) {
+		unsigned last = first;
+		auto     next = fgetc(file);
+
+		if (next == '-') {
+			if (fscanf(file, "%u", &last) != 1) {
+				break;
+			}
+			next = fgetc(file);
+		}
+
+		for (unsigned cpu = first; cpu <= last && cpu < TOPOLOGY_MAX_CPUS; ++cpu) {
+			cpu_nodes[cpu] = node;
+		}
+
+		if (next != ',') {
+			break;
+		}
+	}
+
+	fclose(file);
+	return true;
+}
+
+void load_topology() {
+
+	cpu_set_t allowed;
+	CPU_ZERO(&allowed);
+
+	if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+		llog(LOG_WARNING, "[TOPOLOGY] Could not get the cpus of the process -> %s\n", strerror(errno));
+		CPU_SET(0, &allowed);
+	}
+
+	memset(cpu_nodes, 0, sizeof(cpu_nodes));
+
+	uint16_t highest = 0;
+	for (uint16_t node = 0; node < TOPOLOGY_MAX_NODES; ++node) {
+		if (read_node_cpus(node)) {
+			highest = node;
+		}
+	}
+
+	cpu_count  = 0;
+	node_count = 0;
+
+	for (uint16_t node = 0; node <= highest; ++node) {
+		auto before = cpu_count;
+
+		for (uint16_t cpu = 0; cpu < TOPOLOGY_MAX_CPUS && cpu < CPU_SETSIZE; ++cpu) {
+			if (cpu_nodes[cpu] == node && CPU_ISSET(cpu, &allowed)) {
+				cpus[cpu_count++] = cpu;
+			}
+		}
+
+		if (cpu_count > before) {
+			nodes[node_count++] = node;
+		}
+	}
+
+	llog(LOG_INFO, "[TOPOLOGY] %zu cpus on %zu numa nodes\n", cpu_count, node_count);
+}
+
+size_t topology_node_count() {
+	return node_count;
+}
+
+int topology_cpu(const size_t worker) {
+	return cpu_count == 0 ? -1 : cpus[worker % cpu_count];
+}
+
+/**
+ * Adds to the set the cpus of the node the process can run on
+ */
+static void node_cpus(const uint16_t node, cpu_set_t *set) {
+
+	CPU_ZERO(set);
+
+	for (size_t i = 0; i < cpu_count; ++i) {
+		if (cpu_nodes[cpus[i]] == node) {
+			CPU_SET(cpus[i], set);
+		}
+	}
+}
+
+uint16_t set_worker_affinity(const uint8_t mode, const size_t worker, pthread_attr_t *attr) {
+
+	if (mode == AFFINITY_NONE || cpu_count == 0) {
+		return NODE_ANY;
+	}
+
+	cpu_set_t set;
+	uint16_t  node;
+
+	if (mode == AFFINITY_CORE) {
+		auto cpu = (uint16_t)(topology_cpu(worker));
+		node     = cpu_nodes[cpu];
+
+		CPU_ZERO(&set);
+		CPU_SET(cpu, &set);
+	} else {
+		node = nodes[worker % node_count];
+		node_cpus(node, &set);
+	}
+
+	auto err = pthread_attr_setaffinity_np(attr, sizeof(set), &set);
+	if (err != 0) {
+		llog(LOG_WARNING, "[TOPOLOGY] Could not pin worker %zu -> %s\n", worker, strerror(err));
+		return NODE_ANY;
+	}
+
+	return node;
+}
+
+bool pin_to_node(const uint16_t node) {
+
+	cpu_set_t set;
+	node_cpus(node, &set);
+
+	if (CPU_COUNT(&set) == 0) {
+		return false;
+	}
+
+	auto err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+	if (err != 0) {
+		llog(LOG_WARNING, "[TOPOLOGY] Could not pin the thread on node %u -> %s\n", node, strerror(err));
+		return false;
+	}
+
+	return true;
+}
+
+uint16_t socket_node(const Socket socket) {
+
+	int       cpu = -1;
+	socklen_t len = sizeof(cpu);
+
+	if (getsockopt(socket, SOL_SOCKET, SO_INCOMING_CPU, &cpu, &len) != 0 || cpu < 0 || (size_t)(cpu) >= TOPOLOGY_MAX_CPUS) {
+		return NODE_ANY;
+	}
+
+	return cpu_nodes[cpu];
+}
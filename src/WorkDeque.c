@@ -0,0 +1,116 @@
+#include "WorkDeque.h"
+
+#include "logger.h"
+#include "utils.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+constexpr ptrdiff_t DEQUE_MASK = (ptrdiff_t)(WORK_DEQUE_CAPACITY) - 1;
+
+static_assert((WORK_DEQUE_CAPACITY & (WORK_DEQUE_CAPACITY - 1)) == 0, "the deque capacity must be a power of two");
+
+// Lê, Pop, Cohen, Zappa Nardelli, "Correct and Efficient Work-Stealing for Weak Memory Models"
+
+void make_WorkDeque(WorkDeque *res) {
+
+	res->slots = malloc(WORK_DEQUE_CAPACITY * sizeof(TaskSlot));
+	TEST_ALLOC(res->slots)
+	atomic_init(&res->top, 0);
+	atomic_init(&res->bottom, 0);
+}
+
+void destroy_WorkDeque(WorkDeque *deque) {
+
+	free(deque->slots);
+	deque->slots = nullptr;
+}
+
+static size_t count_WorkDeque(WorkDeque *deque) {
+
+	auto bottom = atomic_load_explicit(&deque->bottom, memory_order_relaxed);
+	auto top    = atomic_load_explicit(&deque->top, memory_order_relaxed);
+
+	return bottom > top ? (size_t)(bottom - top) : 0;
+}
+
+bool push_WorkDeque(WorkDeque *deque, const Task *task) {
+
+	auto bottom = atomic_load_explicit(&deque->bottom, memory_order_relaxed);
+	auto top    = atomic_load_explicit(&deque->top, memory_order_acquire);
+
+	if (bottom - top > DEQUE_MASK) {
+		return false;
+	}
+
+	auto slot = &deque->slots[bottom & DEQUE_MASK];
+	atomic_store_explicit(&slot->run, task->run, memory_order_relaxed);
+	atomic_store_explicit(&slot->arg, task->arg, memory_order_relaxed);
+
+	// the slot is written before the thieves can see it
+	atomic_thread_fence(memory_order_release);
+	atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+
+	return true;
+}
+
+bool pop_WorkDeque(WorkDeque *deque, Task *task) {
+
+	// only the owner moves the bottom and the top only grows, an empty deque is seen without the fence
+	if (atomic_load_explicit(&deque->top, memory_order_relaxed) >= atomic_load_explicit(&deque->bottom, memory_order_relaxed)) {
+		return false;
+	}
+
+	auto bottom = atomic_load_explicit(&deque->bottom, memory_order_relaxed) - 1;
+
+	// take the slot before looking at the thieves, one of them may be taking it too
+	atomic_store_explicit(&deque->bottom, bottom, memory_order_relaxed);
+	atomic_thread_fence(memory_order_seq_cst);
+
+	auto top = atomic_load_explicit(&deque->top, memory_order_relaxed);
+
+	if (top > bottom) {
+		// empty
+		atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+		return false;
+	}
+
+	auto slot = &deque->slots[bottom & DEQUE_MASK];
+	task->run = atomic_load_explicit(&slot->run, memory_order_relaxed);
+	task->arg = atomic_load_explicit(&slot->arg, memory_order_relaxed);
+
+	if (top < bottom) {
+		// more than one task, no thief can reach this one
+		return true;
+	}
+
+	// the last task, the owner races with the thieves for it
+	auto won = atomic_compare_exchange_strong_explicit(&deque->top, &top, top + 1, memory_order_seq_cst, memory_order_relaxed);
+	atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+
+	return won;
+}
+
+bool steal_WorkDeque(WorkDeque *deque, Task *task) {
+
+	// most victims have nothing to steal, do not pay the fence for them
+	if (count_WorkDeque(deque) == 0) {
+		return false;
+	}
+
+	auto top = atomic_load_explicit(&deque->top, memory_order_acquire);
+	atomic_thread_fence(memory_order_seq_cst);
+	auto bottom = atomic_load_explicit(&deque->bottom, memory_order_acquire);
+
+	if (top >= bottom) {
+		return false;
+	}
+
+	auto slot = &deque->slots[top & DEQUE_MASK];
+	task->run = atomic_load_explicit(&slot->run, memory_order_relaxed);
+	task->arg = atomic_load_explicit(&slot->arg, memory_order_relaxed);
+
+	// the owner or another thief took it first, what was read may be a newer task, drop it
+	return atomic_compare_exchange_strong_explicit(&deque->top, &top, top + 1, memory_order_seq_cst, memory_order_relaxed);
+}
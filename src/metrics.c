@@ -0,0 +1,81 @@
+#include "metrics.h"
+
+#include "logger.h"
+
+#include <inttypes.h>
+
+void initialize_metrics(Metrics *metrics) {
+
+	atomic_init(&metrics->handshakes_completed, 0);
+	atomic_init(&metrics->handshakes_failed, 0);
+	atomic_init(&metrics->handshake_total_ns, 0);
+	atomic_init(&metrics->handshake_work_ns, 0);
+	atomic_init(&metrics->handshake_max_ns, 0);
+	atomic_init(&metrics->idle_timeouts, 0);
+	atomic_init(&metrics->pool_threads, 0);
+	atomic_init(&metrics->pool_threads_peak, 0);
+	atomic_init(&metrics->pool_wait_ns, 0);
+}
+
+void record_handshake(Metrics *metrics, const uint64_t total_ns, const uint64_t work_ns, const bool success) {
+
+	if (!success) {
+		atomic_fetch_add_explicit(&metrics->handshakes_failed, 1, memory_order_relaxed);
+		return;
+	}
+
+	atomic_fetch_add_explicit(&metrics->handshakes_completed, 1, memory_order_relaxed);
+	atomic_fetch_add_explicit(&metrics->handshake_total_ns, total_ns, memory_order_relaxed);
+	atomic_fetch_add_explicit(&metrics->handshake_work_ns, work_ns, memory_order_relaxed);
+
+	// another thread might have put a bigger value in the meantime, just retry
+	uint_fast64_t max = atomic_load_explicit(&metrics->handshake_max_ns, memory_order_relaxed);
+	while (total_ns > max && !atomic_compare_exchange_weak_explicit(&metrics->handshake_max_ns, &max, total_ns, memory_order_relaxed, memory_order_relaxed)) {
+	}
+}
+
+void record_pool(Metrics *metrics, const uint64_t threads, const uint64_t wait_ns) {
+
+	atomic_store_explicit(&metrics->pool_threads, threads, memory_order_relaxed);
+	atomic_store_explicit(&metrics->pool_wait_ns, wait_ns, memory_order_relaxed);
+
+	// only the event loop records the pool, no one else can change the peak
+	if (threads > atomic_load_explicit(&metrics->pool_threads_peak, memory_order_relaxed)) {
+		atomic_store_explicit(&metrics->pool_threads_peak, threads, memory_order_relaxed);
+	}
+}
+
+void merge_metrics(Metrics *metrics, const Metrics *shard) {
+
+	atomic_fetch_add_explicit(&metrics->handshakes_completed, atomic_load_explicit(&shard->handshakes_completed, memory_order_relaxed), memory_order_relaxed);
+	atomic_fetch_add_explicit(&metrics->handshakes_failed, atomic_load_explicit(&shard->handshakes_failed, memory_order_relaxed), memory_order_relaxed);
+	atomic_fetch_add_explicit(&metrics->handshake_total_ns, atomic_load_explicit(&shard->handshake_total_ns, memory_order_relaxed), memory_order_relaxed);
+	atomic_fetch_add_explicit(&metrics->handshake_work_ns, atomic_load_explicit(&shard->handshake_work_ns, memory_order_relaxed), memory_order_relaxed);
+	atomic_fetch_add_explicit(&metrics->idle_timeouts, atomic_load_explicit(&shard->idle_timeouts, memory_order_relaxed), memory_order_relaxed);
+
+	uint64_t max = atomic_load_explicit(&shard->handshake_max_ns, memory_order_relaxed);
+	if (max > atomic_load_explicit(&metrics->handshake_max_ns, memory_order_relaxed)) {
+		atomic_store_explicit(&metrics->handshake_max_ns, max, memory_order_relaxed);
+	}
+}
+
+void log_metrics(const Metrics *metrics) {
+
+	uint64_t completed = atomic_load_explicit(&metrics->handshakes_completed, memory_order_relaxed);
+	uint64_t failed    = atomic_load_explicit(&metrics->handshakes_failed, memory_order_relaxed);
+	uint64_t total_ns  = atomic_load_explicit(&metrics->handshake_total_ns, memory_order_relaxed);
+	uint64_t work_ns   = atomic_load_explicit(&metrics->handshake_work_ns, memory_order_relaxed);
+	uint64_t max_ns    = atomic_load_explicit(&metrics->handshake_max_ns, memory_order_relaxed);
+	uint64_t timeouts  = atomic_load_explicit(&metrics->idle_timeouts, memory_order_relaxed);
+	uint64_t threads   = atomic_load_explicit(&metrics->pool_threads, memory_order_relaxed);
+	uint64_t peak      = atomic_load_explicit(&metrics->pool_threads_peak, memory_order_relaxed);
+	uint64_t wait_ns   = atomic_load_explicit(&metrics->pool_wait_ns, memory_order_relaxed);
+
+	// avoid dividing by zero
+	uint64_t divisor = completed == 0 ? 1 : completed;
+
+	llog(LOG_INFO, "[METRICS] Handshakes: %" PRIu64 " completed, %" PRIu64 " failed\n", completed, failed);
+	llog(LOG_INFO, "[METRICS] Handshake latency: avg %" PRIu64 " us, max %" PRIu64 " us. Handshake work: avg %" PRIu64 " us\n", total_ns / divisor / 1000, max_ns / 1000, work_ns / divisor / 1000);
+	llog(LOG_INFO, "[METRICS] Connections closed for idleness: %" PRIu64 "\n", timeouts);
+	llog(LOG_INFO, "[METRICS] Worker threads: %" PRIu64 " now, %" PRIu64 " at most. Last wait for a thread: avg %" PRIu64 " us\n", threads, peak, wait_ns / 1000);
+}
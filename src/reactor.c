@@ -0,0 +1,245 @@
+#define _GNU_SOURCE // accept4
+
+#include "reactor.h"
+
+#include "logger.h"
+#include "utils.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+bool initialize_reactor(const Socket server_socket, const uint64_t idle_timeout_ns, Reactor *res) {
+
+	res->server_socket   = server_socket;
+	res->idle_timeout_ns = idle_timeout_ns;
+	res->returned        = nullptr;
+	res->idle_head       = nullptr;
+	res->idle_tail       = nullptr;
+	res->local           = false;
+	res->wake_fd         = -1;
+	res->epoll_fd        = epoll_create1(EPOLL_CLOEXEC);
+
+	pthread_mutex_init(&res->returned_mutex, nullptr);
+
+	if (res->epoll_fd == -1) {
+		llog(LOG_ERROR, "[REACTOR] Could not create the epoll instance -> %s\n", strerror(errno));
+		return false;
+	}
+
+	// the listening socket must not block, accept is called until it has no more clients
+	auto flags = fcntl(server_socket, F_GETFL, 0);
+	if (flags == -1 || fcntl(server_socket, F_SETFL, flags | O_NONBLOCK) == -1) {
+		llog(LOG_ERROR, "[REACTOR] Could not set the server socket to non-blocking -> %s\n", strerror(errno));
+		destroy_reactor(res);
+		return false;
+	}
+
+	struct epoll_event ev = {
+	    .events = EPOLLIN | EPOLLET,
+	    .data   = {.ptr = nullptr},
+	};
+
+	if (epoll_ctl(res->epoll_fd, EPOLL_CTL_ADD, server_socket, &ev) == -1) {
+		llog(LOG_ERROR, "[REACTOR] Could not register the server socket -> %s\n", strerror(errno));
+		destroy_reactor(res);
+		return false;
+	}
+
+	res->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	ev.data.ptr  = &res->wake_fd;
+
+	if (res->wake_fd == -1 || epoll_ctl(res->epoll_fd, EPOLL_CTL_ADD, res->wake_fd, &ev) == -1) {
+		llog(LOG_ERROR, "[REACTOR] Could not register the wake eventfd -> %s\n", strerror(errno));
+		destroy_reactor(res);
+		return false;
+	}
+
+	return true;
+}
+
+void destroy_reactor(Reactor *reactor) {
+
+	// give back what the workers returned in the meantime, then close everything that is still waiting on a client
+	if (reactor->wake_fd != -1) {
+		reactor_collect_returned(reactor);
+	}
+
+	while (reactor->idle_head != nullptr) {
+		auto conn = reactor->idle_head;
+		reactor_claim(reactor, conn);
+		destroy_Connection(conn);
+	}
+
+	if (reactor->wake_fd != -1) {
+		close(reactor->wake_fd);
+	}
+
+	if (reactor->epoll_fd != -1) {
+		close(reactor->epoll_fd);
+	}
+
+	pthread_mutex_destroy(&reactor->returned_mutex);
+
+	reactor->wake_fd  = -1;
+	reactor->epoll_fd = -1;
+}
+
+Socket reactor_accept(const Reactor *reactor) {
+
+	Socket client = accept4(reactor->server_socket, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+
+	if (client == -1) {
+		// EAGAIN means that every pending client was accepted, anything else is worth noticing
+		if (errno != EAGAIN && errno != EWOULDBLOCK) {
+			llog(LOG_WARNING, "[REACTOR] Could not accept client -> %s\n", strerror(errno));
+		}
+		return INVALID_SOCKET;
+	}
+
+	return client;
+}
+
+/**
+ * Append the connection at the end of the idle list, the list is ordered by deadline since the timeout is the same for everyone
+ */
+static void idle_append(Reactor *reactor, Connection *conn) {
+
+	conn->idle_deadline_ns = get_monotonic_ns() + reactor->idle_timeout_ns;
+	conn->next             = nullptr;
+	conn->prev             = reactor->idle_tail;
+
+	if (reactor->idle_tail == nullptr) {
+		reactor->idle_head = conn;
+	} else {
+		reactor->idle_tail->next = conn;
+	}
+
+	reactor->idle_tail = conn;
+}
+
+/**
+ * Add or modify the given connection in the epoll set
+ */
+static bool reactor_ctl(const Reactor *reactor, const int op, Connection *conn, const uint32_t events) {
+
+	struct epoll_event ev = {
+	    .events = events | EPOLLET | EPOLLONESHOT | EPOLLRDHUP,
+	    .data   = {.ptr = conn},
+	};
+
+	if (epoll_ctl(reactor->epoll_fd, op, conn->client_socket, &ev) == -1) {
+		llog(LOG_ERROR, "[REACTOR] Could not register socket %d -> %s\n", conn->client_socket, strerror(errno));
+		return false;
+	}
+
+	return true;
+}
+
+bool reactor_watch(Reactor *reactor, Connection *conn, const uint32_t events) {
+
+	if (!reactor_ctl(reactor, EPOLL_CTL_ADD, conn, events)) {
+		return false;
+	}
+
+	idle_append(reactor, conn);
+	return true;
+}
+
+/**
+ * Wait for the events of a returned connection again, or destroy it if it can not be waited on
+ */
+static void reactor_rearm(Reactor *reactor, Connection *conn) {
+
+	if (reactor_ctl(reactor, EPOLL_CTL_MOD, conn, conn->rearm_events)) {
+		idle_append(reactor, conn);
+	} else {
+		destroy_Connection(conn);
+	}
+}
+
+void reactor_return(Reactor *reactor, Connection *conn, const uint32_t events) {
+
+	conn->rearm_events = events;
+
+	if (reactor->local) {
+		reactor_rearm(reactor, conn);
+		return;
+	}
+
+	pthread_mutex_lock(&reactor->returned_mutex);
+
+	conn->next        = reactor->returned;
+	reactor->returned = conn;
+	bool was_empty    = conn->next == nullptr;
+
+	pthread_mutex_unlock(&reactor->returned_mutex);
+
+	// the reactor drains the whole stack at once, only the first one needs to wake it
+	if (was_empty) {
+		uint64_t one = 1;
+		if (write(reactor->wake_fd, &one, sizeof(one)) == -1 && errno != EAGAIN) {
+			llog(LOG_ERROR, "[REACTOR] Could not wake the reactor -> %s\n", strerror(errno));
+		}
+	}
+}
+
+void reactor_collect_returned(Reactor *reactor) {
+
+	uint64_t count;
+	if (read(reactor->wake_fd, &count, sizeof(count)) == -1 && errno != EAGAIN) {
+		llog(LOG_ERROR, "[REACTOR] Could not read the wake eventfd -> %s\n", strerror(errno));
+	}
+
+	pthread_mutex_lock(&reactor->returned_mutex);
+
+	auto conn         = reactor->returned;
+	reactor->returned = nullptr;
+
+	pthread_mutex_unlock(&reactor->returned_mutex);
+
+	while (conn != nullptr) {
+		auto next = conn->next;
+		reactor_rearm(reactor, conn);
+		conn = next;
+	}
+}
+
+void reactor_claim(Reactor *reactor, Connection *conn) {
+
+	if (conn->prev == nullptr) {
+		reactor->idle_head = conn->next;
+	} else {
+		conn->prev->next = conn->next;
+	}
+
+	if (conn->next == nullptr) {
+		reactor->idle_tail = conn->prev;
+	} else {
+		conn->next->prev = conn->prev;
+	}
+
+	conn->prev = nullptr;
+	conn->next = nullptr;
+}
+
+size_t reactor_expire(Reactor *reactor, const uint64_t now_ns) {
+
+	size_t expired = 0;
+
+	while (reactor->idle_head != nullptr && reactor->idle_head->idle_deadline_ns <= now_ns) {
+		auto conn = reactor->idle_head;
+
+		llog(LOG_DEBUG, "[REACTOR] Socket %d timed out\n", conn->client_socket);
+
+		reactor_claim(reactor, conn);
+		destroy_Connection(conn);
+		++expired;
+	}
+
+	return expired;
+}
@@ -0,0 +1,212 @@
+#include "scan.h"
+
+#include "utils.h"
+
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#	define SCAN_X86
+#	include <immintrin.h>
+#endif
+
+/**
+ * A kernel looks at SCAN_BLOCK bytes and returns a mask with a bit set for every byte equal to `a` or `b`
+ * the block must be entirely readable
+ */
+typedef uint32_t (*MatchBlock)(const char *block, const char a, const char b);
+
+static uint32_t match_block_scalar(const char *block, const char a, const char b) {
+	uint32_t mask = 0;
+
+	for (size_t i = 0; i < SCAN_BLOCK; ++i) {
+		if (block[i] == a || block[i] == b) {
+			mask |= 1u << i;
+		}
+	}
+
+	return mask;
+}
+
+#ifdef SCAN_X86
+
+__attribute__((target("sse2"))) static uint32_t match_block_sse2(const char *block, const char a, const char b) {
+	auto va = _mm_set1_epi8(a);
+	auto vb = _mm_set1_epi8(b);
+
+	auto lo = _mm_loadu_si128((const __m128i *)(block));
+	auto hi = _mm_loadu_si128((const __m128i *)(block + 16));
+
+	auto mask_lo = (uint32_t)(_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(lo, va), _mm_cmpeq_epi8(lo, vb))));
+	auto mask_hi = (uint32_t)(_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(hi, va), _mm_cmpeq_epi8(hi, vb))));
+
+	return mask_lo | mask_hi << 16;
+}
+
+__attribute__((target("avx2"))) static uint32_t match_block_avx2(const char *block, const char a, const char b) {
+	auto data = _mm256_loadu_si256((const __m256i *)(block));
+	auto eq   = _mm256_or_si256(_mm256_cmpeq_epi8(data, _mm256_set1_epi8(a)), _mm256_cmpeq_epi8(data, _mm256_set1_epi8(b)));
+
+	return (uint32_t)(_mm256_movemask_epi8(eq));
+}
+
+#endif
+
+static MatchBlock  match_block = match_block_scalar;
+static const char *kernel_name = "scalar";
+
+/**
+ * Choose the widest kernel the cpu supports, before main so no thread can see it change
+ */
+__attribute__((constructor)) static void select_kernel() {
+#ifdef SCAN_X86
+	__builtin_cpu_init();
+
+	if (__builtin_cpu_supports("avx2")) {
+		match_block = match_block_avx2;
+		kernel_name = "avx2";
+	} else if (__builtin_cpu_supports("sse2")) {
+		match_block = match_block_sse2;
+		kernel_name = "sse2";
+	}
+#endif
+}
+
+const char *scan_kernel_name() {
+	return kernel_name;
+}
+
+const char *scan_chr(const char *str, const char chr, const size_t count) {
+
+	size_t i = 0;
+
+	for (; i + SCAN_BLOCK <= count; i += SCAN_BLOCK) {
+		auto mask = match_block(str + i, chr, chr);
+
+		if (mask != 0) {
+			return str + i + (size_t)(__builtin_ctz(mask));
+		}
+	}
+
+	// a block would read past the end, the last bytes are checked one by one
+	for (; i < count; ++i) {
+		if (str[i] == chr) {
+			return str + i;
+		}
+	}
+
+	return nullptr;
+}
+
+const char *scan_str(const char *haystack, const char *needle, const size_t needle_len, const size_t count) {
+
+	if (needle_len == 0 || needle_len > count) {
+		return nullptr;
+	}
+
+	auto first = needle[0];
+	auto last  = needle[needle_len - 1];
+
+	// how many positions the needle can start at
+	auto limit = count - needle_len + 1;
+
+	size_t i = 0;
+
+	for (; i + SCAN_BLOCK <= limit; i += SCAN_BLOCK) {
+		// the bit of a position is set only if both the first and the last char of the needle are where they should be
+		auto mask = match_block(haystack + i, first, first) & match_block(haystack + i + needle_len - 1, last, last);
+
+		while (mask != 0) {
+			auto candidate = haystack + i + (size_t)(__builtin_ctz(mask));
+
+			if (memcmp(candidate, needle, needle_len) == 0) {
+				return candidate;
+			}
+
+			mask &= mask - 1;
+		}
+	}
+
+	for (; i < limit; ++i) {
+		if (haystack[i] == first && memcmp(haystack + i, needle, needle_len) == 0) {
+			return haystack + i;
+		}
+	}
+
+	return nullptr;
+}
+
+size_t tokenize_header(const StringRef *header, StringRef *request_line, HeaderField *fields, const size_t max_fields) {
+
+	constexpr size_t NO_COLON = (size_t)(-1);
+
+	const char *str        = header->str;
+	size_t      count      = 0;
+	size_t      line_start = 0;
+	size_t      colon      = NO_COLON;
+	bool        first_line = true;
+
+	*request_line = (StringRef){str, header->len};
+
+	// i == header->len is the end of the last line, that has no \r\n
+	for (size_t block = 0; block <= header->len; block += SCAN_BLOCK) {
+
+		uint32_t mask;
+
+		if (block + SCAN_BLOCK <= header->len) {
+			mask = match_block(str + block, '\n', ':');
+		} else {
+			// the last bytes are copied in a zeroed block, so the kernel can read it entirely
+			char tail[SCAN_BLOCK];
+			memset(tail, 0, sizeof(tail));
+			if (header->len > block) {
+				memcpy(tail, str + block, header->len - block);
+			}
+			mask = match_block(tail, '\n', ':');
+
+			// a fake '\n' right after the end closes the last line
+			mask |= 1u << (header->len - block);
+		}
+
+		while (mask != 0) {
+			auto i = block + (size_t)(__builtin_ctz(mask));
+			mask &= mask - 1;
+
+			if (i < header->len && str[i] == ':') {
+				// only the first ':' separates the name, the value can contain others. The request line has none
+				if (colon == NO_COLON && !first_line) {
+					colon = i;
+				}
+				continue;
+			}
+
+			// without the \r of the \r\n
+			auto line_end = i;
+			if (line_end > line_start && str[line_end - 1] == '\r') {
+				--line_end;
+			}
+
+			if (first_line) {
+				*request_line = (StringRef){str + line_start, line_end - line_start};
+				first_line    = false;
+
+			} else if (line_end > line_start && count < max_fields) {
+				if (colon == NO_COLON) {
+					fields[count].name  = (StringRef){str + line_start, line_end - line_start};
+					fields[count].value = (StringRef){nullptr, 0};
+				} else {
+					StringRef name  = {str + line_start, colon - line_start};
+					StringRef value = {str + colon + 1, line_end - colon - 1};
+
+					fields[count].name  = trim(&name);
+					fields[count].value = trim(&value);
+				}
+				++count;
+			}
+
+			line_start = i + 1;
+			colon      = NO_COLON;
+		}
+	}
+
+	return count;
+}
@@ -1,18 +1,36 @@
 #include "server.h"
 
+#include "Arena.h"
+#include "AssetCache.h"
+#include "BodyWriter.h"
+#include "DateCache.h"
+#include "Encoding.h"
+#include "Fiber.h"
+#include "FileServer.h"
 #include "HttpMessage.h"
-#include "ResolverData.h"
+#include "RequestFramer.h"
+#include "Router.h"
 #include "StringRef.h"
+#include "constants.h"
 #include "logger.h"
+#include "scan.h"
 #include "threadpool.h"
+#include "utils.h"
 
 #include <errno.h>
-#include <poll.h>
+#include <linux/filter.h>
+#include <netinet/in.h>
+#include <openssl/err.h>
+#include <openssl/ssl.h>
 #include <pthread.h>
 #include <sslConn.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
 #include <sys/types.h>
 #include <tcpConn.h>
+#include <unistd.h>
 
 // only for logging purposes
 const char *method_str[] = {
@@ -28,6 +46,27 @@ const char *method_str[] = {
     "PATCH",
 };
 
+// every thread resolving requests allocates everything about a request in its own arena, reset once the response is sent
+static thread_local Arena request_arena;
+
+/**
+ * The arena of the request being resolved, a fiber has its own since other requests are resolved on the thread while it waits
+ */
+static Arena *current_arena() {
+
+	auto fiber = current_fiber();
+	return fiber == nullptr ? &request_arena : &fiber->arena;
+}
+
+/**
+ * Frees what the thread kept between the requests it resolved
+ */
+static void release_request_state() {
+	destroy_Arena(&request_arena);
+	release_encoders();
+	release_body_stream();
+}
+
 void SIGPIPE_handler(int os) {
 	llog(LOG_FATAL, "[SIGPIPE] Received a sigpipe %d\n", os);
 }
@@ -44,24 +83,84 @@ void *proxy_acc_req(void *ptr) {
 #endif
 }
 
+/**
+ * How long a thread can sleep before the first of its fibers times out
+ *
+ * @return -1 if no fiber is waiting
+ */
+static int fiber_timeout_ms() {
+
+	auto deadline = next_fiber_deadline();
+
+	if (deadline == 0) {
+		return -1;
+	}
+
+	auto now = get_monotonic_ns();
+
+	// rounded up, so the thread does not wake up right before the deadline
+	return deadline <= now ? 0 : (int)((deadline - now + 999999) / 1000000);
+}
+
 #ifndef NO_THREADING
 [[noreturn]]
 #endif
 void *proxy_res_req(void *ptr) {
-	ThreadPool *pool = (ThreadPool *)(ptr);
+	RuntimeInfo *rti  = (RuntimeInfo *)(ptr);
+	ThreadPool  *pool = &rti->thread_pool;
 
-	while (!pool->stop) {
-		auto data = dequeue_threadpool(pool);
+	// the connections of the thread wait on their clients in fibers, in its own epoll instance, so they are always resumed here
+	auto epoll_fd = epoll_create1(EPOLL_CLOEXEC);
 
-		// dequeue might return a null value for how it is implemented, i deal with that
-		if (data.ssl == nullptr) {
-			llog(LOG_DEBUG, "[THREAD] DEQUEUE return null. Probably the threadpool is commiting fake data to kill all threads\n");
-			continue;
+	if (epoll_fd >= 0 && set_threadpool_poll(pool, epoll_fd)) {
+		set_fiber_loop(epoll_fd);
+	} else {
+		llog(LOG_ERROR, "[THREAD] No epoll instance for the fibers, the thread serves one connection at a time\n");
+	}
+
+	struct epoll_event events[THREADPOOL_POLL_EVENTS];
+
+	while (true) {
+		Task task;
+		auto count = poll_threadpool(pool, fiber_timeout_ms(), &task, events);
+
+		// the pool is stopping, or it has more threads than it needs and the fibers of this one are done
+		if (count < 0) {
+			llog(LOG_DEBUG, "[THREAD] DEQUEUE return null, the thread leaves the pool\n");
+			break;
 		}
 
-		resolve_request(data.ssl, data.client_socket);
+		// the clients some fibers were waiting on
+		for (int i = 0; i < count; ++i) {
+			Connection *conn = events[i].data.ptr;
+
+			if (conn->fiber != nullptr) {
+				resume_fiber(conn->fiber, true);
+			}
+		}
+
+		// a fiber gives up on a client after CONNECTION_IO_TIMEOUT_MS
+		if (next_fiber_deadline() != 0) {
+			expire_fibers(get_monotonic_ns());
+		}
+
+		if (task.run != nullptr) {
+			task.run(rti, task.arg);
+		}
+	}
+
+	// a retiring thread left once its fibers were done, only the stop of the pool leaves some waiting on their clients
+	if (pool->stop) {
+		cancel_fibers();
+	}
+	release_fibers();
+
+	if (epoll_fd >= 0) {
+		close(epoll_fd);
 	}
 
+	release_request_state();
+
 #ifdef NO_THREADING
 	return nullptr;
 #else
@@ -69,104 +168,673 @@ void *proxy_res_req(void *ptr) {
 #endif
 }
 
+/**
+ * The fiber of a connection, it waits on the client in the loop of its thread instead of blocking it
+ */
+static void serve_fiber(void *rti, void *conn) {
+	serve_connection(rti, conn);
+}
+
+#ifndef NO_THREADING
+/**
+ * The task of a connection that the reactor found ready
+ */
+static void serve_task(void *rti, void *ptr) {
+	Connection *conn = ptr;
+
+	// its buffer is allocated by the first worker, the connection stays on the node of that worker
+	if (conn->node == NODE_ANY) {
+		conn->node = threadpool_current_node();
+	}
+
+	// the worker takes the next task while this connection waits on its client
+	if (!run_fiber(serve_fiber, rti, conn)) {
+		serve_connection(rti, conn);
+	}
+}
+#endif
+
+/**
+ * A connection task that did not run before the pool stopped
+ */
+static void discard_task(void *, void *conn) {
+	destroy_Connection(conn);
+}
+
+/**
+ * If the event loop resolves the requests itself, the only thread without threading or a shard
+ */
+static bool serves_inline([[maybe_unused]] const RuntimeInfo *rti) {
+#ifdef NO_THREADING
+	return true;
+#else
+	return rti->shard;
+#endif
+}
+
+/**
+ * Give a connection that the reactor found ready to a worker, or to a fiber of the loop when it serves its connections itself
+ *
+ * @param rti the runtime info holding the thread pool
+ * @param conn the connection to serve, from now on is owned by the worker
+ */
+void dispatch_connection(RuntimeInfo *rti, Connection *conn) {
+
+	llog(LOG_DEBUG, "[SERVER] Launched request resolver for socket %d\n", conn->client_socket);
+
+	// a shard keeps its connections on its own thread, from the accept to the close
+	if (serves_inline(rti)) {
+
+		// without a stack for the fiber the loop serves it right away, the other connections wait meanwhile
+		if (!run_fiber(serve_fiber, rti, conn)) {
+			serve_connection(rti, conn);
+		}
+
+		return;
+	}
+
+#ifndef NO_THREADING
+	Task task = {serve_task, conn, 0};
+
+	if (!enqueue_threadpool_on(&rti->thread_pool, &task, conn->node)) {
+		destroy_Connection(conn);
+	}
+#endif
+}
+
+bool advance_handshake(RuntimeInfo *rti, Connection *conn) {
+
+	// the first time a worker sees the connection, create the ssl connection on it
+	if (conn->ssl == nullptr) {
+		conn->ssl = SSL_create_connection(rti->ssl_context, conn->client_socket);
+
+		if (conn->ssl == nullptr) {
+			record_handshake(&rti->metrics, 0, 0, false);
+			destroy_Connection(conn);
+			return false;
+		}
+	}
+
+	auto start = get_monotonic_ns();
+
+	ERR_clear_error();
+	auto res = SSL_accept(conn->ssl);
+
+	auto end = get_monotonic_ns();
+	conn->handshake_work_ns += end - start;
+
+	if (res == 1) {
+		conn->state = CONN_READY;
+		record_handshake(&rti->metrics, end - conn->accept_time_ns, conn->handshake_work_ns, true);
+
+		// the request might have arrived together with the end of the handshake
+		if (SSL_has_pending(conn->ssl)) {
+			return true;
+		}
+
+		// once returned the reactor might give it to another worker, don't touch it anymore
+		reactor_return(&rti->reactor, conn, EPOLLIN);
+		return false;
+	}
+
+	switch (SSL_get_error(conn->ssl, res)) {
+	case SSL_ERROR_WANT_READ:
+		reactor_return(&rti->reactor, conn, EPOLLIN);
+		break;
+	case SSL_ERROR_WANT_WRITE:
+		reactor_return(&rti->reactor, conn, EPOLLOUT);
+		break;
+	default:
+		llog(LOG_WARNING, "[SSL] Handshake failed on socket %d\n", conn->client_socket);
+		record_handshake(&rti->metrics, end - conn->accept_time_ns, conn->handshake_work_ns, false);
+		destroy_Connection(conn);
+		break;
+	}
+
+	return false;
+}
+
+void serve_connection(RuntimeInfo *rti, Connection *conn) {
+
+	if (conn->state == CONN_HANDSHAKE && !advance_handshake(rti, conn)) {
+		// the connection went back to the reactor or was destroyed, it is not ours anymore
+		return;
+	}
+
+	// pipelined requests are resolved right away, otherwise the connection waits for the next one in the reactor
+	do {
+		if (!resolve_request(rti, conn)) {
+			destroy_Connection(conn);
+			return;
+		}
+	} while (conn->buffer_len > 0 || SSL_has_pending(conn->ssl));
+
+	reactor_return(&rti->reactor, conn, EPOLLIN);
+}
+
+/**
+ * Accept every client waiting on the server socket and registers them in the reactor
+ * the handshake is left to the workers, the reactor only waits for the client hello
+ *
+ * @param rti the runtime info holding the reactor
+ */
+void accept_clients(RuntimeInfo *rti) {
+
+	// edge triggered, the socket must be drained
+	while (true) {
+		auto client = reactor_accept(&rti->reactor);
+
+		if (client == INVALID_SOCKET) {
+			return;
+		}
+
+		auto conn = make_Connection(client);
+
+		// a shard is already pinned on its cpu
+		if (rti->settings.affinity != AFFINITY_NONE && !rti->shard) {
+			// served where the network card delivers its packets
+			conn->node = socket_node(client);
+
+			// the interrupts of the card can not be moved from here, the event loop goes to them instead
+			if (!rti->acceptor_pinned && conn->node != NODE_ANY) {
+				rti->acceptor_pinned = true;
+
+				if (pin_to_node(conn->node)) {
+					llog(LOG_INFO, "[REACTOR] Moved the event loop on numa node %u, where the clients arrive\n", conn->node);
+				}
+			}
+		}
+
+		if (!reactor_watch(&rti->reactor, conn, EPOLLIN)) {
+			destroy_Connection(conn);
+		}
+	}
+}
+
 void accept_requests(RuntimeInfo *rti) {
-	Socket client = INVALID_SOCKET;
 
-	struct pollfd ss = {
-	    .fd      = rti->server_socket,
-	    .events  = POLLIN,
-	    .revents = 0,
-	};
+	struct epoll_event events[REACTOR_MAX_EVENTS];
+
+	// the connections served here wait on their client in fibers, this loop resumes them
+	if (serves_inline(rti)) {
+		set_fiber_loop(rti->reactor.epoll_fd);
+	}
 
-	// Receive until the peer shuts down the connection
 	while (!rti->thread_pool.stop) {
 
-		// infinetly wait for the socket to become usable
-		poll(&ss, 1, -1);
+		// wait for any socket to become usable, with a timeout to check for the stop signal
+		auto count = epoll_wait(rti->reactor.epoll_fd, events, REACTOR_MAX_EVENTS, REACTOR_WAIT_MS);
+
+		for (int i = 0; i < count; ++i) {
+			Connection *conn = events[i].data.ptr;
+
+			if (conn == nullptr) {
+				accept_clients(rti);
+				continue;
+			}
 
-		client = TCP_accept_client(rti->server_socket);
+			if (events[i].data.ptr == &rti->reactor.wake_fd) {
+				reactor_collect_returned(&rti->reactor);
+				continue;
+			}
 
-		if (client == -1) {
-			// no client tried to connect
-			continue;
+			// a fiber waiting on the client in the middle of a request, the connection is not in the idle list
+			if (conn->fiber != nullptr) {
+				resume_fiber(conn->fiber, true);
+				continue;
+			}
+
+			reactor_claim(&rti->reactor, conn);
+
+			if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+				if (conn->state == CONN_HANDSHAKE) {
+					record_handshake(&rti->metrics, get_monotonic_ns() - conn->accept_time_ns, conn->handshake_work_ns, false);
+				}
+				destroy_Connection(conn);
+				continue;
+			}
+
+			dispatch_connection(rti, conn);
 		}
 
-		auto ssl_connection = SSL_create_connection(rti->ssl_context, client);
+		// the responses copy the date formatted here, at most once a second
+		refresh_DateCache();
+
+		auto now     = get_monotonic_ns();
+		auto expired = reactor_expire(&rti->reactor, now);
+		atomic_fetch_add_explicit(&rti->metrics.idle_timeouts, expired, memory_order_relaxed);
 
-		if (ssl_connection == nullptr) {
-			continue;
+		// a fiber gives up on a client after CONNECTION_IO_TIMEOUT_MS, like a worker would
+		expire_fibers(now);
+
+		// the pool follows the load, from the wait of the connections it was given
+		if (!rti->shard && resize_threadpool(&rti->thread_pool)) {
+			record_pool(&rti->metrics, atomic_load(&rti->thread_pool.thread_count), rti->thread_pool.wait_avg_ns);
 		}
+	}
+
+	// the requests were resolved on this thread, the fibers still waiting give up on their clients
+	if (serves_inline(rti)) {
+		cancel_fibers();
+		release_fibers();
+		release_request_state();
+	}
+}
 
-		auto err = SSL_accept_client(ssl_connection);
+/**
+ * Receive until the buffer of the connection holds an entire request, or until the request is found to be invalid
+ *
+ * @param rti the runtime info holding the size limits
+ * @param conn the connection to receive from
+ * @param framer the framer to use, it is reset here
+ * @return false if the client closed the connection or did not send the request in time
+ */
+bool receive_request(const RuntimeInfo *rti, Connection *conn, RequestFramer *framer) {
 
-		if (err == -1) {
-			continue;
+	// the header, the body, and the chunk size lines that might be in the buffer waiting to be decoded
+	const size_t max_capacity = rti->settings.max_header_size + rti->settings.max_body_size + CONNECTION_BUFFER_SIZE;
+
+	reset_RequestFramer(framer, rti->settings.max_header_size, rti->settings.max_body_size);
+
+	// a pipelined request might already be in the buffer
+	while (true) {
+		auto state = advance_RequestFramer(framer, conn->buffer, conn->buffer_len);
+
+		if (state == FRAME_DONE || state == FRAME_ERROR) {
+			return true;
 		}
 
-		llog(LOG_DEBUG, "[SERVER] Launched request resolver for socket %d\n", client);
+		// reclaim the space taken by the chunk size lines before growing the buffer
+		if (conn->buffer_len == conn->buffer_capacity) {
+			conn->buffer_len = compact_RequestFramer(framer, conn->buffer, conn->buffer_len);
+		}
 
-		ResolverData t_data = {ssl_connection, client};
+		if (conn->buffer_len == max_capacity) {
+			framer->state        = FRAME_ERROR;
+			framer->error_status = 413;
+			return true;
+		}
 
-#ifdef NO_THREADING
-		proxy_resReq(t_data);
-#else
-		enqueue_threadpool(&rti->thread_pool, &t_data);
-#endif
+		if (connection_fill(conn, max_capacity) <= 0) {
+			return false;
+		}
 	}
 }
 
-bool compare_u_char(const u_char *lhs, const u_char *rhs) {
-	return *lhs == *rhs;
+/**
+ * The sink of the body writers, the connection of the response
+ */
+static bool send_to_connection(void *conn, const char *data, const size_t len) {
+	return connection_send((Connection *)(conn), data, len);
+}
+
+/**
+ * The zlib level to compress a streamed body with, 0 if the body is sent as it is
+ * only gzip is incremental here, and the length is not known so the fast tier is used
+ * when the choice depends on the Accept-Encoding of the request the response says so with Vary
+ */
+static int stream_gz_level(const InboundHttpMessage *request, OutboundHttpMessage *response) {
+
+	StringRef value;
+
+	// the producer might already write an encoded body
+	if (get_header_option(RP_CONTENT_ENCODING, response, &value)) {
+		return 0;
+	}
+
+	StringRef type;
+	if (!get_header_option(RP_CONTENT_TYPE, response, &type)) {
+		return 0;
+	}
+
+	if (!is_compressible(&type)) {
+		return 0;
+	}
+
+	StringRef vary = TO_STRINGREF("Accept-Encoding");
+	add_header_option(RP_VARY, &vary, response);
+
+	if (negotiate_encoding(&request->header_options[RQ_ACCEPT_ENCODING], 1 << ENCODING_GZIP) != ENCODING_GZIP) {
+		return 0;
+	}
+
+	return encoding_level(ENCODING_GZIP, COMPRESS_FAST);
 }
 
-void resolve_request(SSL *ssl_connection, const Socket client_socket) {
+bool resolve_request(const RuntimeInfo *rti, Connection *conn) {
 
 	// ---------------------------------------------------------------------- RECEIVE
-	char *request        = nullptr;
-	auto  bytes_received = SSL_receive_record(ssl_connection, &request);
+	RequestFramer framer;
+
+	if (!receive_request(rti, conn, &framer)) {
+		return false;
+	}
+
+	auto                arena    = current_arena();
+	InboundHttpMessage  mex      = {};
+	OutboundHttpMessage response = {};
+	response.arena               = arena;
 
-	// received some bytes
-	if (bytes_received > 0) {
+	++conn->requests_served;
+	bool keep_alive = false;
+
+	if (framer.state == FRAME_ERROR) {
+		llog(LOG_WARNING, "[SERVER] Malformed request on socket %d, answering %u\n", conn->client_socket, framer.error_status);
+
+		// the rest of the stream can not be trusted anymore
+		response.status_code = framer.error_status;
+	} else {
+
+		// the request is parsed where it was received, the buffer is not touched until the response is sent
+		mex = parse_InboundMessage(conn->buffer, framer.write, arena);
 
-		InboundHttpMessage mex = parse_InboundMessage(request);
 		llog(LOG_INFO, "[SERVER] Received request <%s> \n", method_str[mex.method]);
 
-		OutboundHttpMessage response = {};
-		response.header_options      = MiniMap_u_char_StringOwn_make(16, compare_u_char);
+		response.version = mex.version;
+
+		RouteMatch route;
+		auto       processor = find_route(&rti->sns.router, mex.method, &mex.url, &route);
 
-		// TODO:
-		// check the messge processors
+		if (processor == nullptr) {
+			response.status_code = 404;
+		} else {
+			// the path parameters are given with the query ones, they point in the url just like them
+			for (size_t i = 0; i < route.count; ++i) {
+				MiniMap_StringRef_StringRef_set(&mex.parameters, &route.names[i], &route.values[i]);
+			}
 
-		// make the message a single formatted string
-		auto res = compose_message(&response);
-		// llog(LOG_DEBUG, "[SERVER] Message compiled -> \n%*s\n", res.len, res.str);
+			HTTP_Method method   = mex.method;
+			response.status_code = 200;
+			processor(&method, &mex, &response);
+		}
+
+		keep_alive = is_keep_alive(&mex) && conn->requests_served < rti->settings.max_requests;
+	}
+
+	// the answer to HEAD is only the header, with the length of the body a GET would get
+	bool header_only = mex.method == HTTP_HEAD;
+	bool streamed    = response.producer != nullptr;
+
+	BodyWriter writer;
+
+	if (streamed) {
+		// before 1.1 there are no chunks, the body ends when the connection does
+		bool chunked = response.version >= HTTP_VER_11;
+		keep_alive   = keep_alive && chunked;
+
+		initialize_BodyWriter(send_to_connection, conn, chunked, stream_gz_level(&mex, &response), arena, &writer);
+
+		if (chunked) {
+			StringRef transfer_encoding = TO_STRINGREF("chunked");
+			add_header_option(RP_TRANSFER_ENCODING, &transfer_encoding, &response);
+		}
 
-		// ------------------------------------------------------------------ SEND
-		// acknowledge the segment back to the sender
-		SSL_send_record(ssl_connection, res.str, res.len);
+		if (writer.gzip) {
+			add_header_option(RP_CONTENT_ENCODING, &content_encodings_str[ENCODING_GZIP], &response);
+		}
+	}
+
+	StringRef connection_value = keep_alive ? (StringRef)TO_STRINGREF("keep-alive") : (StringRef)TO_STRINGREF("close");
+	add_header_option(RP_CONNECTION, &connection_value, &response);
 
-		destroy_OutboundHttpMessage(&response);
-		destroy_InboundHttpMessage(&mex);
-		free(res.str);
+	// without the length the client cannot know where the response ends on a persistent connection
+	// an answer to HEAD has no body, the processor gives the length the body would have
+	StringRef given_length;
+
+	if (!streamed && !get_header_option(RP_CONTENT_LENGTH, &response, &given_length)) {
+		auto content_length = num_to_string(response.body.len);
+		add_header_option(RP_CONTENT_LENGTH, &content_length, &response);
 	}
 
-	TCP_shutdown_socket(client_socket);
-	TCP_close_socket(client_socket);
-	SSL_destroy_connection(ssl_connection);
+	if (header_only || streamed) {
+		response.body.len = 0;
+	}
+
+	// the pieces of the message where they already are, the body is not copied behind the header
+	StringRef parts[MESSAGE_PARTS];
+	auto      part_count = compose_message(&response, parts);
+
+	// ------------------------------------------------------------------ SEND
+	// acknowledge the segment back to the sender
+	if (!connection_send_parts(conn, parts, part_count)) {
+		keep_alive = false;
+	} else if (response.file != nullptr && !header_only && !connection_send_file(conn, response.file->fd, 0, (size_t)(response.file->info.st_size))) {
+		keep_alive = false;
+	} else if (streamed && !header_only && !(response.producer(&writer, response.producer_state) && finish_body(&writer))) {
+		// without the last chunk the client knows the body is not whole
+		keep_alive = false;
+	}
+
+	if (streamed) {
+		close_BodyWriter(&writer);
+	}
+
+	if (response.file != nullptr) {
+		release_file(response.file);
+	}
+
+	if (response.asset != nullptr) {
+		release_asset(response.asset);
+	}
+
+	// the request is resolved, what is left in the buffer belongs to the next one
+	connection_consume(conn, framer.read);
+
+	// both messages and the response live in the arena
+	reset_Arena(arena);
+
+	return keep_alive;
+}
+
+/**
+ * Binds a listening socket on a port that other sockets can listen on too, the kernel spreads the clients between them
+ *
+ * @param[in] `family` AF_INET6 for a dual stack socket, where the ipv4 clients arrive as mapped addresses, or AF_INET
+ * @param[in] `port` the port to listen on
+ *
+ * @return INVALID_SOCKET if the socket could not be opened
+ */
+static Socket bind_shard_listener(const int family, const unsigned short port) {
+
+	Socket listener = socket(family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+
+	if (listener == INVALID_SOCKET) {
+		return INVALID_SOCKET;
+	}
+
+	int one  = 1;
+	int zero = 0;
+
+	struct sockaddr_in6 addr6 = {
+	    .sin6_family = AF_INET6,
+	    .sin6_port   = htons(port),
+	    .sin6_addr   = in6addr_any,
+	};
+
+	struct sockaddr_in addr4 = {
+	    .sin_family = AF_INET,
+	    .sin_port   = htons(port),
+	    .sin_addr   = {.s_addr = htonl(INADDR_ANY)},
+	};
+
+	// every option before the bind, the port is shared only by the sockets that asked for it
+	if (setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)) == -1 ||
+	    setsockopt(listener, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one)) == -1 ||
+	    (family == AF_INET6 && setsockopt(listener, IPPROTO_IPV6, IPV6_V6ONLY, &zero, sizeof(zero)) == -1) ||
+	    (family == AF_INET6 ? bind(listener, (struct sockaddr *)(&addr6), sizeof(addr6)) : bind(listener, (struct sockaddr *)(&addr4), sizeof(addr4))) == -1 ||
+	    listen(listener, SOMAXCONN) == -1) {
+		close(listener);
+		return INVALID_SOCKET;
+	}
+
+	return listener;
+}
+
+/**
+ * Opens the listener of a shard, dual stack when the machine has ipv6
+ *
+ * @param[in] `port` the port to listen on
+ *
+ * @return INVALID_SOCKET if the socket could not be opened
+ */
+static Socket open_shard_listener(const unsigned short port) {
+
+	auto listener = bind_shard_listener(AF_INET6, port);
+
+	if (listener == INVALID_SOCKET) {
+		listener = bind_shard_listener(AF_INET, port);
+	}
+
+	if (listener == INVALID_SOCKET) {
+		llog(LOG_ERROR, "[SHARD] Could not listen on port %u -> %s\n", port, strerror(errno));
+	}
+
+	return listener;
+}
+
+/**
+ * Gives every client to the listener of the cpu that received its packets, instead of the one picked by the hash of its address
+ * the program returns the index of the listener in the group, so the shard i must listen on the cpu i
+ *
+ * @param[in] `listener` any listener of the group
+ */
+static void steer_by_cpu(const Socket listener) {
+
+	struct sock_filter code[] = {
+	    {BPF_LD | BPF_W | BPF_ABS, 0, 0, (uint32_t)(SKF_AD_OFF + SKF_AD_CPU)},
+	    {BPF_RET | BPF_A, 0, 0, 0},
+	};
+
+	struct sock_fprog program = {
+	    .len    = sizeof(code) / sizeof(code[0]),
+	    .filter = code,
+	};
+
+	if (setsockopt(listener, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &program, sizeof(program)) == -1) {
+		llog(LOG_WARNING, "[SHARD] Could not steer the clients by cpu, they are spread by address -> %s\n", strerror(errno));
+		return;
+	}
+
+	llog(LOG_INFO, "[SHARD] Every client is served on the cpu that receives it\n");
+}
+
+/**
+ * Opens a listener and an event loop for every shard, nothing is shared between them but the ssl context and the file caches
+ *
+ * @param[in] `res` the runtime of the server, with its settings and ssl context ready
+ */
+static void setup_shards(RuntimeInfo *res) {
+
+	load_topology();
+
+	res->shard_count = res->settings.shards;
+	res->shards      = calloc(res->shard_count, sizeof(RuntimeInfo));
+	TEST_ALLOC(res->shards);
+
+	// the bpf program picks the listener by the number of the cpu
+	bool steerable = res->settings.steer_by_cpu;
+
+	for (size_t i = 0; i < res->shard_count; ++i) {
+		auto shard = &res->shards[i];
+
+		shard->ssl_context   = res->ssl_context;
+		shard->settings      = res->settings;
+		shard->shard         = true;
+		shard->server_socket = open_shard_listener(res->settings.tcp_port);
+		initialize_metrics(&shard->metrics);
+
+		if (shard->server_socket == INVALID_SOCKET || !initialize_reactor(shard->server_socket, (uint64_t)(res->settings.keep_alive_timeout) * 1000000000, &shard->reactor)) {
+			exit(1);
+		}
+
+		shard->reactor.local = true;
+		steerable            = steerable && topology_cpu(i) == (int)(i);
+	}
+
+	if (steerable) {
+		steer_by_cpu(res->shards[0].server_socket);
+	} else if (res->settings.steer_by_cpu) {
+		llog(LOG_WARNING, "[SHARD] The shards do not run on the first %zu cpus, the clients are spread by address\n", res->shard_count);
+	}
+
+	record_pool(&res->metrics, res->shard_count, 0);
+
+	llog(LOG_INFO, "[SHARD] Opened %zu listeners, each with its own event loop\n", res->shard_count);
 }
 
 void setup(SNSSettings settings, RuntimeInfo *res) {
 
 	errno = 0;
 
-	// initializing the tcp Server
-	res->server_socket = TCP_initialize_server(settings.tcp_port, 4);
+	if (settings.keep_alive_timeout == 0) {
+		settings.keep_alive_timeout = DEFAULT_KEEP_ALIVE_TIMEOUT;
+	}
 
-	if (res->server_socket == INVALID_SOCKET) {
-		exit(1);
+	if (settings.max_requests == 0) {
+		settings.max_requests = DEFAULT_MAX_REQUESTS;
+	}
+
+	if (settings.max_header_size == 0) {
+		settings.max_header_size = DEFAULT_MAX_HEADER_SIZE;
+	}
+
+	if (settings.max_body_size == 0) {
+		settings.max_body_size = DEFAULT_MAX_BODY_SIZE;
+	}
+
+	auto cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	cpus      = cpus < 1 ? 1 : cpus;
+
+	if (settings.min_threads == 0) {
+		settings.min_threads = (unsigned)(cpus);
+	}
+
+	if (settings.max_threads == 0) {
+		settings.max_threads = (unsigned)(cpus) * DEFAULT_THREADS_PER_CPU;
+	}
+
+	if (settings.max_threads < settings.min_threads) {
+		settings.max_threads = settings.min_threads;
+	}
+
+#ifdef NO_THREADING
+	// the single thread runs the one event loop
+	settings.shards = 0;
+#endif
+
+	res->settings    = settings;
+	res->shard       = false;
+	res->shards      = nullptr;
+	res->shard_count = 0;
+
+	// a restart counts from zero, and the runtime may not have been zeroed
+	initialize_metrics(&res->metrics);
+
+	// formatted before the workers start, so no response is composed without it
+	refresh_DateCache();
+
+	// initializing the tcp Server, the shards open their own listeners
+	res->server_socket = INVALID_SOCKET;
+
+	if (settings.shards == 0) {
+		res->server_socket = TCP_initialize_server(settings.tcp_port, 4);
+
+		if (res->server_socket == INVALID_SOCKET) {
+			exit(1);
+		}
 	}
 
 	llog(LOG_INFO, "[SERVER] Listening on %*s:%d\n", (int)settings.base_dir.len, settings.base_dir.str, settings.tcp_port);
+	llog(LOG_INFO, "[SERVER] Scanning requests with the %s kernels\n", scan_kernel_name());
+
+	// the files of the base directory answer every request no route matches, unless a fallback was registered
+	if (settings.base_dir.len > 0 && initialize_file_server(&settings.base_dir)) {
+		llog(LOG_INFO, "[FILES] Serving '%.*s'\n", (int)settings.base_dir.len, settings.base_dir.str);
+
+		if (res->sns.router.fallback == nullptr) {
+			add_route(&res->sns.router, HTTP_INVALID_METHOD, nullptr, serve_file);
+		}
+	}
 
 	// initializing the ssl connection data
 	SSL_initialize();
@@ -177,31 +845,99 @@ void setup(SNSSettings settings, RuntimeInfo *res) {
 		exit(1);
 	}
 
+	// the files sent with connection_send_file are encrypted by the kernel when it has the tls module, without it nothing changes
+	SSL_CTX_set_options(res->ssl_context, SSL_OP_ENABLE_KTLS);
+
 	llog(LOG_INFO, "[SSL] Context created\n");
 
+	if (settings.shards > 0) {
+		setup_shards(res);
+		return;
+	}
+
+	if (!initialize_reactor(res->server_socket, (uint64_t)(settings.keep_alive_timeout) * 1000000000, &res->reactor)) {
+		SSL_destroy_context(res->ssl_context);
+		SSL_terminate();
+		exit(1);
+	}
+
+	llog(LOG_INFO, "[REACTOR] Watching the server socket\n");
+
 	// finally creating the threadPool
-	initialize_threadpool(20, &res->thread_pool);
+	if (settings.affinity != AFFINITY_NONE) {
+		load_topology();
+	}
+
+	res->acceptor_pinned = false;
+	initialize_threadpool(settings.min_threads, settings.max_threads, settings.affinity, &res->thread_pool, res);
+	record_pool(&res->metrics, atomic_load(&res->thread_pool.thread_count), 0);
+
+	llog(LOG_INFO, "[THREAD POOL] Started %zu listenings threads, up to %u\n", atomic_load(&res->thread_pool.thread_count), settings.max_threads);
+}
+
+/**
+ * Stops the thread of every shard and closes its listener, what the shards counted goes in the metrics of the server
+ *
+ * @param[in] `rti` the runtime of the server
+ */
+static void stop_shards(RuntimeInfo *rti) {
+
+	for (size_t i = 0; i < rti->shard_count; ++i) {
+		rti->shards[i].thread_pool.stop = true;
+	}
+
+	for (size_t i = 0; i < rti->shard_count; ++i) {
+		auto shard = &rti->shards[i];
+
+		// its thread may not have started, then its listener is already closed
+		if (shard->running) {
+			pthread_join(shard->request_acceptor, NULL);
+			shard->running = false;
+		}
+
+		destroy_reactor(&shard->reactor);
+
+		if (shard->server_socket != INVALID_SOCKET) {
+			close(shard->server_socket);
+		}
+
+		merge_metrics(&rti->metrics, &shard->metrics);
+	}
 
-	llog(LOG_INFO, "[THREAD POOL] Started the listenings threads\n");
+	llog(LOG_INFO, "[SHARD] Stopped %zu shards\n", rti->shard_count);
+
+	free(rti->shards);
+	rti->shards      = nullptr;
+	rti->shard_count = 0;
 }
 
 void stop(RuntimeInfo *rti) {
 
-	TCP_terminate(rti->server_socket);
+	if (rti->shard_count > 0) {
+		stop_shards(rti);
+	} else {
+		TCP_terminate(rti->server_socket);
+
+		// the event loop resizes the pool, it has to end before the pool is destroyed
+		rti->thread_pool.stop = true;
+		pthread_join(rti->request_acceptor, NULL);
+		llog(LOG_INFO, "[SERVER] Request acceptor stopped\n");
 
-	// tpool stop
-	rti->thread_pool.stop = true;
-	destroy_threadpool(&rti->thread_pool);
-	llog(LOG_INFO, "[SERVER] Sent stop signal to all threads\n");
+		// tpool stop
+		destroy_threadpool(&rti->thread_pool, discard_task);
+		llog(LOG_INFO, "[SERVER] Sent stop signal to all threads\n");
 
-	// thread stop
-	pthread_join(rti->request_acceptor, NULL);
-	llog(LOG_INFO, "[SERVER] Request acceptor stopped\n");
+		destroy_reactor(&rti->reactor);
+	}
+
+	destroy_file_server();
 
 	SSL_destroy_context(rti->ssl_context);
 
 	SSL_terminate();
 
+	log_metrics(&rti->metrics);
+
 	llog(LOG_INFO, "[SERVER] Server stopped\n");
 }
 
@@ -209,8 +945,42 @@ void start(RuntimeInfo *rti) {
 
 	rti->thread_pool.stop = false;
 
+#ifndef NO_THREADING
+	// every shard on its own cpu, with the routes as they are now
+	for (size_t i = 0; i < rti->shard_count; ++i) {
+		auto shard = &rti->shards[i];
+
+		// the pool of a shard is never started, its stop flag only ends the event loop
+		shard->sns              = rti->sns;
+		shard->thread_pool.stop = false;
+		shard->start_time       = time(nullptr);
+
+		pthread_attr_t attr;
+		pthread_attr_init(&attr);
+		set_worker_affinity(AFFINITY_CORE, i, &attr);
+		auto errCode = pthread_create(&shard->request_acceptor, &attr, proxy_acc_req, shard);
+		pthread_attr_destroy(&attr);
+
+		shard->running = errCode == 0;
+
+		if (errCode != 0) {
+			llog(LOG_ERROR, "[SHARD] Could not start the thread of shard %zu -> %s\n", i, strerror(errCode));
+
+			// no one would accept the clients the kernel gives to its listener
+			close(shard->server_socket);
+			shard->server_socket = INVALID_SOCKET;
+		}
+	}
+
+	if (rti->shard_count > 0) {
+		llog(LOG_DEBUG, "[SERVER] Shard threads Started\n");
+		rti->start_time = time(nullptr);
+		return;
+	}
+#endif
+
 #ifdef NO_THREADING
-	proxy_accReq(rti);
+	proxy_acc_req(rti);
 #else
 	pthread_create(&rti->request_acceptor, NULL, proxy_acc_req, rti);
 #endif
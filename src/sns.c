@@ -1,3 +1,18 @@
 #include "sns.h"
 
+void register_rounte(const StringRef *route_name, const MessageProcessor *fun, SNSServer *server) {
+	add_route(&server->router, HTTP_INVALID_METHOD, route_name, fun == nullptr ? nullptr : *fun);
+}
 
+void register_method_route(const HTTP_Method method, const StringRef *route_name, const MessageProcessor *fun, SNSServer *server) {
+
+	if (route_name == nullptr) {
+		return;
+	}
+
+	add_route(&server->router, method, route_name, fun == nullptr ? nullptr : *fun);
+}
+
+void destroy_SNSServer(SNSServer *server) {
+	destroy_Router(&server->router);
+}
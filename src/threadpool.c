@@ -1,148 +1,706 @@
+#define _GNU_SOURCE // pthread_tryjoin_np
+
 #include "threadpool.h"
 
-#include "RingBuffer_ResolverData.h"
+#include "MPMCQueue_Task.h"
 #include "logger.h"
 #include "server.h"
-#include "RingBuffer_ResolverData.h"
-
+#include "utils.h"
 
 #include <errno.h>
-#include <fcntl.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <linux/futex.h>
 #include <pthread.h>
-#include <semaphore.h>
+#include <sched.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
-#include <tcpConn.h>
-
-struct ThreadPool {
-	RingBuffer_ResolverData ring_buffer;  // the jobs arranged in a threadBuffer
-	sem_t                   sempahore;    // semaphore to decide how many can get in the critical section
-	pthread_mutex_t         mutex;        // mutex to enter the critical section
-	size_t                  thread_count; // num of threads allocated in *threads
-	pthread_t              *threads;      // array of the pthreads started, it will not change once the tpoll is created
-	bool                    stop;         // should the threads stop
-};
-
-ThreadPool *initialize_threadpool(const size_t thread_count, ThreadPool *res) {
-
-	// init linked list
-	res->ring_buffer  = RingBuffer_ResolverData_make(thread_count);
-	res->thread_count = 0;
-	res->stop         = false;
-
-	// the semaphore is the one responsible for preventing race conditions
-	auto errCode = sem_init(&res->sempahore, 0, 0);
-	if (errCode != 0) {
-		llog(LOG_ERROR, "[THREAD POOL] Could not initilize semphore -> %s\n", strerror(errno));
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// the worker of the calling thread, nullptr for the threads outside of the pool
+static thread_local ThreadPool *local_pool   = nullptr;
+static thread_local Worker     *local_worker = nullptr;
+
+// where a thread starts looking for a victim, different for every thread
+static thread_local uint32_t steal_seed = 0;
+
+static void futex_wait(atomic_uint *word, const unsigned expected) {
+	syscall(SYS_futex, word, FUTEX_WAIT_PRIVATE, expected, nullptr, nullptr, 0);
+}
+
+static void futex_wake(atomic_uint *word, const int count) {
+	syscall(SYS_futex, word, FUTEX_WAKE_PRIVATE, count, nullptr, nullptr, 0);
+}
+
+/**
+ * Wakes a thread that sleeps waiting for a task, one in its epoll instance if there is any, otherwise one on the futex
+ * the epoch changes first, a thread about to sleep sees it and does not
+ */
+static void wake_thread(ThreadPool *tpool) {
+
+	atomic_fetch_add(&tpool->wake_epoch, 1);
+
+	if (atomic_load(&tpool->polling_threads) > 0) {
+		auto peak = atomic_load_explicit(&tpool->peak_threads, memory_order_acquire);
+
+		for (size_t i = 0; i < peak; ++i) {
+			auto worker = &tpool->workers[i];
+
+			// only one waker writes, the others look for another thread, a retiring one does not take tasks anymore
+			if (atomic_load_explicit(&worker->polling, memory_order_acquire) && atomic_load_explicit(&worker->state, memory_order_relaxed) == WORKER_RUNNING && atomic_exchange(&worker->polling, false)) {
+				eventfd_write(worker->wake_fd, 1);
+				return;
+			}
+		}
 	}
 
-	// Linux `man pthread_mutex_init` tells me this always returns 0
-	// better safe than sorry?
-	errCode = pthread_mutex_init(&res->mutex, NULL);
+	futex_wake(&tpool->wake_epoch, 1);
+}
+
+/**
+ * Wakes every sleeping thread, so they look at the stop flag and at their state
+ */
+static void wake_all_threads(ThreadPool *tpool) {
+
+	atomic_fetch_add(&tpool->wake_epoch, 1);
+	futex_wake(&tpool->wake_epoch, INT_MAX);
+
+	auto peak = atomic_load_explicit(&tpool->peak_threads, memory_order_acquire);
+
+	for (size_t i = 0; i < peak; ++i) {
+		if (atomic_exchange(&tpool->workers[i].polling, false)) {
+			eventfd_write(tpool->workers[i].wake_fd, 1);
+		}
+	}
+}
+
+// ---------------------------------------------------------------------------------------------- the pool
+
+/**
+ * Counts the started workers whose queues are made, in order, so the running workers stay the first thread_count
+ * any new thread calls it, the one that finishes last publishes the ones that were waiting for it
+ */
+static void publish_workers(ThreadPool *tpool) {
+
+	auto count = atomic_load(&tpool->thread_count);
+
+	while (count < atomic_load(&tpool->started_threads) && atomic_load_explicit(&tpool->workers[count].state, memory_order_acquire) == WORKER_RUNNING) {
+
+		// another thread published it first, it got the new count
+		if (!atomic_compare_exchange_weak(&tpool->thread_count, &count, count + 1)) {
+			continue;
+		}
+
+		++count;
+
+		// the thieves look at the queues from now on
+		auto peak = atomic_load(&tpool->peak_threads);
+		while (peak < count && !atomic_compare_exchange_weak(&tpool->peak_threads, &peak, count)) {
+		}
+	}
+}
+
+/**
+ * Where the threads of the pool start, they know their worker before running proxy_res_req
+ */
+static void *start_worker(void *ptr) {
+	Worker *worker = ptr;
+
+	// the queues are first touched by the thread that uses them the most, so their memory is on its numa node
+	if (worker->deque.slots == nullptr) {
+		make_WorkDeque(&worker->deque);
+		MPMCQueue_Task_make(THREADPOOL_INBOX_CAPACITY, &worker->inbox);
+	}
+
+	local_pool   = worker->pool;
+	local_worker = worker;
+	steal_seed   = (uint32_t)(worker - worker->pool->workers) * 2654435761u + 1;
+
+	// the queues are made, add_worker did not wait for them so the thread publishes itself
+	atomic_store_explicit(&worker->state, WORKER_RUNNING, memory_order_release);
+	publish_workers(worker->pool);
+
+	return proxy_res_req(worker->pool->worker_data);
+}
+
+/**
+ * Starts a thread on the worker after the running ones, pinned as the pool says
+ *
+ * @return false if the thread could not start, or the last one to leave the worker has not exited yet, the pool keeps its size
+ */
+static bool add_worker(ThreadPool *tpool) {
+
+	auto index  = atomic_load_explicit(&tpool->started_threads, memory_order_relaxed);
+	auto worker = &tpool->workers[index];
+
+	if (atomic_load(&worker->state) == WORKER_RETIRING) {
+		// the thread that left it may still be on its way out, the caller is the event loop and must not wait for it
+		if (pthread_tryjoin_np(worker->thread, NULL) != 0) {
+			return false;
+		}
+		atomic_store(&worker->state, WORKER_STOPPED);
+	}
+
+	// the eventfd was in the epoll instance of the thread that left
+	if (worker->wake_fd >= 0) {
+		close(worker->wake_fd);
+		worker->wake_fd = -1;
+	}
+	worker->poll_fd = -1;
+
+	atomic_store_explicit(&worker->idle_since, 0, memory_order_relaxed);
+	atomic_store(&worker->state, WORKER_STARTING);
+
+	pthread_attr_t attr;
+	pthread_attr_init(&attr);
+	worker->node = set_worker_affinity(tpool->affinity, index, &attr);
+
+	auto errCode = pthread_create(&worker->thread, &attr, start_worker, worker);
+	pthread_attr_destroy(&attr);
 
 	switch (errCode) {
-	case EAGAIN:
-		llog(LOG_ERROR, "[THREAD POOL] Could not initializer mutex, not enough resources\n");
+	case 0:
 		break;
-	case ENOMEM:
-		llog(LOG_ERROR, "[THREAD POOL] Could not initializer mutex, not enough memory\n");
+	case EINVAL:
+		// the only attribute is the affinity, the cpus come from the topology so this should never happen
+		llog(LOG_ERROR, "[THREAD POOL] Could not initialize thread, invalid settings in attr\n");
 		break;
 	case EPERM:
-		llog(LOG_ERROR, "[THREAD POOL] Could not initializer mutex, not enough priviledges\n");
+		// since I don't set schedule policies this should never happen
+		llog(LOG_ERROR, "[THREAD POOL] Could not initialize thread, no permission to set schedule policies for attr\n");
 		break;
-	case EINVAL:
-		llog(LOG_ERROR, "[THREAD POOL] Could not initializer mutex, invalid settings in attr\n");
-		break;
-	case 0:
+	case EAGAIN:
 	default:
+		llog(LOG_ERROR, "[THREAD POOL] Could not initialize thread, not enough resources\n");
 		break;
 	}
 
-	res->threads = malloc(thread_count * sizeof(pthread_t));
+	if (errCode != 0) {
+		atomic_store(&worker->state, WORKER_STOPPED);
+		return false;
+	}
 
-	for (size_t i = 0; i < thread_count; ++i) {
-		errCode = pthread_create(&res->threads[res->thread_count], NULL, proxy_res_req, (void *)(res));
-		switch (errCode) {
-		case EINVAL:
-			// since I don't use attr for the pthread this should never happen
-			llog(LOG_ERROR, "[THREAD POOL] Could not initialize thread, invalid settings in attr\n");
-			break;
-		case EPERM:
-			// since I don't use attr for the pthread this should never happen
-			llog(LOG_ERROR, "[THREAD POOL] Could not initialize thread, no permission to set schedule policies for attr\n");
-			break;
-		case EAGAIN:
-			llog(LOG_ERROR, "[THREAD POOL] Could not initialize thread, not enough resources\n");
-			break;
+	// the producers put tasks in it once the thread has made its queues and published it
+	atomic_store(&tpool->started_threads, index + 1);
+	publish_workers(tpool);
+	return true;
+}
+
+/**
+ * Asks the thread of the last running worker to leave, the tasks left in the worker are stolen by the others
+ */
+static void retire_worker(ThreadPool *tpool) {
+
+	auto index = atomic_load_explicit(&tpool->thread_count, memory_order_relaxed) - 1;
+
+	// the producers stop giving it tasks before it goes
+	atomic_store(&tpool->started_threads, index);
+	atomic_store_explicit(&tpool->thread_count, index, memory_order_release);
+	atomic_store(&tpool->workers[index].state, WORKER_RETIRING);
+
+	// it is sleeping, it only looks at its state when woken
+	wake_all_threads(tpool);
+}
+
+ThreadPool *initialize_threadpool(const size_t min_threads, const size_t max_threads, const uint8_t affinity, ThreadPool *res, void *worker_data) {
+
+	res->min_threads = min_threads;
+	res->affinity    = affinity;
+	res->max_threads = max_threads < min_threads ? min_threads : max_threads;
 
-		default:
-		case 0:
-			res->thread_count++;
+	// every worker on its own cache lines, the counters of the deque are aligned to them
+	res->workers = aligned_alloc(alignof(Worker), res->max_threads * sizeof(Worker));
+	TEST_ALLOC(res->workers)
+
+	// their threads make the queues
+	for (size_t i = 0; i < res->max_threads; ++i) {
+		res->workers[i].deque.slots = nullptr;
+		res->workers[i].pool        = res;
+		atomic_init(&res->workers[i].state, WORKER_STOPPED);
+		atomic_init(&res->workers[i].wait_ns, 0);
+		atomic_init(&res->workers[i].waited, 0);
+		atomic_init(&res->workers[i].idle_since, 0);
+		atomic_init(&res->workers[i].polling, false);
+		res->workers[i].poll_fd = -1;
+		res->workers[i].wake_fd = -1;
+	}
+
+	atomic_init(&res->thread_count, 0);
+	atomic_init(&res->started_threads, 0);
+	atomic_init(&res->peak_threads, 0);
+	atomic_init(&res->next_worker, 0);
+	atomic_init(&res->wake_epoch, 0);
+	atomic_init(&res->polling_threads, 0);
+	atomic_init(&res->pending, 0);
+	atomic_init(&res->stop, false);
+	res->worker_data = worker_data;
+	res->resize_ns   = get_monotonic_ns();
+	res->wait_ns     = 0;
+	res->waited      = 0;
+	res->wait_avg_ns = 0;
+
+	for (size_t i = 0; i < min_threads; ++i) {
+		if (!add_worker(res)) {
 			break;
 		}
 	}
 
+	// the first tasks need a published worker, this is before the event loop runs
+	while (atomic_load(&res->thread_count) < atomic_load(&res->started_threads)) {
+		sched_yield();
+	}
+
 	return res;
 }
 
-void destroy_threadpool(ThreadPool *tp) {
+void destroy_threadpool(ThreadPool *tp, TaskFunction discard) {
 
 	// stops all threads
 	tp->stop = true;
 
-	// wait for the threads to finish
-	for (size_t i = 0; i < tp->thread_count; ++i) {
-		// the thread may be wating for a job at the sempahore, by faking data, even if there maybe actually be some,
-		// I force the thread to check the stop value. Thus ensuring the thread exits gracefully
-		sem_post(&tp->sempahore);
+	// the threads may be sleeping waiting for a task, by changing the futex word and waking everyone
+	// I force the threads to check the stop value. Thus ensuring the threads exit gracefully
+	wake_all_threads(tp);
+
+	// the retired threads too, they may not have been joined yet, and the ones not published yet
+	for (size_t i = 0; i < tp->max_threads; ++i) {
+		if (atomic_load(&tp->workers[i].state) != WORKER_STOPPED) {
+			pthread_join(tp->workers[i].thread, NULL);
+		}
+	}
+
+	// freeing the leftover tasks (if any), no thread is left to race with
+	for (size_t i = 0; i < tp->max_threads; ++i) {
+		auto worker = &tp->workers[i];
+		Task leftover;
+
+		// no thread ever ran it
+		if (worker->deque.slots == nullptr) {
+			continue;
+		}
+
+		while (pop_WorkDeque(&worker->deque, &leftover) || MPMCQueue_Task_pop(&worker->inbox, &leftover)) {
+			if (discard != nullptr) {
+				discard(tp->worker_data, leftover.arg);
+			}
+		}
+
+		destroy_WorkDeque(&worker->deque);
+		MPMCQueue_Task_destroy(&worker->inbox);
+
+		if (worker->wake_fd >= 0) {
+			close(worker->wake_fd);
+		}
+	}
+
+	free(tp->workers);
+}
+
+/**
+ * Tries to steal a task from the other workers, starting from a random one
+ *
+ * @param[in] `node` only the workers on this node, NODE_ANY for all of them
+ */
+static bool steal_task(ThreadPool *tpool, Worker *self, const uint16_t node, Task *task) {
+
+	// the retired workers too, something may have been left in them
+	auto count = atomic_load_explicit(&tpool->peak_threads, memory_order_acquire);
+
+	// the first thread, before it published itself
+	if (count == 0) {
+		return false;
+	}
+
+	// xorshift, so the idle threads do not all go for the same victim
+	steal_seed ^= steal_seed << 13;
+	steal_seed ^= steal_seed >> 17;
+	steal_seed ^= steal_seed << 5;
+
+	auto start = steal_seed % count;
+
+	for (size_t i = 0; i < count; ++i) {
+		auto victim = &tpool->workers[(start + i) % count];
+
+		if (victim == self || (node != NODE_ANY && victim->node != node)) {
+			continue;
+		}
+
+		if (steal_WorkDeque(&victim->deque, task) || MPMCQueue_Task_pop(&victim->inbox, task)) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/**
+ * Looks for a task in the worker of the thread, then in the others, the ones on the same numa node first
+ */
+static bool find_task(ThreadPool *tpool, Worker *self, Task *task) {
+
+	if (pop_WorkDeque(&self->deque, task) || MPMCQueue_Task_pop(&self->inbox, task)) {
+		return true;
+	}
+
+	if (self->node != NODE_ANY && steal_task(tpool, self, self->node, task)) {
+		return true;
+	}
+
+	return steal_task(tpool, self, NODE_ANY, task);
+}
+
+/**
+ * Accounts the time the task waited, if it was measured
+ */
+static void record_wait(Worker *self, const Task *task) {
+
+	if (task->enqueue_ns == 0) {
+		return;
 	}
 
-	for (size_t i = 0; i < tp->thread_count; ++i) {
-		// since i have no guarantee about the order of which the treads take the sempahore, I have to split the two processes
-		pthread_join(tp->threads[i], NULL);
+	// only this thread writes them, no need for an atomic add
+	auto wait_ns = atomic_load_explicit(&self->wait_ns, memory_order_relaxed);
+	auto waited  = atomic_load_explicit(&self->waited, memory_order_relaxed);
+	atomic_store_explicit(&self->wait_ns, wait_ns + get_monotonic_ns() - task->enqueue_ns, memory_order_relaxed);
+	atomic_store_explicit(&self->waited, waited + 1, memory_order_relaxed);
+}
+
+/**
+ * Drains the wakes of the pool out of the events of the epoll instance of the thread
+ *
+ * @return how many events are left
+ */
+static int take_wakes(Worker *self, const int count, struct epoll_event *events) {
+
+	auto kept = 0;
+
+	for (int i = 0; i < count; ++i) {
+		if (events[i].data.ptr == &self->wake_fd) {
+			eventfd_t value;
+			eventfd_read(self->wake_fd, &value);
+			continue;
+		}
+
+		events[kept++] = events[i];
 	}
 
-	// free the arrat used to store the thread ids
-	free(tp->threads);
+	return kept;
+}
 
-	// freeing the leftover data (if any)
-	RingBuffer_ResolverData_destroy(&tp->ring_buffer);
+/**
+ * Sleeps in the epoll instance of the thread until one of its sockets is ready, a task comes, or the time is over
+ * the wakes of the pool are taken out of the events
+ *
+ * @param[in] `epoch` the epoch read before looking for a task, if it changed since a task may have come and the thread does not sleep
+ *
+ * @return how many events are left
+ */
+static int sleep_polling(ThreadPool *tpool, Worker *self, const unsigned epoch, const int timeout_ms, struct epoll_event *events) {
 
-	pthread_mutex_destroy(&tp->mutex);
-	sem_destroy(&tp->sempahore);
+	// published before the epoch is looked at again, a producer either sees the flag or changed the epoch before
+	atomic_store(&self->polling, true);
+	atomic_fetch_add(&tpool->polling_threads, 1);
+
+	auto count = 0;
+
+	if (atomic_load(&tpool->wake_epoch) == epoch) {
+		count = epoll_wait(self->poll_fd, events, THREADPOOL_POLL_EVENTS, timeout_ms);
+	}
+
+	// a waker that cleared it already writes the eventfd, the next wait returns right away and drains it
+	atomic_store(&self->polling, false);
+	atomic_fetch_sub(&tpool->polling_threads, 1);
+
+	return take_wakes(self, count, events);
 }
 
-ResolverData dequeue_threadpool(ThreadPool *tpool) {
+/**
+ * Waits on the sockets of a retiring thread whose fibers are still waiting on their clients, it takes no more tasks
+ * the wakes for tasks skip it, only the stop of the pool wakes it before its events or the time of its first fiber
+ *
+ * @return how many events, -1 if the pool is stopping or no fiber is waiting, the thread can leave then
+ */
+static int poll_retiring(ThreadPool *tpool, Worker *self, const int timeout_ms, struct epoll_event *events) {
+
+	if (timeout_ms < 0 || self->poll_fd < 0) {
+		return -1;
+	}
 
-	// this takes care of letting pass n threads for n datas
-	sem_wait(&tpool->sempahore);
-	pthread_mutex_lock(&tpool->mutex);
-	// ++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ CRITICAL SECTION START
+	// published before the stop flag is looked at, destroy_threadpool either sees it or set the flag before
+	atomic_store(&self->polling, true);
 
-	ResolverData res;
+	auto count = 0;
 
-	if (tpool->ring_buffer.stored == 0) {
-		res = (ResolverData){nullptr, INVALID_SOCKET};
-	} else {
-		RingBuffer_ResolverData_retrieve(&tpool->ring_buffer, &res);
+	if (!tpool->stop) {
+		count = epoll_wait(self->poll_fd, events, THREADPOOL_POLL_EVENTS, timeout_ms);
 	}
 
-	// let the next one in
-	// ---------------------------------------------------------------------------------------------- CRITICAL SECTION END
-	pthread_mutex_unlock(&tpool->mutex);
+	atomic_store(&self->polling, false);
+
+	if (tpool->stop) {
+		return -1;
+	}
+
+	return take_wakes(self, count, events);
+}
+
+/**
+ * Gives back the claim of a thread that leaves without a task, if a task was counted on it the wake goes on to another thread
+ */
+static void return_claim(ThreadPool *tpool) {
+
+	if (atomic_fetch_add(&tpool->pending, 1) >= 0) {
+		wake_thread(tpool);
+	}
+}
+
+bool set_threadpool_poll(ThreadPool *tpool, const int epoll_fd) {
+
+	auto self = local_worker;
+
+	if (local_pool != tpool) {
+		llog(LOG_ERROR, "[THREAD POOL] Only a thread of the pool can sleep in an epoll instance\n");
+		return false;
+	}
+
+	self->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+	if (self->wake_fd < 0) {
+		llog(LOG_ERROR, "[THREAD POOL] Could not make the eventfd of a thread -> %s\n", strerror(errno));
+		return false;
+	}
+
+	struct epoll_event ev = {.events = EPOLLIN, .data = {.ptr = &self->wake_fd}};
+
+	if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, self->wake_fd, &ev) != 0) {
+		llog(LOG_ERROR, "[THREAD POOL] Could not add the eventfd of a thread to its epoll instance -> %s\n", strerror(errno));
+		close(self->wake_fd);
+		self->wake_fd = -1;
+		return false;
+	}
+
+	self->poll_fd = epoll_fd;
+	return true;
+}
+
+int poll_threadpool(ThreadPool *tpool, const int timeout_ms, Task *task, struct epoll_event *events) {
+
+	*task     = (Task){nullptr, nullptr, 0};
+	auto self = local_worker;
+
+	if (local_pool != tpool) {
+		llog(LOG_ERROR, "[THREAD POOL] Dequeue from a thread that is not of the pool\n");
+		return -1;
+	}
+
+	if (atomic_load_explicit(&self->state, memory_order_relaxed) == WORKER_RETIRING) {
+		return poll_retiring(tpool, self, timeout_ms, events);
+	}
+
+	// claim a task, if there were more tasks than threads waiting for them one is surely in some worker
+	auto pending = atomic_fetch_sub(&tpool->pending, 1);
+	auto spins   = THREADPOOL_SPIN_COUNT;
+
+	while (!tpool->stop && atomic_load_explicit(&self->state, memory_order_relaxed) == WORKER_RUNNING) {
+
+		// read the epoch before looking for a task, if one is enqueued after this the epoch changes and the wait returns immediately
+		auto epoch = atomic_load(&tpool->wake_epoch);
+
+		if (find_task(tpool, self, task)) {
+			atomic_store_explicit(&self->idle_since, 0, memory_order_relaxed);
+			record_wait(self, task);
+			return 0;
+		}
+
+		// the task is counted, but the producer might still be publishing it or a thief lost it to another
+		if (pending > 0 && spins > 0) {
+			--spins;
+			continue;
+		}
+
+		// with a timeout the thread still has work waiting on its sockets
+		if (timeout_ms < 0 && atomic_load_explicit(&self->idle_since, memory_order_relaxed) == 0) {
+			atomic_store_explicit(&self->idle_since, get_monotonic_ns(), memory_order_relaxed);
+		}
+
+		if (self->poll_fd < 0) {
+			futex_wait(&tpool->wake_epoch, epoch);
+			continue;
+		}
+
+		auto count   = sleep_polling(tpool, self, epoch, timeout_ms, events);
+		auto running = !tpool->stop && atomic_load_explicit(&self->state, memory_order_relaxed) == WORKER_RUNNING;
+
+		// woken for a task, it is looked for once more before the events are given back, unless the thread was retired while it slept
+		if (running && find_task(tpool, self, task)) {
+			atomic_store_explicit(&self->idle_since, 0, memory_order_relaxed);
+			record_wait(self, task);
+			return count;
+		}
+
+		// the events still go back to the fibers of a retired thread
+		if (count > 0 || timeout_ms >= 0 || !running) {
+			return_claim(tpool);
+			return count;
+		}
 
+		// the claim is still covered by a task that is not visible yet
+		pending = atomic_load(&tpool->pending) + 1;
+		spins   = THREADPOOL_SPIN_COUNT;
+	}
+
+	if (tpool->stop) {
+		return -1;
+	}
+
+	// retiring, the claim goes back and so does the wake, in case it was meant for a task
+	atomic_fetch_add(&tpool->pending, 1);
+	wake_thread(tpool);
+
+	return poll_retiring(tpool, self, timeout_ms, events);
+}
+
+Task dequeue_threadpool(ThreadPool *tpool) {
+
+	// without an epoll instance the thread only comes back with a task
+	Task res;
+	poll_threadpool(tpool, -1, &res, nullptr);
 	return res;
 }
 
-void enqueue_threadpool(ThreadPool *tpool, const ResolverData *data) {
+/**
+ * Puts a task from outside in the inbox of the next worker in the round robin, if it is full in the inbox of the following ones
+ * the load is not checked, it would read the cache lines of the workers for every task, an idle worker steals what is left behind
+ *
+ * @param[in] `node` the numa node the task prefers, the round robin skips the workers of the other nodes
+ */
+static bool push_inbox(ThreadPool *tpool, const Task *task, const uint16_t node) {
+
+	auto count = atomic_load_explicit(&tpool->thread_count, memory_order_acquire);
+
+	if (count == 0) {
+		return false;
+	}
+
+	auto turn  = atomic_fetch_add_explicit(&tpool->next_worker, 1, memory_order_relaxed);
+	auto first = turn % count;
+
+	if (node != NODE_ANY && tpool->affinity != AFFINITY_NONE) {
+		for (size_t i = 0; i < count; ++i) {
+			if (tpool->workers[(turn + i) % count].node == node) {
+				first = (turn + i) % count;
+				break;
+			}
+		}
+	}
+
+	// a few tasks carry the time they arrived, so the pool knows how long they wait
+	Task stamped = *task;
+	stamped.enqueue_ns = turn % THREADPOOL_WAIT_SAMPLE == 0 ? get_monotonic_ns() : 0;
+
+	// the inboxes are bounded, if the threads can't keep up slow down the producer
+	while (true) {
+		for (size_t i = 0; i < count; ++i) {
+			if (MPMCQueue_Task_push(&tpool->workers[(first + i) % count].inbox, &stamped)) {
+				return true;
+			}
+		}
+
+		if (tpool->stop) {
+			return false;
+		}
+		sched_yield();
+	}
+}
+
+bool enqueue_threadpool(ThreadPool *tpool, const Task *task) {
+	return enqueue_threadpool_on(tpool, task, NODE_ANY);
+}
+
+bool enqueue_threadpool_on(ThreadPool *tpool, const Task *task, const uint16_t node) {
+
+	// a task a thread of the pool gives itself stays in its deque, close to the data it was working on
+	auto local = local_pool == tpool && push_WorkDeque(&local_worker->deque, task);
+
+	if (!local && !push_inbox(tpool, task, node)) {
+		return false;
+	}
+
+	// a thread is waiting for a task that was not there, only then the syscall is needed
+	if (atomic_fetch_add(&tpool->pending, 1) < 0) {
+		wake_thread(tpool);
+	}
+
+	return true;
+}
+
+uint16_t threadpool_current_node() {
+	return local_worker == nullptr ? NODE_ANY : local_worker->node;
+}
+
+bool resize_threadpool(ThreadPool *tpool) {
+
+	auto now = get_monotonic_ns();
+
+	if (now - tpool->resize_ns < THREADPOOL_RESIZE_INTERVAL_NS) {
+		return false;
+	}
+
+	tpool->resize_ns = now;
+
+	auto     count   = atomic_load_explicit(&tpool->thread_count, memory_order_relaxed);
+	auto     peak    = atomic_load_explicit(&tpool->peak_threads, memory_order_relaxed);
+	uint64_t wait_ns = 0;
+	uint64_t waited  = 0;
+
+	for (size_t i = 0; i < peak; ++i) {
+		wait_ns += atomic_load_explicit(&tpool->workers[i].wait_ns, memory_order_relaxed);
+		waited += atomic_load_explicit(&tpool->workers[i].waited, memory_order_relaxed);
+	}
+
+	// only what was measured since the last time
+	auto measured = waited - tpool->waited;
+
+	tpool->wait_avg_ns = measured == 0 ? 0 : (wait_ns - tpool->wait_ns) / measured;
+	tpool->wait_ns     = wait_ns;
+	tpool->waited      = waited;
+
+	// no task was taken but some are waiting, every thread is stuck on a long one
+	if (measured == 0 && atomic_load(&tpool->pending) > 0) {
+		tpool->wait_avg_ns = THREADPOOL_RESIZE_INTERVAL_NS;
+	}
+
+	// the threads started last time have not all published themselves, their measure is not in yet
+	if (count != atomic_load_explicit(&tpool->started_threads, memory_order_relaxed)) {
+		return true;
+	}
+
+	if (tpool->wait_avg_ns > THREADPOOL_GROW_WAIT_NS && count < tpool->max_threads) {
+		auto target = count + count / 4 + 1;
+		target      = target > tpool->max_threads ? tpool->max_threads : target;
 
-	pthread_mutex_lock(&tpool->mutex);
-	// ++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ CRITICAL SECTION START
+		while (atomic_load_explicit(&tpool->started_threads, memory_order_relaxed) < target && add_worker(tpool)) {
+		}
+
+		llog(LOG_DEBUG, "[THREAD POOL] Tasks waited %" PRIu64 " us on average, growing to %zu threads\n", tpool->wait_avg_ns / 1000, atomic_load(&tpool->started_threads));
+		return true;
+	}
 
-	RingBuffer_ResolverData_append(&tpool->ring_buffer, data);
+	if (count <= tpool->min_threads) {
+		return true;
+	}
+
+	// only the last one leaves, so the running workers stay the first ones
+	auto idle_since = atomic_load_explicit(&tpool->workers[count - 1].idle_since, memory_order_relaxed);
+
+	if (idle_since != 0 && now - idle_since > THREADPOOL_IDLE_TIMEOUT_NS) {
+		retire_worker(tpool);
+		llog(LOG_DEBUG, "[THREAD POOL] A thread was idle for %" PRIu64 " s, shrunk to %zu threads\n", (now - idle_since) / 1000000000, count - 1);
+	}
 
-	// notify anywating thread that there is data
-	sem_post(&tpool->sempahore);
-	// ---------------------------------------------------------------------------------------------- CRITICAL SECTION END
-	pthread_mutex_unlock(&tpool->mutex);
+	return true;
 }
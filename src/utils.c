@@ -1,12 +1,15 @@
 #include "utils.h"
 
+#include "DateCache.h"
 #include "logger.h"
+#include "scan.h"
 
 #include <assert.h>
 #include <ctype.h>
 #include <errno.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include <time.h>
 #define ZLIB_CONST
 #include <zlib.h>
@@ -16,18 +19,18 @@ static thread_local char digits_str_buffer[41]; // enough to represent 2^128, nu
 
 StringRef getUTC() {
 
-	// Get the date in UTC/GMT
-	time_t    unixtime;
-	struct tm UTC;
+	// format based on rfc822 revision rfc1123
+	format_http_date(time(nullptr), buffer);
 
-	// set unix time on unixtime
-	time(&unixtime);
-	gmtime_r(&unixtime, &UTC);
+	return (StringRef){buffer, HTTP_DATE_LEN};
+}
 
-	// format based on rfc822 revision rfc1123
-	strftime(buffer, 80, "%a, %d %b %Y %H:%M:%S GMT", &UTC);
+uint64_t get_monotonic_ns() {
 
-	return (StringRef){buffer, 80};
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (uint64_t)(now.tv_sec) * 1000000000 + (uint64_t)(now.tv_nsec);
 }
 
 void url_decode(StringOwn *dst, const StringRef *src) {
@@ -37,33 +40,32 @@ void url_decode(StringOwn *dst, const StringRef *src) {
 	size_t write_index = 0;
 	size_t read_index  = 0;
 
-	while (read_index < src->len && write_index < dst->len) {
+	// one byte is kept for the null terminator
+	while (read_index < src->len && write_index + 1 < dst->len) {
 
 		// html whatever thingy to decode
-		if (src->str[read_index] == '%' && read_index < src->len + 2) {
+		if (src->str[read_index] == '%' && read_index + 2 < src->len && isxdigit((unsigned char)(src->str[read_index + 1])) && isxdigit((unsigned char)(src->str[read_index + 2]))) {
 			a = src->str[read_index + 1];
 			b = src->str[read_index + 2];
-			if (isxdigit(a) && isxdigit(b)) {
-				if (a >= 'a') {
-					a -= 'a' - 'A';
-				}
-				if (a >= 'A') {
-					a -= ('A' - 10);
-				} else {
-					a -= '0';
-				}
-				if (b >= 'a') {
-					b -= 'a' - 'A';
-				}
-				if (b >= 'A') {
-					b -= ('A' - 10);
-				} else {
-					b -= '0';
-				}
-				dst->str[write_index] = (char)(16 * a) + b;
-				write_index++;
-				read_index += 3;
+			if (a >= 'a') {
+				a -= 'a' - 'A';
+			}
+			if (a >= 'A') {
+				a -= ('A' - 10);
+			} else {
+				a -= '0';
 			}
+			if (b >= 'a') {
+				b -= 'a' - 'A';
+			}
+			if (b >= 'A') {
+				b -= ('A' - 10);
+			} else {
+				b -= '0';
+			}
+			dst->str[write_index] = (char)(16 * a) + b;
+			write_index++;
+			read_index += 3;
 		} else if (src->str[read_index] == '+') {
 			dst->str[write_index] = ' ';
 			write_index++;
@@ -76,48 +78,81 @@ void url_decode(StringOwn *dst, const StringRef *src) {
 	}
 
 	dst->str[write_index] = '\0';
+	dst->len              = write_index;
 }
 
-bool compress_gz(const StringRef *data, StringOwn *output) {
+/**
+ * The deflate stream of the thread, made on the first use and reset for the next ones
+ * making one allocates about 256KB, resetting it allocates nothing
+ */
+static thread_local z_stream gz_stream;
+static thread_local bool     gz_stream_ready = false;
+static thread_local int      gz_stream_level;
 
-	z_stream deflate_s;
-	deflate_s.zalloc   = Z_NULL;
-	deflate_s.zfree    = Z_NULL;
-	deflate_s.opaque   = Z_NULL;
-	deflate_s.avail_in = 0;
-	deflate_s.next_in  = Z_NULL;
+bool compress_gz(const StringRef *data, const int level, StringOwn *output) {
 
 	constexpr int window_bits = 15 + 16; // gzip with windowbits of 15
 
 	constexpr int mem_level = 8;
 
-	if (deflateInit2(&deflate_s, Z_BEST_COMPRESSION, Z_DEFLATED, window_bits, mem_level, Z_DEFAULT_STRATEGY) != Z_OK) {
-		llog(LOG_ERROR, "[COMPRESS] Deflate init failed\n.");
-		return false;
-	}
+	if (!gz_stream_ready) {
+		gz_stream.zalloc = Z_NULL;
+		gz_stream.zfree  = Z_NULL;
+		gz_stream.opaque = Z_NULL;
+
+		if (deflateInit2(&gz_stream, level, Z_DEFLATED, window_bits, mem_level, Z_DEFAULT_STRATEGY) != Z_OK) {
+			llog(LOG_ERROR, "[COMPRESS] Deflate init failed\n.");
+			return false;
+		}
 
-	deflate_s.next_in  = (const Bytef *)data->str;
-	deflate_s.avail_in = (uInt)data->len;
+		gz_stream_ready = true;
+		gz_stream_level = level;
 
-	output->len = 0;
-	do {
-		size_t increase = data->len / 2 + 1024;
-		if (output->len < (output->len + increase)) {
-			output->str = realloc(output->str, output->len + increase);
+	} else {
+		deflateReset(&gz_stream);
+
+		// with nothing pending it only changes the parameters
+		if (level != gz_stream_level && deflateParams(&gz_stream, level, Z_DEFAULT_STRATEGY) == Z_OK) {
+			gz_stream_level = level;
 		}
+	}
+
+	// the biggest the output can be, a single call compresses everything
+	auto bound = deflateBound(&gz_stream, (uLong)(data->len));
+
+	output->str = realloc(output->str, bound);
+	TEST_ALLOC(output->str)
 
-		deflate_s.avail_out = (unsigned int)(increase);
-		deflate_s.next_out  = (Bytef *)((output->str + output->len));
+	gz_stream.next_in   = (const Bytef *)data->str;
+	gz_stream.avail_in  = (uInt)data->len;
+	gz_stream.next_out  = (Bytef *)output->str;
+	gz_stream.avail_out = (uInt)bound;
 
-		deflate(&deflate_s, Z_FINISH);
-		output->len += (increase - deflate_s.avail_out);
-	} while (deflate_s.avail_out == 0);
+	if (deflate(&gz_stream, Z_FINISH) != Z_STREAM_END) {
+		llog(LOG_ERROR, "[COMPRESS] Deflate did not finish in %lu bytes\n", bound);
+		output->len = 0;
+		return false;
+	}
 
-	deflateEnd(&deflate_s);
+	output->len = gz_stream.total_out;
+
+	// the bound is much bigger than the output of anything that compresses well
+	if (output->len > 0 && output->len < bound) {
+		output->str = realloc(output->str, output->len);
+		TEST_ALLOC(output->str)
+	}
 
 	return true;
 }
 
+void release_gz_stream() {
+
+	if (gz_stream_ready) {
+		deflateEnd(&gz_stream);
+		gz_stream_ready = false;
+	}
+}
+
 void trimwhitespace(char *str) {
 
 	char *nEnd;
@@ -150,44 +185,11 @@ void trimwhitespace(char *str) {
 }
 
 const char *strnstr(const char *haystack, const char *needle, const size_t count) {
-
-	if (count == 0) {
-		return nullptr;
-	}
-
-	size_t Itr = 0;
-
-	for (size_t i = 0; i < count; ++i) {
-
-		if (haystack[i] == needle[Itr]) {
-			++Itr;
-			if (needle[Itr] == '\0') {
-				// match
-				return haystack + i - Itr + 1;
-			}
-
-		} else {
-			// reset back the search
-			i -= Itr;
-			Itr = 0;
-		}
-	}
-
-	// no match
-	return nullptr;
+	return scan_str(haystack, needle, strlen(needle), count);
 }
 
 const char *strnchr(const char *str, int chr, const size_t count) {
-
-	for (size_t i = 0; i < count; ++i) {
-		if (*str == chr) {
-			return str;
-		}
-
-		++str;
-	}
-
-	return nullptr;
+	return scan_chr(str, (char)(chr), count);
 }
 
 const char *strrnchr(const char *str, int chr, const size_t count) {
@@ -211,6 +213,18 @@ size_t strnlen(const char *str, const size_t count) {
 	return res;
 }
 
+uint64_t hash_bytes(const char *data, const size_t len) {
+
+	uint64_t hash = 14695981039346656037u;
+
+	for (size_t i = 0; i < len; ++i) {
+		hash ^= (unsigned char)(data[i]);
+		hash *= 1099511628211u;
+	}
+
+	return hash;
+}
+
 StringRef trim(StringRef *str_ref) {
 	size_t newStart;
 
@@ -244,7 +258,7 @@ bool strrefblnk(const StringRef *str_ref) {
 	for (size_t i = 0; i < str_ref->len; ++i) {
 		// is space check for
 		// space, horizontal tab, and whitespaces (\n \r \v \f)
-		if (!isspace(str_ref->str[i])) {
+		if (!isspace((unsigned char)str_ref->str[i])) {
 			return false;
 		}
 	}
@@ -252,6 +266,33 @@ bool strrefblnk(const StringRef *str_ref) {
 	return true;
 }
 
+bool has_token(const StringRef *list, const StringRef *token) {
+
+	StringRef rest = *list;
+
+	while (rest.len > 0) {
+		auto comma = strnchr(rest.str, ',', rest.len);
+
+		StringRef element = {rest.str, comma == nullptr ? rest.len : (size_t)(comma - rest.str)};
+
+		// skip the element and the comma
+		rest.str += element.len;
+		rest.len -= element.len;
+		if (comma != nullptr) {
+			++rest.str;
+			--rest.len;
+		}
+
+		element = trim(&element);
+
+		if (element.len == token->len && strncasecmp(element.str, token->str, token->len) == 0) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
 char *copy_StringOwn(const StringOwn *str) {
 	auto cpy = malloc(str->len);
 	TEST_ALLOC(cpy)
@@ -266,6 +307,12 @@ char *copy_StringRef(const StringRef *str) {
 	return cpy;
 }
 
+char *copy_StringRef_arena(const StringRef *str, Arena *arena) {
+	char *cpy = alloc_Arena(arena, str->len);
+	memcpy(cpy, str->str, str->len);
+	return cpy;
+}
+
 // https://stackoverflow.com/questions/1068849/how-do-i-determine-the-number-of-digits-of-an-integer-in-c
 unsigned char get_num_digits(size_t n) {
 	unsigned char r = 1;
@@ -308,91 +355,3 @@ StringRef num_to_string(size_t number) {
 
 	return (StringRef){str, digits};
 }
-
-StringRef get_reason_phrase(unsigned short statusCode) {
-
-	switch (statusCode) {
-	case 100:
-		return CAST_STRINGREF("Continue");
-	case 101:
-		return CAST_STRINGREF("Switching Protocols");
-	case 200:
-		return CAST_STRINGREF("OK");
-	case 201:
-		return CAST_STRINGREF("Created");
-	case 202:
-		return CAST_STRINGREF("Accepted");
-	case 203:
-		return CAST_STRINGREF("Non-Authoritative Information");
-	case 204:
-		return CAST_STRINGREF("No Content");
-	case 205:
-		return CAST_STRINGREF("Reset Content");
-	case 206:
-		return CAST_STRINGREF("Partial Content");
-	case 300:
-		return CAST_STRINGREF("Multiple Choices");
-	case 301:
-		return CAST_STRINGREF("Moved Permanently");
-	case 302:
-		return CAST_STRINGREF("Found");
-	case 303:
-		return CAST_STRINGREF("See Other");
-	case 304:
-		return CAST_STRINGREF("Not Modified");
-	case 305:
-		return CAST_STRINGREF("Use Proxy");
-	case 307:
-		return CAST_STRINGREF("Temporary Redirect");
-	case 400:
-		return CAST_STRINGREF("Bad Request");
-	case 401:
-		return CAST_STRINGREF("Unauthorized");
-	case 402:
-		return CAST_STRINGREF("Payment Required");
-	case 403:
-		return CAST_STRINGREF("Forbidden");
-	case 404:
-		return CAST_STRINGREF("Not Found");
-	case 405:
-		return CAST_STRINGREF("Method Not Allowed");
-	case 406:
-		return CAST_STRINGREF("Not Acceptable");
-	case 407:
-		return CAST_STRINGREF("Proxy Authentication Required");
-	case 408:
-		return CAST_STRINGREF("Request Time-out");
-	case 409:
-		return CAST_STRINGREF("Conflict");
-	case 410:
-		return CAST_STRINGREF("Gone");
-	case 411:
-		return CAST_STRINGREF("Length Required");
-	case 412:
-		return CAST_STRINGREF("Precondition Failed");
-	case 413:
-		return CAST_STRINGREF("Request Entity Too Large");
-	case 414:
-		return CAST_STRINGREF("Request-URI Too Large");
-	case 415:
-		return CAST_STRINGREF("Unsupported Media Type");
-	case 416:
-		return CAST_STRINGREF("Requested range not satisfiable");
-	case 417:
-		return CAST_STRINGREF("Expectation Failed");
-	case 500:
-		return CAST_STRINGREF("Internal Server Error");
-	case 501:
-		return CAST_STRINGREF("Not Implemented");
-	case 502:
-		return CAST_STRINGREF("Bad Gateway");
-	case 503:
-		return CAST_STRINGREF("Service Unavailable");
-	case 504:
-		return CAST_STRINGREF("Gateway Time-out");
-	case 505:
-		return CAST_STRINGREF("HTTP Version not supported");
-	default:
-		return CAST_STRINGREF("UNKN");
-	}
-}
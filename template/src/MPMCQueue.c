@@ -0,0 +1,116 @@
+//template<T>
+
+#include "MPMCQueue_#T#.h"
+
+#include "logger.h"
+#include "utils.h"
+
+#include <errno.h>
+
+#define MPMCQueue MPMCQueue_#T#
+
+void MPMCQueue_#T#_make(const size_t capacity, MPMCQueue *res) {
+
+	size_t count = 1;
+	while (count < (capacity == 0 ? 1024 : capacity)) {
+		count <<= 1;
+	}
+
+	res->cells = malloc(count * sizeof(MPMCQueue_#T#_Cell));
+	TEST_ALLOC(res->cells)
+
+	res->mask = count - 1;
+
+	// every slot is free for the first lap
+	for (size_t i = 0; i < count; ++i) {
+		atomic_init(&res->cells[i].sequence, i);
+	}
+
+	atomic_init(&res->enqueue_pos, 0);
+	atomic_init(&res->dequeue_pos, 0);
+}
+
+void MPMCQueue_#T#_destroy(MPMCQueue *queue) {
+
+	free(queue->cells);
+
+	// zero everything
+	queue->cells = nullptr;
+	queue->mask  = 0;
+}
+
+bool MPMCQueue_#T#_push(MPMCQueue *queue, const T *element) {
+
+	MPMCQueue_#T#_Cell *cell;
+	size_t pos = atomic_load_explicit(&queue->enqueue_pos, memory_order_relaxed);
+
+	while (true) {
+		cell = queue->cells + (pos & queue->mask);
+
+		size_t    seq  = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+		ptrdiff_t diff = (ptrdiff_t)(seq) - (ptrdiff_t)(pos);
+
+		if (diff == 0) {
+			// the slot is free, try to take it
+			if (atomic_compare_exchange_weak_explicit(&queue->enqueue_pos, &pos, pos + 1, memory_order_relaxed, memory_order_relaxed)) {
+				break;
+			}
+		} else if (diff < 0) {
+			// the slot still holds the data of the previous lap, the queue is full
+			return false;
+		} else {
+			// another producer took it, try again with the new position
+			pos = atomic_load_explicit(&queue->enqueue_pos, memory_order_relaxed);
+		}
+	}
+
+	cell->data = *element;
+
+	// publish the data to the consumers
+	atomic_store_explicit(&cell->sequence, pos + 1, memory_order_release);
+
+	return true;
+}
+
+bool MPMCQueue_#T#_pop(MPMCQueue *queue, T *result) {
+
+	MPMCQueue_#T#_Cell *cell;
+	size_t pos = atomic_load_explicit(&queue->dequeue_pos, memory_order_relaxed);
+
+	while (true) {
+		cell = queue->cells + (pos & queue->mask);
+
+		size_t    seq  = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+		ptrdiff_t diff = (ptrdiff_t)(seq) - (ptrdiff_t)(pos + 1);
+
+		if (diff == 0) {
+			// the slot holds data, try to take it
+			if (atomic_compare_exchange_weak_explicit(&queue->dequeue_pos, &pos, pos + 1, memory_order_relaxed, memory_order_relaxed)) {
+				break;
+			}
+		} else if (diff < 0) {
+			// the slot has not been written yet, the queue is empty
+			return false;
+		} else {
+			// another consumer took it, try again with the new position
+			pos = atomic_load_explicit(&queue->dequeue_pos, memory_order_relaxed);
+		}
+	}
+
+	*result = cell->data;
+
+	// free the slot for the next lap of the producers
+	atomic_store_explicit(&cell->sequence, pos + queue->mask + 1, memory_order_release);
+
+	return true;
+}
+
+size_t MPMCQueue_#T#_count(MPMCQueue *queue) {
+
+	size_t enqueued = atomic_load_explicit(&queue->enqueue_pos, memory_order_relaxed);
+	size_t dequeued = atomic_load_explicit(&queue->dequeue_pos, memory_order_relaxed);
+
+	return enqueued > dequeued ? enqueued - dequeued : 0;
+}
+
+#undef MPMCQueue
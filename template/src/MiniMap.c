@@ -15,6 +15,17 @@ MiniMap MiniMap_#K#_#V#_make(const size_t initial_count, bool (*eq)(const K *, c
 	return res;
 }
 
+MiniMap MiniMap_#K#_#V#_make_arena(const size_t initial_count, bool (*eq)(const K *, const K *), Arena *arena) {
+
+	MiniMap res;
+
+	res.keys   = MiniVector_#K#_make_arena(initial_count, arena);
+	res.values = MiniVector_#V#_make_arena(initial_count, arena);
+	res.eq_fun = eq;
+
+	return res;
+}
+
 void MiniMap_#K#_#V#_destroy(MiniMap *map) {
 
 	MiniVector_#K#_destroy(&map->keys);
@@ -0,0 +1,669 @@
+// compile from this folder
+// gcc -O2 -DDO_BENCH -I../include bench.c ../src/threadpool.c ../src/WorkDeque.c ../src/Topology.c ../src/MPMCQueue_Task.c ../src/RingBuffer_ResolverData.c ../src/Connection.c ../src/Fiber.c \
+//     ../src/HttpMessage.c ../src/scan.c ../src/Arena.c ../src/utils.c ../src/DateCache.c ../src/StringRef.c ../src/MiniMap_StringRef_StringRef.c ../src/MiniVector_StringRef.c \
+//     -llogger -ltcpConn -lsslConn -lssl -lcrypto -lz -o bench.out
+#include <stdio.h>
+#ifndef DO_BENCH
+#	error "This source file should only be processed when doing benchmarks, "
+#else
+
+#	include "Connection.h"
+#	include "DateCache.h"
+#	include "HttpMessage.h"
+#	include "RingBuffer_ResolverData.h"
+#	include "constants.h"
+#	include "threadpool.h"
+#	include "utils.h"
+
+#	include <arpa/inet.h>
+#	include <fcntl.h>
+#	include <logger.h>
+#	include <netinet/in.h>
+#	include <openssl/err.h>
+#	include <openssl/ssl.h>
+#	include <openssl/x509.h>
+#	include <pthread.h>
+#	include <semaphore.h>
+#	include <stdatomic.h>
+#	include <stdlib.h>
+#	include <strings.h>
+#	include <sys/socket.h>
+#	include <time.h>
+#	include <unistd.h>
+#	include <zlib.h>
+
+constexpr size_t JOBS = 2000000;
+
+static atomic_size_t consumed;
+
+typedef struct {
+	uint64_t wall_ns;
+	uint64_t cpu_ns;
+} BenchResult;
+
+uint64_t get_cpu_ns() {
+	struct timespec now;
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &now);
+	return (uint64_t)(now.tv_sec) * 1000000000 + (uint64_t)(now.tv_nsec);
+}
+
+// the job does not point to anything, the consumers just count it
+static const ResolverData fake_job = {(Connection *)(&consumed)};
+
+static void count_task(void *, void *counter) {
+	atomic_fetch_add_explicit((atomic_size_t *)(counter), 1, memory_order_relaxed);
+}
+
+// the same for the thread pool, that runs tasks
+static const Task fake_task = {count_task, &consumed, 0};
+
+// ---------------------------------------------------------------------------------------------- the queue the thread pool used before
+// one mutex + one semaphore around a growable RingBuffer
+
+typedef struct {
+	RingBuffer_ResolverData ring_buffer;
+	sem_t                   sempahore;
+	pthread_mutex_t         mutex;
+	atomic_bool             stop;
+} LockedQueue;
+
+void *locked_consumer(void *ptr) {
+	LockedQueue *queue = ptr;
+
+	while (!queue->stop) {
+		sem_wait(&queue->sempahore);
+		pthread_mutex_lock(&queue->mutex);
+
+		ResolverData res;
+		bool         got = RingBuffer_ResolverData_retrieve(&queue->ring_buffer, &res);
+
+		pthread_mutex_unlock(&queue->mutex);
+
+		if (got) {
+			atomic_fetch_add_explicit(&consumed, 1, memory_order_relaxed);
+		}
+	}
+
+	return nullptr;
+}
+
+void *locked_producer(void *ptr) {
+	LockedQueue *queue = ptr;
+
+	for (size_t i = 0; i < JOBS; ++i) {
+		pthread_mutex_lock(&queue->mutex);
+		RingBuffer_ResolverData_append(&queue->ring_buffer, &fake_job);
+		sem_post(&queue->sempahore);
+		pthread_mutex_unlock(&queue->mutex);
+	}
+
+	return nullptr;
+}
+
+BenchResult bench_locked(const size_t consumers) {
+	LockedQueue queue;
+	queue.ring_buffer = RingBuffer_ResolverData_make(consumers);
+	queue.stop        = false;
+	sem_init(&queue.sempahore, 0, 0);
+	pthread_mutex_init(&queue.mutex, nullptr);
+	atomic_store(&consumed, 0);
+
+	pthread_t threads[consumers];
+	for (size_t i = 0; i < consumers; ++i) {
+		pthread_create(&threads[i], nullptr, locked_consumer, &queue);
+	}
+
+	auto      wall_start = get_monotonic_ns();
+	auto      cpu_start  = get_cpu_ns();
+	pthread_t producer;
+	pthread_create(&producer, nullptr, locked_producer, &queue);
+
+	pthread_join(producer, nullptr);
+	while (atomic_load(&consumed) < JOBS) {
+		sched_yield();
+	}
+
+	BenchResult res = {get_monotonic_ns() - wall_start, get_cpu_ns() - cpu_start};
+
+	queue.stop = true;
+	for (size_t i = 0; i < consumers; ++i) {
+		sem_post(&queue.sempahore);
+	}
+	for (size_t i = 0; i < consumers; ++i) {
+		pthread_join(threads[i], nullptr);
+	}
+
+	RingBuffer_ResolverData_destroy(&queue.ring_buffer);
+	sem_destroy(&queue.sempahore);
+	pthread_mutex_destroy(&queue.mutex);
+
+	return res;
+}
+
+// ---------------------------------------------------------------------------------------------- the current thread pool
+// the thread pool starts proxy_res_req, the benchmark provides its own that only counts the jobs
+
+void *proxy_res_req(void *ptr) {
+	ThreadPool *pool = ptr;
+
+	while (true) {
+		auto task = dequeue_threadpool(pool);
+
+		if (task.run == nullptr) {
+			break;
+		}
+
+		task.run(pool, task.arg);
+	}
+
+	return nullptr;
+}
+
+void *pool_producer(void *ptr) {
+	ThreadPool *pool = ptr;
+
+	for (size_t i = 0; i < JOBS; ++i) {
+		enqueue_threadpool(pool, &fake_task);
+	}
+
+	return nullptr;
+}
+
+BenchResult bench_pool(const size_t consumers) {
+	ThreadPool pool;
+	atomic_store(&consumed, 0);
+
+	initialize_threadpool(consumers, consumers, AFFINITY_NONE, &pool, &pool);
+
+	auto      wall_start = get_monotonic_ns();
+	auto      cpu_start  = get_cpu_ns();
+	pthread_t producer;
+	pthread_create(&producer, nullptr, pool_producer, &pool);
+
+	pthread_join(producer, nullptr);
+	while (atomic_load(&consumed) < JOBS) {
+		sched_yield();
+	}
+
+	BenchResult res = {get_monotonic_ns() - wall_start, get_cpu_ns() - cpu_start};
+
+	destroy_threadpool(&pool, nullptr);
+
+	return res;
+}
+
+// ---------------------------------------------------------------------------------------------- elastic sizing
+// tasks that block, like a worker reading a file or writing to a slow client, the cpu is not what limits them
+
+constexpr size_t BLOCKING_JOBS   = 20000;
+constexpr size_t BLOCKING_BATCH  = 50;
+constexpr long   BLOCKING_JOB_NS = 200000;
+
+static void blocking_task(void *, void *counter) {
+	struct timespec pause = {0, BLOCKING_JOB_NS};
+	nanosleep(&pause, nullptr);
+	atomic_fetch_add_explicit((atomic_size_t *)(counter), 1, memory_order_relaxed);
+}
+
+static const Task blocking_job = {blocking_task, &consumed, 0};
+
+BenchResult bench_elastic(const size_t min_threads, const size_t max_threads, size_t *peak) {
+	ThreadPool pool;
+	atomic_store(&consumed, 0);
+
+	initialize_threadpool(min_threads, max_threads, AFFINITY_NONE, &pool, &pool);
+
+	auto wall_start = get_monotonic_ns();
+	auto cpu_start  = get_cpu_ns();
+
+	// a batch every millisecond, like the reactor the producer also resizes the pool
+	struct timespec pause = {0, 1000000};
+	for (size_t i = 0; i < BLOCKING_JOBS; i += BLOCKING_BATCH) {
+		for (size_t j = 0; j < BLOCKING_BATCH; ++j) {
+			enqueue_threadpool(&pool, &blocking_job);
+		}
+		resize_threadpool(&pool);
+		nanosleep(&pause, nullptr);
+	}
+
+	while (atomic_load(&consumed) < BLOCKING_JOBS) {
+		resize_threadpool(&pool);
+		nanosleep(&pause, nullptr);
+	}
+
+	BenchResult res = {get_monotonic_ns() - wall_start, get_cpu_ns() - cpu_start};
+
+	*peak = atomic_load(&pool.peak_threads);
+	destroy_threadpool(&pool, nullptr);
+
+	return res;
+}
+
+// ---------------------------------------------------------------------------------------------- header name lookup
+// the header names, in order and case, sent by real clients
+
+static const char *chrome_headers[] = {"Host", "Connection", "Cache-Control", "sec-ch-ua", "sec-ch-ua-mobile", "sec-ch-ua-platform", "Upgrade-Insecure-Requests", "User-Agent", "Accept", "Sec-Fetch-Site", "Sec-Fetch-Mode", "Sec-Fetch-User", "Sec-Fetch-Dest", "Accept-Encoding", "Accept-Language", "Cookie"};
+static const char *firefox_headers[] = {"Host", "User-Agent", "Accept", "Accept-Language", "Accept-Encoding", "Connection", "Cookie", "Upgrade-Insecure-Requests", "Sec-Fetch-Dest", "Sec-Fetch-Mode", "Sec-Fetch-Site", "Sec-Fetch-User", "Priority", "TE"};
+static const char *safari_headers[]  = {"Host", "Accept", "Sec-Fetch-Site", "Cookie", "Sec-Fetch-Dest", "Accept-Language", "Sec-Fetch-Mode", "User-Agent", "Accept-Encoding", "Connection"};
+static const char *curl_headers[]    = {"Host", "User-Agent", "Accept"};
+static const char *h2_headers[]      = {"host", "user-agent", "accept", "accept-language", "accept-encoding", "referer", "cookie", "if-none-match", "if-modified-since", "cache-control"};
+
+typedef struct {
+	const char  *name;
+	const char **headers;
+	size_t       count;
+} HeaderSet;
+
+#	define HEADER_SET(name, arr) {name, arr, sizeof(arr) / sizeof(arr[0])}
+
+static const HeaderSet header_sets[] = {
+    HEADER_SET("chrome", chrome_headers),
+    HEADER_SET("firefox", firefox_headers),
+    HEADER_SET("safari", safari_headers),
+    HEADER_SET("curl", curl_headers),
+    HEADER_SET("lowercase (h2 proxy)", h2_headers),
+};
+
+constexpr size_t LOOKUP_ROUNDS = 200000;
+
+// how get_parameter_code worked before, case sensitive
+u_char linear_parameter_code(const StringRef *parameter) {
+	for (u_char i = 0; i < RQ_ENUM_LEN; ++i) {
+		if (equal_StringRef(parameter, &header_request_options_str[i])) {
+			return i;
+		}
+	}
+	return RQ_ENUM_LEN;
+}
+
+// the simple way to make the linear scan case insensitive
+u_char linear_case_parameter_code(const StringRef *parameter) {
+	for (u_char i = 0; i < RQ_ENUM_LEN; ++i) {
+		if (parameter->len == header_request_options_str[i].len && strncasecmp(parameter->str, header_request_options_str[i].str, parameter->len) == 0) {
+			return i;
+		}
+	}
+	return RQ_ENUM_LEN;
+}
+
+double bench_lookup(const HeaderSet *set, u_char (*lookup)(const StringRef *), size_t *known) {
+	StringRef names[32];
+	for (size_t i = 0; i < set->count; ++i) {
+		names[i] = CAST_STRINGREF(set->headers[i]);
+	}
+
+	// the sum of the codes keeps the compiler from removing the lookups
+	volatile size_t sink = 0;
+	*known               = 0;
+
+	auto start = get_monotonic_ns();
+	for (size_t r = 0; r < LOOKUP_ROUNDS; ++r) {
+		for (size_t i = 0; i < set->count; ++i) {
+			sink = sink + lookup(&names[i]);
+		}
+	}
+	auto end = get_monotonic_ns();
+
+	for (size_t i = 0; i < set->count; ++i) {
+		*known += lookup(&names[i]) != RQ_ENUM_LEN;
+	}
+
+	return (double)(end - start) / (double)(LOOKUP_ROUNDS * set->count);
+}
+
+void bench_headers() {
+	llog(LOG_INFO, "header name lookup, ns per header (recognized headers)\n");
+	llog(LOG_INFO, "%-22s %-18s %-18s %-18s\n", "client", "linear", "linear nocase", "perfect hash");
+
+	for (size_t i = 0; i < sizeof(header_sets) / sizeof(header_sets[0]); ++i) {
+		size_t known_linear, known_case, known_hash;
+
+		auto linear = bench_lookup(&header_sets[i], linear_parameter_code, &known_linear);
+		auto nocase = bench_lookup(&header_sets[i], linear_case_parameter_code, &known_case);
+		auto hash   = bench_lookup(&header_sets[i], get_parameter_code, &known_hash);
+
+		llog(LOG_INFO, "%-22s %6.1f (%2zu/%2zu)     %6.1f (%2zu/%2zu)     %6.1f (%2zu/%2zu)\n", header_sets[i].name, linear, known_linear, header_sets[i].count, nocase, known_case, header_sets[i].count, hash, known_hash, header_sets[i].count);
+	}
+}
+
+// ---------------------------------------------------------------------------------------------- sending a file
+// a tls connection on loopback, a client thread reads and drops everything the server sends
+
+constexpr size_t FILE_BENCH_SIZE   = 8 * 1024 * 1024;
+constexpr size_t FILE_BENCH_ROUNDS = 16;
+
+uint64_t get_thread_cpu_ns() {
+	struct timespec now;
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+	return (uint64_t)(now.tv_sec) * 1000000000 + (uint64_t)(now.tv_nsec);
+}
+
+typedef struct {
+	SSL_CTX *context;
+	int      socket;
+} BenchClient;
+
+void *file_client(void *ptr) {
+	BenchClient *client = ptr;
+
+	SSL *ssl = SSL_new(client->context);
+	SSL_set_fd(ssl, client->socket);
+
+	if (SSL_connect(ssl) == 1) {
+		static char buffer[64 * 1024];
+		size_t      read  = 0;
+		size_t      total = 0;
+
+		while (total < FILE_BENCH_SIZE * FILE_BENCH_ROUNDS && SSL_read_ex(ssl, buffer, sizeof(buffer), &read) == 1) {
+			total += read;
+		}
+	}
+
+	SSL_free(ssl);
+	close(client->socket);
+	return nullptr;
+}
+
+/**
+ * A self signed certificate only for the benchmark
+ */
+SSL_CTX *make_server_context(const bool ktls) {
+	auto key  = EVP_EC_gen("P-256");
+	auto cert = X509_new();
+
+	ASN1_INTEGER_set(X509_get_serialNumber(cert), 1);
+	X509_gmtime_adj(X509_getm_notBefore(cert), 0);
+	X509_gmtime_adj(X509_getm_notAfter(cert), 3600);
+	X509_set_pubkey(cert, key);
+	X509_NAME_add_entry_by_txt(X509_get_subject_name(cert), "CN", MBSTRING_ASC, (const unsigned char *)"localhost", -1, -1, 0);
+	X509_set_issuer_name(cert, X509_get_subject_name(cert));
+	X509_sign(cert, key, EVP_sha256());
+
+	auto context = SSL_CTX_new(TLS_server_method());
+	SSL_CTX_use_certificate(context, cert);
+	SSL_CTX_use_PrivateKey(context, key);
+
+	if (ktls) {
+		SSL_CTX_set_options(context, SSL_OP_ENABLE_KTLS);
+	}
+
+	X509_free(cert);
+	EVP_PKEY_free(key);
+	return context;
+}
+
+typedef enum {
+	SEND_COPY,   // read the file in the body and copy it in the composed message, like before
+	SEND_JOINED, // a body already in memory, copied behind the header in one buffer
+	SEND_PARTS,  // a body already in memory, sent with the header by connection_send_parts
+	SEND_CHUNK,  // connection_send_file without kernel tls
+	SEND_KTLS,   // connection_send_file with kernel tls
+} SendMode;
+
+/**
+ * Sends the file FILE_BENCH_ROUNDS times
+ *
+ * @return false if the mode can not be used here
+ */
+bool bench_send_file(const SendMode mode, const int file, BenchResult *res) {
+	auto server_context = make_server_context(mode == SEND_KTLS);
+	auto client_context = SSL_CTX_new(TLS_client_method());
+
+	// connected on loopback before the handshake, so the client thread can start right away
+	struct sockaddr_in address = {.sin_family = AF_INET, .sin_port = 0, .sin_addr = {htonl(INADDR_LOOPBACK)}};
+	socklen_t          len     = sizeof(address);
+
+	auto listener = socket(AF_INET, SOCK_STREAM, 0);
+	bind(listener, (struct sockaddr *)&address, sizeof(address));
+	listen(listener, 1);
+	getsockname(listener, (struct sockaddr *)&address, &len);
+
+	BenchClient client = {client_context, socket(AF_INET, SOCK_STREAM, 0)};
+	connect(client.socket, (struct sockaddr *)&address, sizeof(address));
+
+	auto conn = make_Connection(accept(listener, nullptr, nullptr));
+	close(listener);
+
+	pthread_t client_thread;
+	pthread_create(&client_thread, nullptr, file_client, &client);
+
+	conn->ssl = SSL_new(server_context);
+	SSL_set_fd(conn->ssl, conn->client_socket);
+
+	bool usable = SSL_accept(conn->ssl) == 1 && (mode != SEND_KTLS || BIO_get_ktls_send(SSL_get_wbio(conn->ssl)));
+
+	if (usable) {
+		bool  in_memory = mode == SEND_COPY || mode == SEND_JOINED || mode == SEND_PARTS;
+		char *body      = in_memory ? malloc(FILE_BENCH_SIZE) : nullptr;
+		char *message   = in_memory ? malloc(FILE_BENCH_SIZE) : nullptr;
+
+		// the header is part of the bytes the client waits for
+		StringRef header = TO_STRINGREF("HTTP/1.1 200 OK\r\nContent-Type: application/octet-stream\r\nContent-Length: 8388532\r\n\r\n");
+		StringRef parts[] = {header, {body, FILE_BENCH_SIZE - header.len}};
+
+		if (mode == SEND_JOINED || mode == SEND_PARTS) {
+			pread(file, body, FILE_BENCH_SIZE, 0);
+		}
+
+		auto wall_start = get_monotonic_ns();
+		auto cpu_start  = get_thread_cpu_ns();
+
+		for (size_t i = 0; i < FILE_BENCH_ROUNDS; ++i) {
+			if (mode == SEND_COPY) {
+				pread(file, body, FILE_BENCH_SIZE, 0);
+				memcpy(message, body, FILE_BENCH_SIZE);
+				connection_send(conn, message, FILE_BENCH_SIZE);
+			} else if (mode == SEND_JOINED) {
+				memcpy(message, header.str, header.len);
+				memcpy(message + header.len, parts[1].str, parts[1].len);
+				connection_send(conn, message, FILE_BENCH_SIZE);
+			} else if (mode == SEND_PARTS) {
+				connection_send_parts(conn, parts, 2);
+			} else {
+				connection_send_file(conn, file, 0, FILE_BENCH_SIZE);
+			}
+		}
+
+		*res = (BenchResult){get_monotonic_ns() - wall_start, get_thread_cpu_ns() - cpu_start};
+
+		free(body);
+		free(message);
+	} else {
+		// the client is waiting for data that will not come
+		shutdown(conn->client_socket, SHUT_RDWR);
+	}
+
+	pthread_join(client_thread, nullptr);
+	destroy_Connection(conn);
+	SSL_CTX_free(server_context);
+	SSL_CTX_free(client_context);
+
+	return usable;
+}
+
+void bench_files() {
+	char name[] = "/tmp/sns_bench_XXXXXX";
+	auto file   = mkstemp(name);
+	unlink(name);
+
+	// random bytes, in the page cache before the first round
+	static char block[64 * 1024];
+	for (size_t i = 0; i < FILE_BENCH_SIZE; i += sizeof(block)) {
+		for (size_t j = 0; j < sizeof(block); ++j) {
+			block[j] = (char)(rand());
+		}
+		write(file, block, sizeof(block));
+	}
+
+	static const char *mode_names[] = {"copy in the message", "memory, joined", "memory, in parts", "pread + SSL_write", "kTLS SSL_sendfile"};
+
+	llog(LOG_INFO, "sending a %zu MiB file %zu times over tls on loopback\n", FILE_BENCH_SIZE / (1024 * 1024), FILE_BENCH_ROUNDS);
+	llog(LOG_INFO, "%-22s %-10s %-16s\n", "mode", "MiB/s", "sender cpu ns/KiB");
+
+	for (int mode = SEND_COPY; mode <= SEND_KTLS; ++mode) {
+		BenchResult res;
+
+		if (!bench_send_file((SendMode)(mode), file, &res)) {
+			llog(LOG_INFO, "%-22s not available, the kernel has no tls module\n", mode_names[mode]);
+			continue;
+		}
+
+		auto bytes = (double)(FILE_BENCH_SIZE * FILE_BENCH_ROUNDS);
+		llog(LOG_INFO, "%-22s %-10.1f %-16.1f\n", mode_names[mode], bytes / (1024 * 1024) / ((double)res.wall_ns / 1e9), (double)res.cpu_ns / (bytes / 1024));
+	}
+
+	close(file);
+}
+
+// ---------------------------------------------------------------------------------------------- the Date header
+// every response carries one, the reactor refreshes the cache when it wakes up
+
+constexpr size_t DATE_ROUNDS = 10000000;
+
+// how the date was made before, for every response
+void strftime_date_header(char *out) {
+	struct tm parts;
+	auto      now = time(nullptr);
+	gmtime_r(&now, &parts);
+	strftime(out, DATE_HEADER_LEN + 1, "Date: %a, %d %b %Y %H:%M:%S GMT\r\n", &parts);
+}
+
+// the copy compose_message makes
+void copied_date_header(char *out) {
+	auto date = get_date_header();
+	memcpy(out, date.str, date.len);
+}
+
+// with the refresh the reactor makes, when it wakes up for every response
+void refreshed_date_header(char *out) {
+	refresh_DateCache();
+	copied_date_header(out);
+}
+
+double bench_date(void (*make)(char *)) {
+	char out[DATE_HEADER_LEN + 1];
+
+	// the last byte changes with the second, it keeps the compiler from removing the calls
+	volatile char sink = 0;
+
+	auto start = get_monotonic_ns();
+	for (size_t i = 0; i < DATE_ROUNDS; ++i) {
+		make(out);
+		sink = sink + out[DATE_HEADER_LEN - 3];
+	}
+	auto end = get_monotonic_ns();
+
+	return (double)(end - start) / DATE_ROUNDS;
+}
+
+void bench_dates() {
+	auto formatted = bench_date(strftime_date_header);
+	auto refreshed = bench_date(refreshed_date_header);
+	auto copied    = bench_date(copied_date_header);
+
+	llog(LOG_INFO, "Date header of a response, ns per response\n");
+	llog(LOG_INFO, "%-30s %6.1f\n", "time + gmtime_r + strftime", formatted);
+	llog(LOG_INFO, "%-30s %6.1f\n", "refresh + copy of the cache", refreshed);
+	llog(LOG_INFO, "%-30s %6.1f\n", "copy of the cache", copied);
+}
+
+// ---------------------------------------------------------------------------------------------- compressing small bodies
+// a json response of a few KiB, what a handler compresses on every request
+
+constexpr size_t GZ_ROUNDS = 20000;
+
+// how compress_gz worked before, a new deflate stream every time
+bool fresh_compress_gz(const StringRef *data, const int level, StringOwn *output) {
+	z_stream stream = {};
+
+	if (deflateInit2(&stream, level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+		return false;
+	}
+
+	auto bound  = deflateBound(&stream, (uLong)(data->len));
+	output->str = realloc(output->str, bound);
+
+	stream.next_in   = (const Bytef *)data->str;
+	stream.avail_in  = (uInt)data->len;
+	stream.next_out  = (Bytef *)output->str;
+	stream.avail_out = (uInt)bound;
+
+	auto res    = deflate(&stream, Z_FINISH) == Z_STREAM_END;
+	output->len = stream.total_out;
+	deflateEnd(&stream);
+
+	return res;
+}
+
+double bench_gz(const StringRef *data, bool (*compress)(const StringRef *, const int, StringOwn *), size_t *out_len) {
+	StringOwn output = {};
+
+	auto start = get_monotonic_ns();
+	for (size_t i = 0; i < GZ_ROUNDS; ++i) {
+		compress(data, Z_DEFAULT_COMPRESSION, &output);
+	}
+	auto end = get_monotonic_ns();
+
+	*out_len = output.len;
+	free(output.str);
+
+	return (double)(end - start) / GZ_ROUNDS / 1000;
+}
+
+void bench_compress() {
+	char   body[4096];
+	size_t len = 0;
+
+	for (size_t i = 0; len + 64 < sizeof(body); ++i) {
+		len += (size_t)(snprintf(body + len, sizeof(body) - len, "{\"id\": %zu, \"name\": \"item %zu\", \"stock\": %zu},", i, i * 7, i % 13));
+	}
+
+	StringRef data = {body, len};
+	size_t    fresh_len, reused_len;
+
+	auto fresh  = bench_gz(&data, fresh_compress_gz, &fresh_len);
+	auto reused = bench_gz(&data, compress_gz, &reused_len);
+
+	llog(LOG_INFO, "gzip of a %zu bytes json body, us per body (compressed size)\n", len);
+	llog(LOG_INFO, "%-30s %6.1f (%zu)\n", "deflateInit2 every time", fresh, fresh_len);
+	llog(LOG_INFO, "%-30s %6.1f (%zu)\n", "stream of the thread, reset", reused, reused_len);
+}
+
+int main() {
+	bench_files();
+	bench_dates();
+	bench_compress();
+	bench_headers();
+
+	const size_t consumer_counts[] = {1, 4, 20};
+
+	llog(LOG_INFO, "%zu jobs from one producer, like the reactor\n", JOBS);
+	llog(LOG_INFO, "%-10s %-30s %-10s %-10s\n", "consumers", "queue", "ns/job", "cpu ns/job");
+
+	for (size_t i = 0; i < sizeof(consumer_counts) / sizeof(consumer_counts[0]); ++i) {
+		auto locked = bench_locked(consumer_counts[i]);
+		auto pool   = bench_pool(consumer_counts[i]);
+
+		llog(LOG_INFO, "%-10zu %-30s %-10.1f %-10.1f\n", consumer_counts[i], "mutex + sem + RingBuffer", (double)locked.wall_ns / JOBS, (double)locked.cpu_ns / JOBS);
+		llog(LOG_INFO, "%-10zu %-30s %-10.1f %-10.1f\n", consumer_counts[i], "work stealing + futex", (double)pool.wall_ns / JOBS, (double)pool.cpu_ns / JOBS);
+	}
+
+	const size_t thread_ranges[][2] = {{1, 1}, {1, 64}, {64, 64}};
+
+	llog(LOG_INFO, "%zu jobs sleeping %ld us, %zu every ms\n", BLOCKING_JOBS, BLOCKING_JOB_NS / 1000, BLOCKING_BATCH);
+	llog(LOG_INFO, "%-10s %-10s %-10s %-10s\n", "threads", "peak", "total ms", "cpu ms");
+
+	for (size_t i = 0; i < sizeof(thread_ranges) / sizeof(thread_ranges[0]); ++i) {
+		size_t peak;
+		auto   elastic = bench_elastic(thread_ranges[i][0], thread_ranges[i][1], &peak);
+
+		char range[32];
+		snprintf(range, sizeof(range), "%zu-%zu", thread_ranges[i][0], thread_ranges[i][1]);
+
+		llog(LOG_INFO, "%-10s %-10zu %-10.1f %-10.1f\n", range, peak, (double)elastic.wall_ns / 1000000, (double)elastic.cpu_ns / 1000000);
+	}
+
+	return 0;
+}
+
+#endif
@@ -3,9 +3,31 @@
 #	error "This source file should only be processed when doing tests, "
 #else
 
+#	include "Arena.h"
+#	include "AssetCache.h"
+#	include "BodyWriter.h"
+#	include "DateCache.h"
+#	include "Encoding.h"
+#	include "Fiber.h"
+#	include "FileServer.h"
+#	include "HttpMessage.h"
+#	include "MPMCQueue_Task.h"
+#	include "RequestFramer.h"
+#	include "Router.h"
+#	include "WorkDeque.h"
+#	include "constants.h"
+#	include "scan.h"
 #	include "utils.h"
 
+#	include <brotli/decode.h>
 #	include <logger.h>
+#	include <pthread.h>
+#	include <stdlib.h>
+#	include <string.h>
+#	include <sys/epoll.h>
+#	include <unistd.h>
+#	include <zlib.h>
+#	include <zstd.h>
 #	define STRING(a) a, #a
 #	define TEST(x)        \
 		total_tests++; \
@@ -18,6 +40,790 @@ bool test_num_to_string(size_t t, const char *s) {
 	return b;
 }
 
+bool test_has_token(const char *list, const char *token, bool expected) {
+	StringRef l = CAST_STRINGREF(list);
+	StringRef t = CAST_STRINGREF(token);
+	bool      b = has_token(&l, &t) == expected;
+	llog(LOG_DEBUG, "'%s' has '%s' == %d, %s\n", list, token, expected, b ? "Success" : "Failure");
+	return b;
+}
+
+/**
+ * feeds the request to the framer `step` bytes at a time, like it was arriving in many records
+ */
+bool test_framer(const char *request, size_t step, uint8_t state, const char *body) {
+	char buffer[512];
+	auto len = strlen(request);
+	memcpy(buffer, request, len);
+
+	RequestFramer framer;
+	reset_RequestFramer(&framer, 256, 256);
+
+	uint8_t res = FRAME_HEADER;
+	for (size_t available = step; res != FRAME_DONE && res != FRAME_ERROR; available += step) {
+		res = advance_RequestFramer(&framer, buffer, available < len ? available : len);
+		if (available >= len) {
+			break;
+		}
+	}
+
+	bool b = res == state;
+	if (b && state == FRAME_DONE) {
+		b = framer.write - framer.body_start == strlen(body) && strncmp(buffer + framer.body_start, body, strlen(body)) == 0;
+	}
+
+	llog(LOG_DEBUG, "framing %zu bytes at a time -> %u (%u), %s\n", step, res, framer.error_status, b ? "Success" : "Failure");
+	return b;
+}
+
+bool test_strnstr(const char *haystack, const char *needle, ptrdiff_t expected) {
+	auto res = strnstr(haystack, needle, strlen(haystack));
+	bool b   = expected < 0 ? res == nullptr : res == haystack + expected;
+	llog(LOG_DEBUG, "'%s' in %zu bytes == %td, %s\n", needle, strlen(haystack), expected, b ? "Success" : "Failure");
+	return b;
+}
+
+/**
+ * tokenizes the header and checks the name and value of the field at `index`
+ */
+bool test_tokenize(const char *header, size_t expected_count, size_t index, const char *name, const char *value) {
+	StringRef   h = CAST_STRINGREF(header);
+	StringRef   request_line;
+	HeaderField fields[8];
+
+	auto count = tokenize_header(&h, &request_line, fields, 8);
+	bool b     = count == expected_count && strncmp(request_line.str, "GET / HTTP/1.1", request_line.len) == 0;
+
+	if (b && index < count) {
+		b = fields[index].name.len == strlen(name) && strncmp(fields[index].name.str, name, fields[index].name.len) == 0;
+		b = b && fields[index].value.len == strlen(value) && strncmp(fields[index].value.str, value, fields[index].value.len) == 0;
+	}
+
+	llog(LOG_DEBUG, "%zu fields with the %s kernels, %s\n", count, scan_kernel_name(), b ? "Success" : "Failure");
+	return b;
+}
+
+bool test_parameter_code(const char *name, u_char expected) {
+	StringRef n = CAST_STRINGREF(name);
+	bool      b = get_parameter_code(&n) == expected;
+	llog(LOG_DEBUG, "'%s' == %u, %s\n", name, expected, b ? "Success" : "Failure");
+	return b;
+}
+
+/**
+ * parses the request from a buffer of exactly its size, like the receive buffer it has no terminator to stop a read past it
+ */
+bool test_parse_content_type(const char *request, const char *content_type) {
+	auto  len    = strlen(request);
+	char *buffer = malloc(len);
+	memcpy(buffer, request, len);
+
+	Arena arena = make_Arena(1024);
+	auto  msg   = parse_InboundMessage(buffer, len, &arena);
+
+	StringRef expected = CAST_STRINGREF(content_type);
+	bool      b        = equal_StringRef(&msg.header_options[RQ_CONTENT_TYPE], &expected);
+
+	destroy_Arena(&arena);
+	free(buffer);
+
+	llog(LOG_DEBUG, "Content-Type '%s', %s\n", content_type, b ? "Success" : "Failure");
+	return b;
+}
+
+// the processors are only compared, never called
+void route_home(const HTTP_Method *, const InboundHttpMessage *, OutboundHttpMessage *) {}
+void route_user(const HTTP_Method *, const InboundHttpMessage *, OutboundHttpMessage *) {}
+void route_user_post(const HTTP_Method *, const InboundHttpMessage *, OutboundHttpMessage *) {}
+void route_users(const HTTP_Method *, const InboundHttpMessage *, OutboundHttpMessage *) {}
+void route_files(const HTTP_Method *, const InboundHttpMessage *, OutboundHttpMessage *) {}
+void route_missing(const HTTP_Method *, const InboundHttpMessage *, OutboundHttpMessage *) {}
+
+/**
+ * looks the url up and checks the processor found and the value of the last parameter captured
+ */
+bool test_route(const Router *router, uint8_t method, const char *url, MessageProcessor expected, const char *name, const char *value) {
+	StringRef  u = CAST_STRINGREF(url);
+	RouteMatch match;
+
+	bool b = find_route(router, method, &u, &match) == expected;
+
+	if (b && name != nullptr) {
+		auto last = match.count - 1;
+		b         = match.count > 0 && match.names[last].len == strlen(name) && strncmp(match.names[last].str, name, match.names[last].len) == 0;
+		b         = b && match.values[last].len == strlen(value) && strncmp(match.values[last].str, value, match.values[last].len) == 0;
+	}
+
+	llog(LOG_DEBUG, "%u %s with %zu parameters, %s\n", method, url, match.count, b ? "Success" : "Failure");
+	return b;
+}
+
+bool test_sanitize_path(const char *url, const char *expected) {
+	Arena     arena = make_Arena(256);
+	StringRef u     = CAST_STRINGREF(url);
+	StringOwn path;
+
+	bool ok = sanitize_path(&u, &arena, &path);
+	bool b  = expected == nullptr ? !ok : ok && strcmp(path.str, expected) == 0;
+
+	llog(LOG_DEBUG, "'%s' -> '%s', %s\n", url, ok ? path.str : "refused", b ? "Success" : "Failure");
+	destroy_Arena(&arena);
+	return b;
+}
+
+/**
+ * a cached file is shared until it is replaced on disk, then the next acquire opens the new one
+ */
+bool test_file_cache() {
+	char dir[] = "/tmp/sns_test_XXXXXX";
+	bool b     = mkdtemp(dir) != nullptr;
+
+	char file[64];
+	snprintf(file, sizeof(file), "%s/style.css", dir);
+
+	FILE *f = fopen(file, "w");
+	b       = b && f != nullptr && fputs("body {}", f) >= 0 && fclose(f) == 0;
+
+	FileCache cache;
+	StringRef base = CAST_STRINGREF(dir);
+	StringOwn path = {(char *)"style.css", 9};
+	b              = b && initialize_FileCache(&base, &cache);
+
+	auto first  = b ? acquire_file(&cache, &path) : nullptr;
+	auto second = b ? acquire_file(&cache, &path) : nullptr;
+	b           = first != nullptr && first == second && first->info.st_size == 7 && strncmp(first->mime.str, "text/css", 8) == 0;
+
+	if (b) {
+		release_file(second);
+
+		// replaced like a deploy would, the old entry stays valid for who holds it
+		char tmp[64];
+		snprintf(tmp, sizeof(tmp), "%s/new.css", dir);
+		f = fopen(tmp, "w");
+		b = f != nullptr && fputs("body { color: red; }", f) >= 0 && fclose(f) == 0 && rename(tmp, file) == 0;
+
+		// only the entries older than the ttl are checked
+		atomic_store(&first->checked_ns, 0);
+		second = acquire_file(&cache, &path);
+		b      = b && second != nullptr && second != first && second->info.st_size == 20 && first->info.st_size == 7;
+
+		release_file(first);
+		release_file(second);
+	}
+
+	destroy_FileCache(&cache);
+	unlink(file);
+	rmdir(dir);
+
+	llog(LOG_DEBUG, "file cache in %s, %s\n", dir, b ? "Success" : "Failure");
+	return b;
+}
+
+/**
+ * the gzip variant is made once and shared, the least recently used asset is evicted when the shard is full
+ */
+bool test_asset_cache() {
+	char dir[] = "/tmp/sns_test_XXXXXX";
+	bool b     = mkdtemp(dir) != nullptr;
+
+	char file[64];
+	snprintf(file, sizeof(file), "%s/page.html", dir);
+
+	FILE *f = b ? fopen(file, "w") : nullptr;
+	b       = b && f != nullptr;
+	for (size_t i = 0; b && i < 200; ++i) {
+		b = fputs("<p>the same line over and over</p>\n", f) >= 0;
+	}
+	b = b && fclose(f) == 0;
+
+	FileCache  files;
+	AssetCache assets;
+	StringRef  base = CAST_STRINGREF(dir);
+	StringOwn  path = {(char *)"page.html", 9};
+	b               = b && initialize_FileCache(&base, &files);
+
+	auto entry = b ? acquire_file(&files, &path) : nullptr;
+	b          = entry != nullptr;
+
+	// room in every shard for the plain asset, not for both
+	initialize_AssetCache(ASSET_CACHE_SHARDS * (b ? (size_t)(entry->info.st_size) + sizeof(Asset) + 600 : 0), &assets);
+	b = b && acquire_asset(&assets, entry, ENCODING_GZIP, false) == nullptr;
+
+	if (b) {
+		auto gzip  = acquire_asset(&assets, entry, ENCODING_GZIP, true);
+		auto again = acquire_asset(&assets, entry, ENCODING_GZIP, false);
+		b          = gzip != nullptr && gzip == again && gzip->encoding == ENCODING_GZIP && gzip->body.len < (size_t)(entry->info.st_size);
+		// the content length is not null terminated
+		StringRef content_length = b ? (StringRef){gzip->content_length.str, gzip->content_length.len} : (StringRef){};
+		StringRef body_len       = num_to_string(b ? gzip->body.len : 0);
+		b                        = b && equal_StringRef(&body_len, &content_length);
+
+		// the prepared fields go in a response as they are, and can still be looked up
+		Arena               arena    = make_Arena(0);
+		OutboundHttpMessage response = {};
+		StringRef           length;
+		StringRef           encoding;
+		response.arena = &arena;
+		if (b) {
+			add_header_fields(&gzip->header, &response);
+		}
+		b = b && get_header_option(RP_CONTENT_LENGTH, &response, &length) && equal_StringRef(&length, &body_len);
+		b = b && get_header_option(RP_CONTENT_ENCODING, &response, &encoding) && equal_StringRef(&encoding, &content_encodings_str[ENCODING_GZIP]);
+		destroy_Arena(&arena);
+
+		// same shard, the gzip one is evicted but stays valid for who holds it
+		auto plain = acquire_asset(&assets, entry, ENCODING_IDENTITY, true);
+		b          = b && plain != nullptr && plain->body.len == (size_t)(entry->info.st_size) && strcmp(plain->etag.str, gzip->etag.str) != 0;
+		b          = b && acquire_asset(&assets, entry, ENCODING_GZIP, false) == nullptr && gzip->body.len > 0;
+
+		release_asset(gzip);
+		release_asset(again);
+		release_asset(plain);
+		release_file(entry);
+	}
+
+	destroy_AssetCache(&assets);
+	destroy_FileCache(&files);
+	unlink(file);
+	rmdir(dir);
+
+	llog(LOG_DEBUG, "asset cache in %s, %s\n", dir, b ? "Success" : "Failure");
+	return b;
+}
+
+/**
+ * the header of a HEAD is the one a GET gets, even when the compressed asset was not made yet
+ */
+bool test_head_like_get() {
+	char dir[] = "/tmp/sns_test_XXXXXX";
+	bool b     = mkdtemp(dir) != nullptr;
+
+	char file[64];
+	snprintf(file, sizeof(file), "%s/page.html", dir);
+
+	FILE *f = b ? fopen(file, "w") : nullptr;
+	b       = b && f != nullptr;
+	for (size_t i = 0; b && i < 200; ++i) {
+		b = fputs("<p>the same line over and over</p>\n", f) >= 0;
+	}
+	b = b && fclose(f) == 0;
+
+	StringRef base = CAST_STRINGREF(dir);
+	b              = b && initialize_file_server(&base);
+
+	HTTP_Method         methods[]    = {HTTP_HEAD, HTTP_GET};
+	Arena               arenas[2]    = {make_Arena(0), make_Arena(0)};
+	OutboundHttpMessage responses[2] = {};
+	InboundHttpMessage  request      = {};
+
+	request.url                                = CAST_STRINGREF("/page.html");
+	request.header_options[RQ_ACCEPT_ENCODING] = CAST_STRINGREF("gzip");
+
+	for (size_t i = 0; b && i < 2; ++i) {
+		responses[i].arena = &arenas[i];
+		serve_file(&methods[i], &request, &responses[i]);
+		b = responses[i].asset != nullptr;
+	}
+
+	HTTPHeaderResponseOption options[] = {RP_CONTENT_LENGTH, RP_CONTENT_ENCODING, RP_VARY, RP_ETAG};
+
+	for (size_t i = 0; b && i < sizeof(options) / sizeof(options[0]); ++i) {
+		StringRef head;
+		StringRef get;
+		b = get_header_option(options[i], &responses[0], &head) && get_header_option(options[i], &responses[1], &get) && equal_StringRef(&head, &get);
+	}
+
+	for (size_t i = 0; i < 2; ++i) {
+		if (responses[i].asset != nullptr) {
+			release_asset(responses[i].asset);
+		}
+		if (responses[i].file != nullptr) {
+			release_file(responses[i].file);
+		}
+		destroy_Arena(&arenas[i]);
+	}
+
+	destroy_file_server();
+	unlink(file);
+	rmdir(dir);
+
+	llog(LOG_DEBUG, "HEAD and GET of a compressible file, %s\n", b ? "Success" : "Failure");
+	return b;
+}
+
+bool test_compression_tier(const char *mime, const size_t len, const uint8_t expected) {
+	StringRef type = CAST_STRINGREF(mime);
+	auto      res  = compression_tier(&type, len);
+
+	bool b = res == expected;
+	llog(LOG_DEBUG, "compression tier of %s, %zu bytes: %u %s\n", mime, len, res, b ? "Success" : "Failure");
+	return b;
+}
+
+bool test_negotiate_encoding(const char *accept, const uint32_t allowed, const uint8_t expected) {
+	StringRef value = CAST_STRINGREF(accept);
+	auto      res   = negotiate_encoding(&value, allowed);
+
+	bool b = res == expected;
+	llog(LOG_DEBUG, "encoding for '%s': %s %s\n", accept, content_encodings_str[res].str, b ? "Success" : "Failure");
+	return b;
+}
+
+/**
+ * compresses a repetitive body and decompresses it back with the library of the encoding
+ */
+bool test_encode_body(const uint8_t encoding) {
+	char text[4096];
+	for (size_t i = 0; i < sizeof(text); ++i) {
+		text[i] = "<p>compress me</p>\n"[i % 19];
+	}
+
+	StringRef data   = {text, sizeof(text)};
+	StringOwn output = {nullptr, 0};
+
+	bool b = encode_body(encoding, COMPRESS_BEST, &data, &output) && output.len < data.len;
+
+	char   back[sizeof(text)];
+	size_t back_len = sizeof(back);
+
+	switch (encoding) {
+	case ENCODING_GZIP: {
+		z_stream stream = {};
+		b               = b && inflateInit2(&stream, 15 + 16) == Z_OK;
+		stream.next_in  = (Bytef *)output.str;
+		stream.avail_in = (uInt)output.len;
+		stream.next_out  = (Bytef *)back;
+		stream.avail_out = (uInt)back_len;
+		b               = b && inflate(&stream, Z_FINISH) == Z_STREAM_END;
+		back_len        = stream.total_out;
+		inflateEnd(&stream);
+		break;
+	}
+	case ENCODING_BROTLI:
+		b = b && BrotliDecoderDecompress(output.len, (const uint8_t *)output.str, &back_len, (uint8_t *)back) == BROTLI_DECODER_RESULT_SUCCESS;
+		break;
+	case ENCODING_ZSTD:
+		back_len = b ? ZSTD_decompress(back, back_len, output.str, output.len) : 0;
+		break;
+	default:
+		b = false;
+	}
+
+	b = b && back_len == sizeof(text) && memcmp(back, text, sizeof(text)) == 0;
+
+	llog(LOG_DEBUG, "%s of %zu bytes in %zu, %s\n", content_encodings_str[encoding].str, data.len, output.len, b ? "Success" : "Failure");
+
+	free(output.str);
+	release_encoders();
+	return b;
+}
+
+bool test_status_line(const uint16_t code, const uint8_t version, const char *expected) {
+	Arena arena = make_Arena(64);
+	auto  line  = get_status_line(code, version, &arena);
+
+	bool b = line.len == strlen(expected) && memcmp(line.str, expected, line.len) == 0;
+	llog(LOG_DEBUG, "%.*s == %.*s, %s\n", (int)line.len - 2, line.str, (int)strlen(expected) - 2, expected, b ? "Success" : "Failure");
+
+	destroy_Arena(&arena);
+	return b;
+}
+
+/**
+ * replaces a field in the middle of the others and checks the block is still the fields in order, and still found
+ */
+bool test_header_builder() {
+	Arena               arena = make_Arena(64);
+	OutboundHttpMessage msg   = {.arena = &arena};
+
+	StringRef html   = TO_STRINGREF("text/html");
+	StringRef length = TO_STRINGREF("10");
+	StringRef close  = TO_STRINGREF("close");
+	StringRef keep   = TO_STRINGREF("keep-alive");
+	StringRef name   = TO_STRINGREF("X-Request-Id");
+	StringRef id     = TO_STRINGREF("42");
+
+	add_header_option(RP_CONTENT_TYPE, &html, &msg);
+	add_header_option(RP_CONNECTION, &close, &msg);
+	add_header_option(RP_CONTENT_LENGTH, &length, &msg);
+	add_custom_header(&name, &id, &msg);
+	add_header_option(RP_CONNECTION, &keep, &msg);
+
+	const char *expected = "Content-Type: text/html\r\nContent-Length: 10\r\nX-Request-Id: 42\r\nConnection: keep-alive\r\n";
+
+	StringRef value;
+	bool      b = msg.headers.len == strlen(expected) && memcmp(msg.headers.buffer, expected, msg.headers.len) == 0;
+	b           = b && get_header_option(RP_CONTENT_LENGTH, &msg, &value) && equal_StringRef(&value, &length);
+	b           = b && get_header_option(RP_CONNECTION, &msg, &value) && equal_StringRef(&value, &keep);
+	b           = b && !get_header_option(RP_ETAG, &msg, &value);
+
+	llog(LOG_DEBUG, "header builder %zu bytes, %s\n", msg.headers.len, b ? "Success" : "Failure");
+
+	destroy_Arena(&arena);
+	return b;
+}
+
+bool test_format_http_date(const time_t time, const char *expected) {
+	char date[HTTP_DATE_LEN + 1] = {};
+	format_http_date(time, date);
+
+	bool b = strcmp(date, expected) == 0;
+	llog(LOG_DEBUG, "%s == %s, %s\n", date, expected, b ? "Success" : "Failure");
+	return b;
+}
+
+/**
+ * the cached header is a whole field of the current second
+ */
+bool test_date_header() {
+	refresh_DateCache();
+	auto header = get_date_header();
+
+	char now[HTTP_DATE_LEN];
+	format_http_date(time(nullptr), now);
+
+	// the second might have changed in between, the day not so likely
+	bool b = header.len == DATE_HEADER_LEN && memcmp(header.str, "Date: ", 6) == 0 && memcmp(header.str + 6, now, 16) == 0 && memcmp(header.str + header.len - 2, "\r\n", 2) == 0;
+	b      = b && get_expires_date().len == HTTP_DATE_LEN;
+
+	llog(LOG_DEBUG, "%.*s, %s\n", (int)(header.len - 2), header.str, b ? "Success" : "Failure");
+	return b;
+}
+
+typedef struct {
+	char   data[64 * 1024];
+	size_t len;
+	size_t calls;
+} MemorySink;
+
+bool send_to_memory(void *sink, const char *data, const size_t len) {
+	MemorySink *mem = sink;
+
+	if (mem->len + len > sizeof(mem->data)) {
+		return false;
+	}
+
+	memcpy(mem->data + mem->len, data, len);
+	mem->len += len;
+	++mem->calls;
+	return true;
+}
+
+/**
+ * streams a body bigger than a chunk in small pieces, then takes the chunks apart and checks the body is whole
+ */
+bool test_body_writer(const bool chunked, const int gz_level) {
+	Arena      arena = make_Arena(1024);
+	MemorySink sink  = {};
+	BodyWriter writer;
+
+	initialize_BodyWriter(send_to_memory, &sink, chunked, gz_level, &arena, &writer);
+
+	char   body[40000];
+	size_t body_len = 0;
+	bool   b        = true;
+
+	for (size_t i = 0; b && body_len + 32 <= sizeof(body); ++i) {
+		auto      len   = (size_t)(snprintf(body + body_len, 32, "<li>item number %zu</li>\n", i));
+		StringRef piece = {body + body_len, len};
+		body_len += len;
+		b = write_body(&writer, &piece);
+	}
+	b = b && finish_body(&writer);
+	close_BodyWriter(&writer);
+
+	// the data of the chunks put back together
+	char   joined[sizeof(sink.data)];
+	size_t joined_len = 0;
+	size_t pos        = 0;
+
+	while (b && chunked) {
+		char *end  = nullptr;
+		auto  size = strtoul(sink.data + pos, &end, 16);
+		b          = end != nullptr && end[0] == '\r' && end[1] == '\n';
+		pos        = (size_t)(end - sink.data) + 2;
+
+		if (!b || size == 0) {
+			b = b && pos + 2 == sink.len;
+			break;
+		}
+
+		b = size <= BODY_CHUNK_SIZE && pos + size + 2 <= sink.len && sink.data[pos + size] == '\r';
+		memcpy(joined + joined_len, sink.data + pos, size);
+		joined_len += size;
+		pos += size + 2;
+	}
+
+	if (!chunked) {
+		memcpy(joined, sink.data, sink.len);
+		joined_len = sink.len;
+	}
+
+	char   back[sizeof(body)];
+	size_t back_len = joined_len;
+
+	if (gz_level > 0) {
+		z_stream stream  = {};
+		b                = b && inflateInit2(&stream, 15 + 16) == Z_OK;
+		stream.next_in   = (Bytef *)joined;
+		stream.avail_in  = (uInt)joined_len;
+		stream.next_out  = (Bytef *)back;
+		stream.avail_out = (uInt)sizeof(back);
+		b                = b && inflate(&stream, Z_FINISH) == Z_STREAM_END;
+		back_len         = stream.total_out;
+		inflateEnd(&stream);
+	} else {
+		memcpy(back, joined, joined_len);
+	}
+
+	b = b && back_len == body_len && memcmp(back, body, body_len) == 0;
+
+	llog(LOG_DEBUG, "body of %zu bytes sent in %zu writes, %zu bytes, %s\n", body_len, sink.calls, sink.len, b ? "Success" : "Failure");
+
+	destroy_Arena(&arena);
+	release_body_stream();
+	return b;
+}
+
+typedef struct {
+	Fiber *fiber; // the fiber, once it started
+	int    fd;    // what it waits on
+	int    step;  // how far it got
+	bool   ready; // what its wait returned
+} FiberState;
+
+void wait_in_fiber(void *data, void *) {
+	FiberState *state = data;
+
+	state->fiber = current_fiber();
+	state->step  = 1;
+	state->ready = fiber_wait(state->fd, EPOLLIN, state, 1000);
+	state->step  = 2;
+}
+
+/**
+ * runs a fiber that waits on a pipe, the loop resumes it when the pipe is written to or when its wait is over
+ */
+bool test_fiber_wait(const bool write_pipe) {
+	int        pipe_fds[2];
+	FiberState state = {};
+	bool       b     = pipe(pipe_fds) == 0;
+
+	auto               epoll_fd = epoll_create1(0);
+	struct epoll_event ev       = {.events = 0, .data = {.ptr = &state}};
+	b                           = b && epoll_ctl(epoll_fd, EPOLL_CTL_ADD, pipe_fds[0], &ev) == 0;
+
+	set_fiber_loop(epoll_fd);
+	state.fd = pipe_fds[0];
+
+	// the fiber runs until its wait, then the loop goes on
+	b = b && run_fiber(wait_in_fiber, &state, nullptr) && state.step == 1 && current_fiber() == nullptr;
+
+	if (write_pipe) {
+		b = b && write(pipe_fds[1], "x", 1) == 1;
+		b = b && epoll_wait(epoll_fd, &ev, 1, 1000) == 1 && ev.data.ptr == &state;
+		if (b) {
+			resume_fiber(state.fiber, true);
+		}
+	} else {
+		b = b && expire_fibers(get_monotonic_ns()) == 0;
+		b = b && expire_fibers(get_monotonic_ns() + 2000000000) == 1;
+	}
+
+	b = b && state.step == 2 && state.ready == write_pipe;
+
+	llog(LOG_DEBUG, "fiber %s, %s\n", write_pipe ? "resumed by its socket" : "timed out", b ? "Success" : "Failure");
+
+	// a fiber still waiting after a failure finishes before its stack goes
+	cancel_fibers();
+	release_fibers();
+	close(epoll_fd);
+	close(pipe_fds[0]);
+	close(pipe_fds[1]);
+	return b;
+}
+
+/**
+ * fills a queue of 8 slots, then keeps taking 5 tasks and filling it again, so the positions wrap around the slots many times
+ */
+bool test_mpmc_queue() {
+	MPMCQueue_Task queue;
+	MPMCQueue_Task_make(5, &queue);
+
+	Task      task      = {};
+	uintptr_t next_push = 0;
+	uintptr_t next_pop  = 0;
+	bool      b         = true;
+
+	for (size_t lap = 0; lap < 50; ++lap) {
+		while (MPMCQueue_Task_push(&queue, &(Task){nullptr, (void *)(next_push), 0})) {
+			++next_push;
+		}
+
+		// the capacity is rounded up to a power of two
+		b = b && MPMCQueue_Task_count(&queue) == 8;
+
+		for (size_t i = 0; i < 5; ++i) {
+			b = b && MPMCQueue_Task_pop(&queue, &task) && task.arg == (void *)(next_pop++);
+		}
+	}
+
+	while (MPMCQueue_Task_pop(&queue, &task)) {
+		b = b && task.arg == (void *)(next_pop++);
+	}
+
+	b = b && next_pop == next_push && MPMCQueue_Task_count(&queue) == 0;
+
+	MPMCQueue_Task_destroy(&queue);
+
+	llog(LOG_DEBUG, "mpmc queue, %zu tasks in and out, %s\n", (size_t)(next_push), b ? "Success" : "Failure");
+	return b;
+}
+
+/**
+ * the owner takes the newest task and the thieves the oldest, then fills the deque with its indices past the end of the slots
+ */
+bool test_work_deque() {
+	WorkDeque deque;
+	make_WorkDeque(&deque);
+
+	Task task = {};
+	bool b    = true;
+
+	for (uintptr_t i = 0; i < 3; ++i) {
+		b = b && push_WorkDeque(&deque, &(Task){nullptr, (void *)(i), 0});
+	}
+
+	b = b && steal_WorkDeque(&deque, &task) && task.arg == (void *)(0);
+	b = b && pop_WorkDeque(&deque, &task) && task.arg == (void *)(2);
+	b = b && pop_WorkDeque(&deque, &task) && task.arg == (void *)(1);
+	b = b && !pop_WorkDeque(&deque, &task) && !steal_WorkDeque(&deque, &task);
+
+	uintptr_t pushed = 0;
+	while (push_WorkDeque(&deque, &(Task){nullptr, (void *)(pushed), 0})) {
+		++pushed;
+	}
+
+	b = b && pushed == WORK_DEQUE_CAPACITY;
+
+	while (pushed > 0 && pop_WorkDeque(&deque, &task)) {
+		b = b && task.arg == (void *)(--pushed);
+	}
+
+	b = b && pushed == 0 && !pop_WorkDeque(&deque, &task);
+
+	destroy_WorkDeque(&deque);
+
+	llog(LOG_DEBUG, "work deque, %s\n", b ? "Success" : "Failure");
+	return b;
+}
+
+typedef struct {
+	WorkDeque   *deque;
+	atomic_uint *taken; // how many times every task was taken
+	atomic_bool  done;  // the owner pushed and popped all it had to
+} DequeRace;
+
+static void *steal_until_done(void *ptr) {
+	DequeRace *race = ptr;
+	Task       task;
+
+	while (!atomic_load(&race->done)) {
+		if (steal_WorkDeque(race->deque, &task)) {
+			atomic_fetch_add(&race->taken[(uintptr_t)(task.arg)], 1);
+		}
+	}
+
+	return nullptr;
+}
+
+/**
+ * the owner pushes and pops while three thieves steal, every task must be taken exactly once, a lost one fails instead of hanging
+ */
+bool test_work_deque_race() {
+	constexpr size_t TASKS   = 200000;
+	constexpr size_t THIEVES = 3;
+
+	WorkDeque deque;
+	make_WorkDeque(&deque);
+
+	DequeRace race = {&deque, calloc(TASKS, sizeof(atomic_uint)), false};
+	Task      task;
+
+	pthread_t thieves[THIEVES];
+	for (size_t i = 0; i < THIEVES; ++i) {
+		pthread_create(&thieves[i], nullptr, steal_until_done, &race);
+	}
+
+	for (uintptr_t i = 0; i < TASKS; ++i) {
+		// full, the owner makes room like a worker running its own tasks
+		while (!push_WorkDeque(&deque, &(Task){nullptr, (void *)(i), 0})) {
+			if (pop_WorkDeque(&deque, &task)) {
+				atomic_fetch_add(&race.taken[(uintptr_t)(task.arg)], 1);
+			}
+		}
+
+		// the last task left is raced for by the owner and the thieves
+		if (i % 3 == 0 && pop_WorkDeque(&deque, &task)) {
+			atomic_fetch_add(&race.taken[(uintptr_t)(task.arg)], 1);
+		}
+	}
+
+	while (pop_WorkDeque(&deque, &task)) {
+		atomic_fetch_add(&race.taken[(uintptr_t)(task.arg)], 1);
+	}
+
+	atomic_store(&race.done, true);
+
+	for (size_t i = 0; i < THIEVES; ++i) {
+		pthread_join(thieves[i], nullptr);
+	}
+
+	size_t wrong = 0;
+	for (size_t i = 0; i < TASKS; ++i) {
+		wrong += atomic_load(&race.taken[i]) != 1;
+	}
+
+	free(race.taken);
+	destroy_WorkDeque(&deque);
+
+	llog(LOG_DEBUG, "work deque with %zu thieves, %zu of %zu tasks not taken once, %s\n", THIEVES, wrong, TASKS, wrong == 0 ? "Success" : "Failure");
+	return wrong == 0;
+}
+
+/**
+ * fills a small arena until it needs more blocks, then checks the reset merged them in a single one
+ */
+bool test_arena() {
+	Arena arena = make_Arena(64);
+
+	char *first = alloc_Arena(&arena, 10);
+	memcpy(first, "0123456789", 10);
+
+	// the last allocation grows in place
+	bool b = realloc_Arena(&arena, first, 10, 40) == first;
+
+	for (size_t i = 0; i < 10; ++i) {
+		alloc_Arena(&arena, 100);
+	}
+	auto total = arena.total;
+
+	reset_Arena(&arena);
+	b = b && arena.current != nullptr && arena.current->prev == nullptr && arena.current->capacity == total && arena.current->used == 0;
+
+	// only the last allocation can grow in place, the others are copied
+	char *a = alloc_Arena(&arena, 3);
+	memcpy(a, "abc", 3);
+	alloc_Arena(&arena, 5);
+	char *c = realloc_Arena(&arena, a, 3, 20);
+	b       = b && c != a && memcmp(c, "abc", 3) == 0 && (size_t)(c) % alignof(max_align_t) == 0;
+
+	destroy_Arena(&arena);
+
+	llog(LOG_DEBUG, "arena of %zu bytes, %s\n", total, b ? "Success" : "Failure");
+	return b;
+}
+
 int main() {
 	size_t tests_passed = 0;
 	size_t total_tests  = 0;
@@ -42,6 +848,143 @@ int main() {
 	TEST(test_num_to_string(STRING(6534154849)));
 	TEST(test_num_to_string(STRING(66513186)));
 
+	llog(LOG_DEBUG, "---- has_token ----\n");
+	TEST(test_has_token("close", "close", true));
+	TEST(test_has_token("Close", "close", true));
+	TEST(test_has_token("keep-alive, Upgrade", "upgrade", true));
+	TEST(test_has_token("keep-alive,Upgrade", "keep-alive", true));
+	TEST(test_has_token("  keep-alive  ", "keep-alive", true));
+	TEST(test_has_token("keep-alive", "close", false));
+	TEST(test_has_token("closed", "close", false));
+	TEST(test_has_token("", "close", false));
+
+	llog(LOG_DEBUG, "---- request framing ----\n");
+	TEST(test_framer("GET / HTTP/1.1\r\nHost: a\r\n\r\n", 1, FRAME_DONE, ""));
+	TEST(test_framer("GET / HTTP/1.1\r\nHost: a\r\n\r", 100, FRAME_HEADER, ""));
+	TEST(test_framer("POST / HTTP/1.1\r\nContent-Length: 5\r\n\r\nhello", 1, FRAME_DONE, "hello"));
+	TEST(test_framer("POST / HTTP/1.1\r\ncontent-length:5\r\n\r\nhello", 7, FRAME_DONE, "hello"));
+	TEST(test_framer("POST / HTTP/1.1\r\nContent-Length: 5\r\n\r\nhel", 100, FRAME_BODY, ""));
+	TEST(test_framer("POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n5\r\nhello\r\n6;ext=1\r\n world\r\n0\r\n\r\n", 1, FRAME_DONE, "hello world"));
+	TEST(test_framer("POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\nA\r\n0123456789\r\n0\r\nX-T: 1\r\n\r\n", 3, FRAME_DONE, "0123456789"));
+	TEST(test_framer("POST / HTTP/1.1\r\nContent-Length: 5x\r\n\r\nhello", 100, FRAME_ERROR, ""));
+	TEST(test_framer("POST / HTTP/1.1\r\nContent-Length: 1000\r\n\r\n", 100, FRAME_ERROR, ""));
+	TEST(test_framer("POST / HTTP/1.1\r\nContent-Length: 5\r\nTransfer-Encoding: chunked\r\n\r\n", 100, FRAME_ERROR, ""));
+	TEST(test_framer("POST / HTTP/1.1\r\nTransfer-Encoding: gzip\r\n\r\n", 100, FRAME_ERROR, ""));
+	TEST(test_framer("POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\nzz\r\n", 100, FRAME_ERROR, ""));
+
+	llog(LOG_DEBUG, "---- scanning ----\n");
+	TEST(test_strnstr("GET / HTTP/1.1\r\n", "\r\n", 14));
+	TEST(test_strnstr("aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaab", "aab", 53));
+	TEST(test_strnstr("0123456789012345678901234567890123456789\r\n\r", "\r\n\r\n", -1));
+	TEST(test_strnstr("0123456789012345678901234567890123456789 match", "match", 41));
+	TEST(test_strnstr("short", "longer needle", -1));
+	TEST(test_tokenize("GET / HTTP/1.1", 0, 0, "", ""));
+	TEST(test_tokenize("GET / HTTP/1.1\r\nHost: example.com:8080", 1, 0, "Host", "example.com:8080"));
+	TEST(test_tokenize("GET / HTTP/1.1\r\nHost: a\r\nAccept-Encoding: gzip, deflate, br\r\nX-Empty:\r\nUser-Agent: some quite long user agent string", 4, 3, "User-Agent", "some quite long user agent string"));
+	TEST(test_tokenize("GET / HTTP/1.1\r\nHost: a\r\nAccept-Encoding: gzip, deflate, br\r\nX-Empty:\r\nUser-Agent: a", 4, 2, "X-Empty", ""));
+	TEST(test_tokenize("GET / HTTP/1.1\r\nno colon here\r\nHost: a", 2, 0, "no colon here", ""));
+
+	TEST(test_parse_content_type("POST /api HTTP/1.1\r\nContent-Type: application/json\r\nContent-Length: 2\r\n\r\n{}", "application/json"));
+	TEST(test_parse_content_type("POST /api HTTP/1.1\r\nContent-Length: 2\r\nContent-Type: application/json\r\n\r\n{}", "application/json"));
+	TEST(test_parse_content_type("POST /up HTTP/1.1\r\nContent-Type: multipart/form-data; boundary=\"xyz\"\r\n\r\n", "multipart/form-data; boundary=\"xyz\""));
+	TEST(test_parse_content_type("POST /up HTTP/1.1\r\nContent-Type: multipart/form-data\r\n\r\n", "multipart/form-data"));
+
+	llog(LOG_DEBUG, "---- header names ----\n");
+	TEST(test_parameter_code("Host", RQ_HOST));
+	TEST(test_parameter_code("host", RQ_HOST));
+	TEST(test_parameter_code("ACCEPT-ENCODING", RQ_ACCEPT_ENCODING));
+	TEST(test_parameter_code("a-im", RQ_A_IM));
+	TEST(test_parameter_code("te", RQ_TE));
+	TEST(test_parameter_code("Http2-Settings", RQ_HTTP2_SETTINGS));
+	TEST(test_parameter_code("Access-Control-Request-Headers", RQ_ACCESS_CONTROL_REQUEST_HEADERS));
+	TEST(test_parameter_code("Sec-Fetch-Mode", RQ_ENUM_LEN));
+	TEST(test_parameter_code("Hosts", RQ_ENUM_LEN));
+	TEST(test_parameter_code("", RQ_ENUM_LEN));
+
+	llog(LOG_DEBUG, "---- router ----\n");
+	Router    router   = {};
+	StringRef routes[] = {TO_STRINGREF("/"), TO_STRINGREF("/user/:id"), TO_STRINGREF("/users"), TO_STRINGREF("/user/:id/files/*path")};
+	add_route(&router, HTTP_INVALID_METHOD, &routes[0], route_home);
+	add_route(&router, HTTP_INVALID_METHOD, &routes[1], route_user);
+	add_route(&router, HTTP_POST, &routes[1], route_user_post);
+	add_route(&router, HTTP_INVALID_METHOD, &routes[2], route_users);
+	add_route(&router, HTTP_INVALID_METHOD, &routes[3], route_files);
+
+	TEST(test_route(&router, HTTP_GET, "/", route_home, nullptr, nullptr));
+	TEST(test_route(&router, HTTP_GET, "/users", route_users, nullptr, nullptr));
+	TEST(test_route(&router, HTTP_GET, "/user/42", route_user, "id", "42"));
+	TEST(test_route(&router, HTTP_POST, "/user/42", route_user_post, "id", "42"));
+	TEST(test_route(&router, HTTP_GET, "/user/42/files/a/b.txt", route_files, "path", "a/b.txt"));
+	TEST(test_route(&router, HTTP_GET, "/user/", nullptr, nullptr, nullptr));
+	TEST(test_route(&router, HTTP_GET, "/user/42/other", nullptr, nullptr, nullptr));
+	add_route(&router, HTTP_INVALID_METHOD, nullptr, route_missing);
+	TEST(test_route(&router, HTTP_GET, "/nothing", route_missing, nullptr, nullptr));
+	destroy_Router(&router);
+
+	llog(LOG_DEBUG, "---- files ----\n");
+	TEST(test_sanitize_path("/", "."));
+	TEST(test_sanitize_path("/css//./site.css", "css/site.css"));
+	TEST(test_sanitize_path("/my%20file.txt", "my file.txt"));
+	TEST(test_sanitize_path("/docs/", "docs"));
+	TEST(test_sanitize_path("/../etc/passwd", nullptr));
+	TEST(test_sanitize_path("/a/%2e%2e/%2e%2e/b", nullptr));
+	TEST(test_sanitize_path("/a%00.html", nullptr));
+	TEST(test_file_cache());
+	TEST(test_asset_cache());
+	TEST(test_head_like_get());
+
+	TEST(test_compression_tier("text/html; charset=utf-8", 4096, COMPRESS_BEST));
+	TEST(test_compression_tier("application/json", 200 * 1024, COMPRESS_DEFAULT));
+	TEST(test_compression_tier("text/css", 100, COMPRESS_NONE));
+	TEST(test_compression_tier("image/png", 4096, COMPRESS_NONE));
+
+	TEST(test_negotiate_encoding("", ENCODINGS_ALL, ENCODING_IDENTITY));
+	TEST(test_negotiate_encoding("gzip, deflate, br, zstd", ENCODINGS_ALL, ENCODING_BROTLI));
+	TEST(test_negotiate_encoding("gzip;q=1.0, br;q=0.5", ENCODINGS_ALL, ENCODING_GZIP));
+	TEST(test_negotiate_encoding("br;q=0, *;q=0.3", ENCODINGS_ALL, ENCODING_ZSTD));
+	TEST(test_negotiate_encoding("zstd;q=0.2, identity;q=0.9", ENCODINGS_ALL, ENCODING_IDENTITY));
+	TEST(test_negotiate_encoding("GZIP ; q=0.001", ENCODINGS_ALL, ENCODING_GZIP));
+	TEST(test_negotiate_encoding("gzip;q=0, unknown", ENCODINGS_ALL, ENCODING_IDENTITY));
+	TEST(test_negotiate_encoding("br, gzip;q=0.5", 1 << ENCODING_GZIP, ENCODING_GZIP));
+	TEST(test_negotiate_encoding("gzip;foo=1;q=0, zstd;q=0.1", ENCODINGS_ALL, ENCODING_ZSTD));
+	TEST(test_negotiate_encoding("br;x=\xff;q=0.2, gzip;\xe9=1;q=0.4", ENCODINGS_ALL, ENCODING_GZIP));
+
+	TEST(test_encode_body(ENCODING_GZIP));
+	TEST(test_encode_body(ENCODING_BROTLI));
+	TEST(test_encode_body(ENCODING_ZSTD));
+
+	llog(LOG_DEBUG, "---- task queues ----\n");
+	TEST(test_mpmc_queue());
+	TEST(test_work_deque());
+	TEST(test_work_deque_race());
+
+	llog(LOG_DEBUG, "---- arena ----\n");
+	TEST(test_arena());
+
+	llog(LOG_DEBUG, "---- response header ----\n");
+	TEST(test_header_builder());
+
+	llog(LOG_DEBUG, "---- status lines ----\n");
+	TEST(test_status_line(200, HTTP_VER_11, "HTTP/1.1 200 OK\r\n"));
+	TEST(test_status_line(404, HTTP_VER_10, "HTTP/1.0 404 Not Found\r\n"));
+	TEST(test_status_line(413, HTTP_VER_UNKN, "HTTP/1.0 413 Request Entity Too Large\r\n"));
+	TEST(test_status_line(299, HTTP_VER_11, "HTTP/1.1 299 Unknown\r\n"));
+	TEST(test_status_line(7, HTTP_VER_2, "HTTP/1.1 500 Internal Server Error\r\n"));
+
+	llog(LOG_DEBUG, "---- dates ----\n");
+	TEST(test_format_http_date(784111777, "Sun, 06 Nov 1994 08:49:37 GMT"));
+	TEST(test_format_http_date(951782400, "Tue, 29 Feb 2000 00:00:00 GMT"));
+	TEST(test_date_header());
+
+	llog(LOG_DEBUG, "---- body writer ----\n");
+	TEST(test_body_writer(true, 0));
+	TEST(test_body_writer(true, 6));
+	TEST(test_body_writer(false, 0));
+
+	llog(LOG_DEBUG, "---- fibers ----\n");
+	TEST(test_fiber_wait(true));
+	TEST(test_fiber_wait(false));
+
 	llog(LOG_INFO, "%zu tests passed out of %zu. Pass rate of %.3f%%\n", tests_passed, total_tests, ((double)tests_passed / (double)total_tests) * 100);
 	return 0;
 }